@@ -72,11 +72,13 @@
 
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include "TNT/tnt.h"
 #include "LSDFlowInfo.hpp"
 #include "LSDChannel.hpp"
 #include "LSDIndexChannel.hpp"
 #include "LSDMostLikelyPartitionsFinder.hpp"
+#include "LSDStatsTools.hpp"
 using namespace std;
 using namespace TNT;
 
@@ -254,6 +256,35 @@ void LSDChannel::create_LSDC(int SJN, int EJN, float downslope_chi,
 
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// As above, but the chi values come from a table made by
+// LSDFlowInfo::calculate_base_level_chi
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDChannel::create_LSDC(int SJN, int EJN, float downslope_chi,
+                             vector<double>& BaseLevelChi, LSDFlowInfo& FlowInfo,
+                             LSDRaster& Elevation_Raster)
+{
+	// get the nodes of the channel
+	create_LSDC(SJN, EJN, FlowInfo);
+
+	float pixel_area = DataResolution*DataResolution;
+	int n_nodes_in_channel = int(NodeSequence.size());
+	vector<float> elev_temp(n_nodes_in_channel,float(NoDataValue));
+	vector<float> area_temp(n_nodes_in_channel,float(NoDataValue));
+	for (int ChIndex = 0; ChIndex<n_nodes_in_channel; ChIndex++)
+	{
+		area_temp[ChIndex] = float(FlowInfo.retrieve_contributing_pixels_of_node(NodeSequence[ChIndex]))*pixel_area;
+		elev_temp[ChIndex] = Elevation_Raster.get_data_element(RowSequence[ChIndex],ColSequence[ChIndex]);
+	}
+	Elevation = elev_temp;
+	DrainageArea = area_temp;
+
+	calculate_chi(downslope_chi, BaseLevelChi);
+}
+
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // this calculates all the channel areas, elevations and chi parameters based on
@@ -566,6 +597,115 @@ void LSDChannel::calculate_chi(float downslope_chi, float m_over_n, float A_0, L
 	Chi = chi_temp;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this gets the chi values in the channel from a table made by
+// LSDFlowInfo::calculate_base_level_chi: the chi of a node above the bottom
+// of the channel is the difference between its chi and that of the bottom node
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDChannel::calculate_chi(float downslope_chi, vector<double>& BaseLevelChi)
+{
+	int n_nodes_in_channel = int(NodeSequence.size());
+	vector<float> chi_temp(n_nodes_in_channel,downslope_chi);
+	if (n_nodes_in_channel == 0)
+	{
+		Chi = chi_temp;
+		return;
+	}
+
+	double bottom_chi = BaseLevelChi[ NodeSequence[n_nodes_in_channel-1] ];
+	for (int ChIndex = n_nodes_in_channel-2; ChIndex>=0; ChIndex--)
+	{
+		chi_temp[ChIndex] = downslope_chi+float(BaseLevelChi[ NodeSequence[ChIndex] ]-bottom_chi);
+	}
+
+	Chi = chi_temp;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this calculates the chi values in the channel, measured from its bottom node,
+// for n_movern evenly spaced values of m over n at once. As in
+// LSDChiNetwork::calculate_chi_batch, each node takes one log and the rest is
+// done by add_chi_batch_node
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+Array2D<float> LSDChannel::calculate_chi_batch(float A_0, int n_movern, float d_movern,
+                                               float start_movern, LSDFlowInfo& FlowInfo)
+{
+	Array2D<float> ChiBatch;
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, FlowInfo, ChiBatch);
+	return ChiBatch;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this is calculate_chi_batch writing into the array of an earlier call. As
+// in LSDChiNetwork::calculate_chi_batch, the array is reused if it has the
+// right size and is not shared with any other Array2D
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDChannel::calculate_chi_batch(float A_0, int n_movern, float d_movern, float start_movern,
+                                     LSDFlowInfo& FlowInfo, Array2D<float>& ChiBatch)
+{
+	float root2 = 1.41421356;
+	float diag_length = root2*DataResolution;
+	float dx;
+
+	int n_nodes_in_channel = int(NodeSequence.size());
+	if (ChiBatch.dim1() != n_nodes_in_channel || ChiBatch.dim2() != n_movern || ChiBatch.ref_count() > 1)
+	{
+		ChiBatch = Array2D<float>(n_nodes_in_channel,n_movern);
+	}
+	if (n_nodes_in_channel == 0 || n_movern == 0)
+	{
+		return;
+	}
+
+	float* bottom_chi = ChiBatch[n_nodes_in_channel-1];
+	for (int movn = 0; movn<n_movern; movn++)
+	{
+		bottom_chi[movn] = 0.0;
+	}
+
+	// the channel is arranged with the upstream node first so go through it
+	// in reverse order
+	for (int ChIndex = n_nodes_in_channel-2; ChIndex>=0; ChIndex--)
+	{
+		if (FlowInfo.retrieve_flow_length_code_of_node(NodeSequence[ChIndex]) == 2)
+		{
+			dx = diag_length;
+		}
+		else
+		{
+			dx = DataResolution;
+		}
+		float log_area_ratio = log(A_0/DrainageArea[ChIndex]);
+		add_chi_batch_node(dx, log_area_ratio, start_movern, d_movern, n_movern,
+		                   ChiBatch[ChIndex+1], ChiBatch[ChIndex]);
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this sets the chi values in the channel to one column of calculate_chi_batch
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDChannel::set_chi_from_batch(float downslope_chi, Array2D<float>& ChiBatch, int movn)
+{
+	int n_nodes_in_channel = ChiBatch.dim1();
+	Chi.resize(n_nodes_in_channel);
+	for (int ChIndex = 0; ChIndex<n_nodes_in_channel; ChIndex++)
+	{
+		Chi[ChIndex] = downslope_chi+ChiBatch[ChIndex][movn];
+	}
+}
+
 
 // this function gets the most likely channel segments
 //
@@ -748,90 +888,169 @@ int LSDChannel::calculate_channel_heads(int min_seg_length_for_channel_heads, fl
 {
     float downslope_chi = 0;
     calculate_chi(downslope_chi, m_over_n, A_0, FlowInfo);
-    vector<float> channel_chi;
-    vector<float> hillslope_chi;
-    vector<float> channel_elev;
-    vector<float> hillslope_elev;
+    return fit_channel_head_segments(min_seg_length_for_channel_heads);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// As above, with chi taken from a table made by
+// LSDFlowInfo::calculate_base_level_chi
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+int LSDChannel::calculate_channel_heads(int min_seg_length_for_channel_heads, vector<double>& BaseLevelChi)
+{
+    float downslope_chi = 0;
+    calculate_chi(downslope_chi, BaseLevelChi);
+    return fit_channel_head_segments(min_seg_length_for_channel_heads);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This does the segment fitting of calculate_channel_heads on the chi and
+// elevation of the channel, and returns the node index of the channel head
+//
+// Every split of the profile into an upstream hillslope segment and a
+// downstream channel segment is tried, and the one with the largest test value
+// (the r^2 of the channel segment less the departure of the Durbin-Watson
+// statistic of the hillslope segment from 2, over 2) is the channel head.
+// Running sums of chi, elevation, their squares and products are built once
+// from the top of the profile (for the hillslope segments) and once from the
+// bottom (for the channel segments), together with running sums over
+// consecutive pairs of nodes for the Durbin-Watson statistic. The regression
+// of each segment is then a few arithmetic operations rather than a pass over
+// its nodes, so the whole search is linear in the length of the channel. The
+// data are measured from their means to keep the sums well conditioned.
+//
+// A segment whose chi or elevation spread is within 1e-4 of their magnitude
+// (which includes the degenerate segments with all their chi or all their
+// elevations equal) has no meaningful r^2 or Durbin-Watson statistic: its
+// simple_linear_regression fit is dominated by rounding, or is not finite.
+// Such splits are skipped, as they never beat a real split in the old search.
+//
+// FC 25/09/2013
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+int LSDChannel::fit_channel_head_segments(int min_seg_length_for_channel_heads)
+{
     int end_node = Chi.size();
-    float test_value;
-    float max_test_value = 0;
-    int best_chan_seg = 0;
-    int best_hill_seg = 0;
-    int start_node = 0;
+    double test_value;
+    double max_test_value = 0;
     int node_index = 0;
-    float chan_gradient = 0;
-    float hill_gradient = 0;
-    float chan_intercept = 0;
-    float hill_intercept = 0;
     float chi_intersection = 0;
     float elev_intersection = 0;
-    
-    vector<float>::iterator vec_iter_start;
-	  vector<float>::iterator vec_iter_end;
+
+    // a segment is dominated by rounding if the spread of its chi or elevation
+    // values is within 1e-4 of their magnitude; this is the square of that
+    const double rounding_fraction = 1e-8;
+
+    // the data, measured from their means
+    double mean_chi = 0;
+    double mean_elev = 0;
+    double chi_scale = 0;
+    double elev_scale = 0;
+    for (int i = 0; i < end_node; i++)
+    {
+      mean_chi += Chi[i];
+      mean_elev += Elevation[i];
+      chi_scale = max(chi_scale, double(fabs(Chi[i])));
+      elev_scale = max(elev_scale, double(fabs(Elevation[i])));
+    }
+    if (end_node > 0)
+    {
+      mean_chi = mean_chi/end_node;
+      mean_elev = mean_elev/end_node;
+    }
+    double chi_floor = rounding_fraction*chi_scale*chi_scale;
+    double elev_floor = rounding_fraction*elev_scale*elev_scale;
+    vector<double> x(end_node);
+    vector<double> y(end_node);
+    for (int i = 0; i < end_node; i++)
+    {
+      x[i] = Chi[i]-mean_chi;
+      y[i] = Elevation[i]-mean_elev;
+    }
+
+    // sums over the first i nodes (the hillslope) and over the nodes from i to
+    // the end (the channel). Sxx etc. are sums of products, and the D sums are
+    // over the pairs of successive nodes within those ranges
+    vector<double> Sx(end_node+1,0.0), Sy(end_node+1,0.0), Sxx(end_node+1,0.0),
+                   Sxy(end_node+1,0.0), Syy(end_node+1,0.0), Dxx(end_node+1,0.0),
+                   Dxy(end_node+1,0.0), Dyy(end_node+1,0.0);
+    vector<double> Cx(end_node+1,0.0), Cy(end_node+1,0.0), Cxx(end_node+1,0.0),
+                   Cxy(end_node+1,0.0), Cyy(end_node+1,0.0);
+    for (int i = 0; i < end_node; i++)
+    {
+      Sx[i+1] = Sx[i]+x[i];
+      Sy[i+1] = Sy[i]+y[i];
+      Sxx[i+1] = Sxx[i]+x[i]*x[i];
+      Sxy[i+1] = Sxy[i]+x[i]*y[i];
+      Syy[i+1] = Syy[i]+y[i]*y[i];
+      if (i > 0)
+      {
+        double dx = x[i]-x[i-1];
+        double dy = y[i]-y[i-1];
+        Dxx[i+1] = Dxx[i]+dx*dx;
+        Dxy[i+1] = Dxy[i]+dx*dy;
+        Dyy[i+1] = Dyy[i]+dy*dy;
+      }
+    }
+    for (int i = end_node-1; i >= 0; i--)
+    {
+      Cx[i] = Cx[i+1]+x[i];
+      Cy[i] = Cy[i+1]+y[i];
+      Cxx[i] = Cxx[i+1]+x[i]*x[i];
+      Cxy[i] = Cxy[i+1]+x[i]*y[i];
+      Cyy[i] = Cyy[i+1]+y[i]*y[i];
+    }
 
     // Looping through the combinations of hillslope and channel segment lengths
 	  for (int hill_seg_length = min_seg_length_for_channel_heads; hill_seg_length <= end_node-min_seg_length_for_channel_heads; hill_seg_length++)
     {
 		  int chan_seg_length = end_node - hill_seg_length;
 
-		  //cout << endl;
-		  //cout << "Size of channel: " << Chi.size() << endl;
-		  //cout << "Size of hillslope: " << hill_seg_length << " and chann seg length: " << chan_seg_length << " total length: " << hill_seg_length+chan_seg_length << endl;
-		  //cout << endl;
-
-      // assigning the chi values of the hillslope segment
-      hillslope_chi.resize(hill_seg_length);
-      vec_iter_start = Chi.begin()+start_node;
-	    vec_iter_end = vec_iter_start+hill_seg_length;
-	    hillslope_chi.assign(vec_iter_start,vec_iter_end);
-
-	    // assigning the elevation values of the hillslope segment
-      hillslope_elev.resize(hill_seg_length);
-	    vec_iter_start = Elevation.begin()+start_node;
-	    vec_iter_end = vec_iter_start+hill_seg_length;
-	    hillslope_elev.assign(vec_iter_start,vec_iter_end);
-
-	    // assigning the chi values of the channel segment
-      channel_chi.resize(chan_seg_length);
-      vec_iter_start = Chi.begin()+start_node+hill_seg_length;
-	    vec_iter_end = vec_iter_start+chan_seg_length;
-	    channel_chi.assign(vec_iter_start,vec_iter_end);
-
-	    // assigning the elevation values of the channel segment
-      channel_elev.resize(chan_seg_length);
-	    vec_iter_start = Elevation.begin()+start_node+hill_seg_length;
-	    vec_iter_end = vec_iter_start+chan_seg_length;
-	    channel_elev.assign(vec_iter_start,vec_iter_end);
-	    
-      // performing linear regression on the channel segment
-      vector<float> residuals_chan;
-      vector<float> results_chan = simple_linear_regression(channel_chi,channel_elev, residuals_chan);
-
-      // performing linear regression on the hillslope segment
-      vector<float> residuals_hill;
-      vector<float> results_hill = simple_linear_regression(hillslope_chi, hillslope_elev, residuals_hill);
-
-      // calculating the test value
-      test_value = results_chan[2] - ((results_hill[3] - 2)/2);
+      // the channel segment runs from hill_seg_length to the end
+      double n = chan_seg_length;
+      double chan_sxx = Cxx[hill_seg_length]-Cx[hill_seg_length]*Cx[hill_seg_length]/n;
+      double chan_sxy = Cxy[hill_seg_length]-Cx[hill_seg_length]*Cy[hill_seg_length]/n;
+      double chan_syy = Cyy[hill_seg_length]-Cy[hill_seg_length]*Cy[hill_seg_length]/n;
+      if (chan_sxx <= n*chi_floor || chan_syy <= n*elev_floor)
+      {
+        continue;
+      }
 
-      // looping through test values to find the max test value
+      // the hillslope segment is the first hill_seg_length nodes
+      n = hill_seg_length;
+      double hill_sxx = Sxx[hill_seg_length]-Sx[hill_seg_length]*Sx[hill_seg_length]/n;
+      double hill_sxy = Sxy[hill_seg_length]-Sx[hill_seg_length]*Sy[hill_seg_length]/n;
+      double hill_syy = Syy[hill_seg_length]-Sy[hill_seg_length]*Sy[hill_seg_length]/n;
+      if (hill_sxx <= n*chi_floor)
+      {
+        continue;
+      }
+      double hill_gradient = hill_sxy/hill_sxx;
+      double hill_SS_err = hill_syy-hill_sxy*hill_gradient;
+      if (hill_SS_err <= n*elev_floor)
+      {
+        continue;
+      }
+
+      // r^2 of the channel segment, and the Durbin-Watson statistic of the
+      // hillslope segment. Successive residuals differ by gradient*dx-dy,
+      // which does not depend on the intercept
+      double chan_SS_err = max(chan_syy-chan_sxy*chan_sxy/chan_sxx, 0.0);
+      double chan_r2 = 1-chan_SS_err/chan_syy;
+      double top_term = max(Dyy[hill_seg_length]-2*hill_gradient*Dxy[hill_seg_length]
+                            +hill_gradient*hill_gradient*Dxx[hill_seg_length], 0.0);
+      double hill_DW = top_term/hill_SS_err;
 
+      test_value = chan_r2 - ((hill_DW - 2)/2);
+
+      // looping through test values to find the max test value
       if (test_value > max_test_value)
       {
          max_test_value = test_value;
-         best_hill_seg = hill_seg_length;
-         best_chan_seg = chan_seg_length;
-         hill_gradient = results_hill[0];
-         chan_gradient = results_chan[0];
-         hill_intercept = results_hill[1];
-         chan_intercept = results_chan[1];
-         elev_intersection = channel_elev.front();
-         chi_intersection = channel_chi.front();
+         elev_intersection = Elevation[hill_seg_length];
+         chi_intersection = Chi[hill_seg_length];
       }
-
     }
-    //cout << "Channel gradient: " << chan_gradient << " Channel intercept: " << chan_intercept << " Hillslope gradient: " << hill_gradient
-    //<< " Hillslope intercept: " << hill_intercept << endl;
 
     //Getting the node index of the channel heads
     for (unsigned int i = 0; i < Elevation.size(); i++)
@@ -146,6 +146,21 @@ class LSDChannel: public LSDIndexChannel
 							{ create_LSDC(StartNode, EndNode, downslope_chi,
                               m_over_n, A_0, FlowInfo, Elevation_Raster); }
 
+  /// @brief As above, but takes chi from a table made by
+  /// LSDFlowInfo::calculate_base_level_chi rather than computing it.
+	/// @param StartNode Starting node.
+  /// @param EndNode Ending node.
+  /// @param downslope_chi Downslope Chi value.
+  /// @param BaseLevelChi The table of chi, which fixes m over n and A_0.
+	/// @param FlowInfo LSDFlowInfo object.
+	/// @param Elevation_Raster Elevation LSDRaster object.
+  /// @date 16/10/26
+  LSDChannel(int StartNode, int EndNode, float downslope_chi,
+                             vector<double>& BaseLevelChi, LSDFlowInfo& FlowInfo,
+                             LSDRaster& Elevation_Raster)
+							{ create_LSDC(StartNode, EndNode, downslope_chi,
+                              BaseLevelChi, FlowInfo, Elevation_Raster); }
+
 
 
 
@@ -215,6 +230,49 @@ class LSDChannel: public LSDIndexChannel
   /// @date 01/01/12
 	void calculate_chi(float downslope_chi, float m_over_n, float A_0, LSDFlowInfo& FlowInfo );
 
+	/// @brief This function gets the chi values in the channel from a table made
+	/// by LSDFlowInfo::calculate_base_level_chi, so no pow is evaluated.
+	/// @param downslope_chi Downslope Chi value.
+	/// @param BaseLevelChi The table of chi, which fixes m over n and A_0.
+  /// @date 16/10/26
+	void calculate_chi(float downslope_chi, vector<double>& BaseLevelChi);
+
+	/// @brief This calculates the chi values in the channel for n_movern evenly
+	/// spaced values of m over n at once, in the same way as
+	/// LSDChiNetwork::calculate_chi_batch.
+	/// @details The chi values are measured from the bottom node of the channel,
+	/// so they can be used with any downslope chi; see set_chi_from_batch.
+	/// @param A_0 A_0 value.
+	/// @param n_movern Number of m over n values.
+	/// @param d_movern Spacing of the m over n values.
+	/// @param start_movern The first m over n value.
+	/// @param FlowInfo LSDFlowInfo object.
+	/// @return An array with a row for each node and a column for each m over n value.
+  /// @date 16/10/26
+	Array2D<float> calculate_chi_batch(float A_0, int n_movern, float d_movern,
+	                                   float start_movern, LSDFlowInfo& FlowInfo);
+
+	/// @brief This is calculate_chi_batch writing into the array of an earlier call.
+	/// @details The array is reused if it has the right size and is not shared
+	/// with any other Array2D; otherwise it is replaced.
+	/// @param A_0 A_0 value.
+	/// @param n_movern Number of m over n values.
+	/// @param d_movern Spacing of the m over n values.
+	/// @param start_movern The first m over n value.
+	/// @param FlowInfo LSDFlowInfo object.
+	/// @param ChiBatch Overwritten with the array calculate_chi_batch returns.
+  /// @date 16/10/26
+	void calculate_chi_batch(float A_0, int n_movern, float d_movern, float start_movern,
+	                         LSDFlowInfo& FlowInfo, Array2D<float>& ChiBatch);
+
+	/// @brief This sets the chi values in the channel to one of the m over n
+	/// values of calculate_chi_batch, in place of calling calculate_chi.
+	/// @param downslope_chi Downslope Chi value.
+	/// @param ChiBatch The array from calculate_chi_batch.
+	/// @param movn The index of the m over n value.
+  /// @date 16/10/26
+	void set_chi_from_batch(float downslope_chi, Array2D<float>& ChiBatch, int movn);
+
 	/// @brief Get chi value at channel node.
 	/// @param ch_node Integer node index.
 	/// @return chi value at channel node.
@@ -290,6 +348,14 @@ class LSDChannel: public LSDIndexChannel
   int calculate_channel_heads(int min_seg_length_for_channel_heads, float A_0, 
                                             float m_over_n, LSDFlowInfo& FlowInfo);
 
+  /// @brief As above, with chi taken from a table made by
+  /// LSDFlowInfo::calculate_base_level_chi.
+  /// @param min_seg_length_for_channel_heads
+  /// @param BaseLevelChi The table of chi, which fixes m over n and A_0.
+  /// @return The node index of the channel head.
+  /// @date 16/10/26
+  int calculate_channel_heads(int min_seg_length_for_channel_heads, vector<double>& BaseLevelChi);
+
 	protected:
 
 	// This is an inherited class so
@@ -314,6 +380,13 @@ class LSDChannel: public LSDIndexChannel
 	void create_LSDC(float downslope_chi, float m_over_n, float A_0,
 						LSDIndexChannel& InChann, LSDFlowInfo& FlowInfo,
                         LSDRaster& Elevation_Raster);
+	void create_LSDC(int SJN, int EJN, float downslope_chi,
+                             vector<double>& BaseLevelChi, LSDFlowInfo& FlowInfo,
+                             LSDRaster& Elevation_Raster);
+
+	/// @brief Fits the hillslope and channel segments to the chi profile for
+	/// calculate_channel_heads.
+	int fit_channel_head_segments(int min_seg_length_for_channel_heads);
 };
 
 
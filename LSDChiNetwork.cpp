@@ -74,6 +74,7 @@
 #include <algorithm>
 #include <string>
 #include <fstream>
+#include <cmath>
 #include "TNT/tnt.h"
 #include "LSDChiNetwork.hpp"
 #include "LSDMostLikelyPartitionsFinder.hpp"
@@ -1224,6 +1225,115 @@ void LSDChiNetwork::calculate_chi(float A_0, float m_over_n)
 
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// this function calculates the chi values for the channel network for n_movern
+// evenly spaced values of m over n at once. Each node is visited once: the log
+// of A_0/A is taken there and add_chi_batch_node (in LSDStatsTools) builds the
+// chi values of every m over n from it with two exponentials. The values of a
+// node are stored next to each other so that they can be built in simd lanes.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+vector< Array2D<float> > LSDChiNetwork::calculate_chi_batch(float A_0, int n_movern, float d_movern,
+                                                            float start_movern)
+{
+	vector< Array2D<float> > ChiBatch;
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, ChiBatch);
+	return ChiBatch;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// this is calculate_chi_batch writing into the arrays of an earlier call.
+// Allocating and first touching the arrays costs as much as filling them, so
+// an array is reused if it has the right size and is not shared with any
+// other Array2D; otherwise it is replaced by a new one.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void LSDChiNetwork::calculate_chi_batch(float A_0, int n_movern, float d_movern,
+                                        float start_movern, vector< Array2D<float> >& ChiBatch)
+{
+	float dx;				// spacing between nodes
+	float log_area_ratio;
+
+	int n_channels = elevations.size();
+	ChiBatch.resize(n_channels);
+	for (int c = 0; c<n_channels; c++)
+	{
+		vector<float>& flow_distance = flow_distances[c];
+		vector<float>& drainage_area = drainage_areas[c];
+		int n_nodes_in_channel = int(flow_distance.size());
+
+		Array2D<float>& chi = ChiBatch[c];
+		if (chi.dim1() != n_nodes_in_channel || chi.dim2() != n_movern || chi.ref_count() > 1)
+		{
+			chi = Array2D<float>(n_nodes_in_channel,n_movern);
+		}
+		if (n_nodes_in_channel == 0 || n_movern == 0)
+		{
+			continue;
+		}
+
+		if (receiver_channel[c] > c)
+		{
+			cout << "contributing channel has not been calcualted: improper channel ordering" << endl;
+			exit(EXIT_FAILURE);
+		}
+
+		// the downstream chi values come from the receiver channel
+		float* bottom_chi = chi[n_nodes_in_channel-1];
+		if (receiver_channel[c] != c)
+		{
+			float* ds_chi = ChiBatch[receiver_channel[c]][node_on_receiver_channel[c]];
+			for (int movn = 0; movn<n_movern; movn++)
+			{
+				bottom_chi[movn] = ds_chi[movn];
+			}
+		}
+		else
+		{
+			for (int movn = 0; movn<n_movern; movn++)
+			{
+				bottom_chi[movn] = 0.0;
+			}
+		}
+
+		// the channel is arranged with the upstream node first so go through it
+		// in reverse order
+		for (int ChIndex = n_nodes_in_channel-2; ChIndex>=0; ChIndex--)
+		{
+			dx = flow_distance[ChIndex]-flow_distance[ChIndex+1];
+			log_area_ratio = log(A_0/drainage_area[ChIndex]);
+			add_chi_batch_node(dx, log_area_ratio, start_movern, d_movern, n_movern,
+			                   chi[ChIndex+1], chi[ChIndex]);
+		}
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// this copies the chi values of one m over n value of calculate_chi_batch into
+// the chi vectors of the network
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void LSDChiNetwork::set_chi_from_batch(vector< Array2D<float> >& ChiBatch, int movn)
+{
+	int n_channels = ChiBatch.size();
+	for (int c = 0; c<n_channels; c++)
+	{
+		int n_nodes_in_channel = ChiBatch[c].dim1();
+		vector<float>& chi = chis[c];
+		chi.resize(n_nodes_in_channel);
+		for (int node = 0; node<n_nodes_in_channel; node++)
+		{
+			chi[node] = ChiBatch[c][node][movn];
+		}
+	}
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
 
@@ -3970,6 +4080,10 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_dchi(float A_0, int n_movern,
   	vector<float> elev_fitted;
 	vector<int> node_ref_thinned;
 
+	// chi for all the m over n values is calculated at once, in the arrays of
+	// the last search
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, chi_batches);
+
   	// loop through m_over_n values
 	for(int movn = 0; movn< n_movern; movn++)
   	{
@@ -3977,7 +4091,7 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_dchi(float A_0, int n_movern,
 	  	cout << "m/n: " << m_over_n << endl;
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
   		dchi = calculate_optimal_chi_spacing(target_nodes_mainstem);
 
    		vector<float> MLEs_thischan(n_channels);
@@ -4267,6 +4381,10 @@ float LSDChiNetwork::search_for_best_fit_m_over_n(float A_0, int n_movern, float
 
 	int N = calculate_skip(target_nodes_mainstem);
 
+	// chi for all the m over n values is calculated at once, in the arrays of
+	// the last search
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, chi_batches);
+
   	// loop through m_over_n values
 	for(int movn = 0; movn< n_movern; movn++)
   	{
@@ -4274,7 +4392,7 @@ float LSDChiNetwork::search_for_best_fit_m_over_n(float A_0, int n_movern, float
 	  	cout << "m/n: " << m_over_n << endl;
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
 
    		vector<float> MLEs_thischan(n_channels);
 		vector<int> n_segs_thischan(n_channels);
@@ -4559,6 +4677,10 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_colinearity_test(float A_0, in
 	cout << "looping starting line 4280" << endl;
 
 
+	// chi for all the m over n values is calculated at once, in the arrays of
+	// the last search
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, chi_batches);
+
   	// loop through m over n
 	for(int movn = 0; movn< n_movern; movn++)
   	{
@@ -4577,7 +4699,7 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_colinearity_test(float A_0, in
 		sorted_elev = empty_vec;
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
 
 	  	// now load all the chis and elevations into individual vectors
 	  	for(int chan = 0; chan<n_channels; chan++)
@@ -4738,6 +4860,10 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_colinearity_test_with_breaks(f
 	cout << "looping line 4456" << endl;
 
 
+	// chi for all the m over n values is calculated at once, in the arrays of
+	// the last search
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, chi_batches);
+
   	// loop through m over n
 	for(int movn = 0; movn< n_movern; movn++)
   	{
@@ -4765,7 +4891,7 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_colinearity_test_with_breaks(f
 		//cout << "LINE 4483 reset_vectors" << endl;
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
 
 	  	//cout << "LINE 4488 calculated_chi" << endl;
 
@@ -5090,13 +5216,17 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_seperate_ms_and_tribs(float A_
 	int N = calculate_skip(target_nodes_mainstem);
 	int ms_N = N;
 	cout << "LSDCN line 2470, ms N is: " << N << endl;
+	// chi for all the m over n values is calculated at once, in the arrays of
+	// the last search
+	calculate_chi_batch(A_0, n_movern, d_movern, start_movern, chi_batches);
+
 	for(int movn = 0; movn< n_movern; movn++)
   	{
 		m_over_n = float(movn)*d_movern+start_movern;
 
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
 
 		int chan = 0;
 		// get the channels for this m over n ratio
@@ -5159,7 +5289,7 @@ float LSDChiNetwork::search_for_best_fit_m_over_n_seperate_ms_and_tribs(float A_
 	  	cout << "m/n: " << m_over_n << endl;
 
       	// get the transformed channel profiles for this m_over_n
-	  	calculate_chi(A_0, m_over_n);
+	  	set_chi_from_batch(chi_batches, movn);
 
    		vector<float> MLEs_thischan(n_channels);
 		vector<int> n_segs_thischan(n_channels);
@@ -268,6 +268,46 @@ class LSDChiNetwork
   		/// @date 01/04/13
 		void calculate_chi(float A_0, float m_over_n);
 
+		/// @brief This function calculates the chi values of the channel network for a
+		/// whole range of m over n values in one pass through the channels.
+		///
+    /// @details log(A_0/A) of each node is taken once and shared by all the m over n
+    /// values. Since the values are evenly spaced, a node needs two exps, for the
+    /// first value and the step between values; the rest are a multiplication each. The values of a node are next to each
+    /// other, so the loops over them can be vectorised.
+		/// @param A_0 A_0 value.
+		/// @param n_movern Number of m over n values.
+		/// @param d_movern Spacing of the m over n values.
+		/// @param start_movern The first m over n value. Value movn is
+		/// float(movn)*d_movern+start_movern, as in the m over n searches.
+		/// @return An array for each channel with a row for each node and a column
+		/// for each m over n value.
+  		/// @date 16/10/26
+		vector< Array2D<float> > calculate_chi_batch(float A_0, int n_movern, float d_movern,
+		                                             float start_movern);
+
+		/// @brief This is calculate_chi_batch writing into the arrays of an earlier call.
+		///
+		/// @details An array is reused if it has the right size and is not shared with
+		/// any other Array2D, which saves allocating and first touching it; otherwise it
+		/// is replaced. The m over n searches keep their arrays in chi_batches.
+		/// @param A_0 A_0 value.
+		/// @param n_movern Number of m over n values.
+		/// @param d_movern Spacing of the m over n values.
+		/// @param start_movern The first m over n value.
+		/// @param ChiBatch Overwritten with an array for each channel, as returned by
+		/// calculate_chi_batch.
+  		/// @date 16/10/26
+		void calculate_chi_batch(float A_0, int n_movern, float d_movern,
+		                         float start_movern, vector< Array2D<float> >& ChiBatch);
+
+		/// @brief This sets the chi values of the channel network to one of the m over n
+		/// values of calculate_chi_batch, in place of calling calculate_chi.
+		/// @param ChiBatch The arrays from calculate_chi_batch.
+		/// @param movn The index of the m over n value.
+  		/// @date 16/10/26
+		void set_chi_from_batch(vector< Array2D<float> >& ChiBatch, int movn);
+
 		/// @brief This function calucaltes the chi spacing of the main stem channel (the longest channel).
 		///
     /// @details The maximum length of the dataset will be in the main stem so this will determine the
@@ -847,6 +887,8 @@ class LSDChiNetwork
 		vector< vector<float> > drainage_areas;
     /// The chi values for the channels. This data will be overwritten as m_over_n changes.
 		vector< vector<float> > chis;
+		/// The chi values of every m over n from the last m over n search, from calculate_chi_batch. They are kept so that the next search can reuse the arrays.
+		vector< Array2D<float> > chi_batches;
     /// This is the node on the reciever channel where the tributary enters the channel. Used to find the downstream chi value of a channel.
 		vector<int> node_on_receiver_channel;
 		/// This is the channel that the tributary enters.
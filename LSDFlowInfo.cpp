@@ -82,6 +82,7 @@
 #include <string>
 #include <algorithm>
 #include <math.h>
+#include <string.h>
 #include "TNT/tnt.h"
 #include "LSDFlowInfo.hpp"
 #include "LSDIndexRaster.hpp"
@@ -93,6 +94,112 @@ using namespace TNT;
 #ifndef LSDFlowInfo_CPP
 #define LSDFlowInfo_CPP
 
+const signed char LSDFlowInfo::FlowDirectionCodeNoData;
+
+// the header of a FlowInfo cache file (see write_cache). It is followed by
+// FlowInfoCacheSections arrays, each starting on a 64 byte boundary: the
+// filled DEM, NodeIndex, FlowDirectionCode, CellIndex, BaseLevelNodeList,
+// ReceiverVector, DeltaVector, DonorStackVector, SVector, SVectorIndex and
+// NContributingNodes. FlowDirectionCode has 1 byte elements and the others 4.
+// Each array has its own checksum (see checksum_words), so that a reader
+// checks only the arrays it uses.
+// The version must be raised whenever this layout changes.
+static const int FlowInfoCacheSections = 11;
+struct FlowInfoCacheHeader
+{
+	char Magic[8];
+	int Version;
+	int NRows;
+	int NCols;
+	int NDataNodes;
+	int NBaseLevelNodes;
+	int NoDataValue;
+	int FlatsResolved;
+	float XMinimum;
+	float YMinimum;
+	float DataResolution;
+	char BoundaryConditions[4];
+	unsigned long long Key;
+	unsigned long long SectionChecksums[FlowInfoCacheSections];
+	unsigned long long FileBytes;
+};
+static const char FlowInfoCacheMagic[8] = "LSDFIC";
+static const int FlowInfoCacheVersion = 4;
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This works out where the arrays of a FlowInfo cache start and how many
+// bytes of data each holds, and returns the size of the file.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static unsigned long long flow_info_cache_layout(const FlowInfoCacheHeader& Header,
+                                                 unsigned long long Offsets[],
+                                                 unsigned long long Bytes[])
+{
+	unsigned long long n_cells = (unsigned long long)(Header.NRows)*Header.NCols;
+	unsigned long long n_nodes = Header.NDataNodes;
+	unsigned long long n_elements[FlowInfoCacheSections] =
+	    { n_cells, n_cells, n_cells, n_nodes, (unsigned long long)(Header.NBaseLevelNodes),
+	      n_nodes, n_nodes+1, n_nodes, n_nodes, n_nodes, n_nodes };
+
+	unsigned long long offset = (sizeof(FlowInfoCacheHeader)+63)/64*64;
+	for (int section = 0; section<FlowInfoCacheSections; section++)
+	{
+		Bytes[section] = ((section == 2) ? 1 : 4)*n_elements[section];
+		Offsets[section] = offset;
+		offset += (Bytes[section]+63)/64*64;
+	}
+	return offset;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This checks that a FlowInfo cache header is of this version, has the key
+// and belongs to a complete file of FileBytes bytes.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static bool flow_info_cache_header_matches(const FlowInfoCacheHeader& Header,
+                                           unsigned long long Key,
+                                           unsigned long long FileBytes)
+{
+	if (memcmp(Header.Magic,FlowInfoCacheMagic,sizeof(FlowInfoCacheMagic)) != 0 ||
+	    Header.Version != FlowInfoCacheVersion || Header.Key != Key ||
+	    Header.NRows < 0 || Header.NCols < 0 || Header.NDataNodes < 0 ||
+	    Header.NBaseLevelNodes < 0)
+	{
+		return false;
+	}
+	unsigned long long Offsets[FlowInfoCacheSections];
+	unsigned long long Bytes[FlowInfoCacheSections];
+	return (Header.FileBytes == FileBytes &&
+	        flow_info_cache_layout(Header,Offsets,Bytes) == FileBytes);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This checks the sections first to last of a mapped FlowInfo cache against
+// the checksums in its header, and stops the program if one does not match,
+// which catches a damaged file.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void check_flow_info_cache_sections(const char* block, const FlowInfoCacheHeader& Header,
+                                           int first, int last, string cache_fname)
+{
+	unsigned long long Offsets[FlowInfoCacheSections];
+	unsigned long long Bytes[FlowInfoCacheSections];
+	flow_info_cache_layout(Header,Offsets,Bytes);
+	for (int section = first; section<=last; section++)
+	{
+		if (checksum_words(block+Offsets[section],size_t(Bytes[section])) !=
+		    Header.SectionChecksums[section])
+		{
+			cout << "\nFATAL ERROR: array " << section << " of the flow info cache \""
+			     << cache_fname << "\" does not match its checksum" << endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Create function, this is empty, you need to include a filename
@@ -118,9 +225,97 @@ void LSDFlowInfo::create()
 void LSDFlowInfo::create(string fname)
 {
 	unpickle(fname);
+	FlatsResolved = false;
 
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Create function, this creates from a cache written by write_cache
+// fname is the name of the cache without the .FIcache extension
+//
+// The file is mapped copy on write and the flow sections are checked against
+// their checksums. Nothing is copied: the full grid arrays and the node
+// vectors are all views of the mapping, which their storage handles keep
+// alive, so they take no memory of their own and changes to them never reach
+// the file.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::create(string fname, unsigned long long Key)
+{
+	string cache_fname = fname+".FIcache";
+	size_t NBytes;
+	LSDStorageHandle Handle;
+	char* block = static_cast<char*>(map_file(cache_fname,NBytes,Handle));
+
+	FlowInfoCacheHeader Header;
+	if (block == NULL || NBytes < sizeof(Header))
+	{
+		cout << "\nFATAL ERROR: the flow info cache \"" << cache_fname
+		     << "\" doesn't exist or is too short" << endl;
+		exit(EXIT_FAILURE);
+	}
+	memcpy(&Header,block,sizeof(Header));
+	if (!flow_info_cache_header_matches(Header,Key,NBytes))
+	{
+		cout << "\nFATAL ERROR: the flow info cache \"" << cache_fname
+		     << "\" is of another version, has another key or is incomplete" << endl;
+		exit(EXIT_FAILURE);
+	}
+	check_flow_info_cache_sections(block,Header,1,FlowInfoCacheSections-1,cache_fname);
+	unsigned long long Offsets[FlowInfoCacheSections];
+	unsigned long long Bytes[FlowInfoCacheSections];
+	flow_info_cache_layout(Header,Offsets,Bytes);
+
+	NRows = Header.NRows;
+	NCols = Header.NCols;
+	XMinimum = Header.XMinimum;
+	YMinimum = Header.YMinimum;
+	DataResolution = Header.DataResolution;
+	NoDataValue = Header.NoDataValue;
+	NDataNodes = Header.NDataNodes;
+	FlatsResolved = (Header.FlatsResolved != 0);
+	CompactLayout = false;
+	BoundaryConditions.assign(4,"");
+	for (int i = 0; i<4; i++)
+	{
+		BoundaryConditions[i] = string(1,Header.BoundaryConditions[i]);
+	}
+
+	NodeIndex = Array2D<int>(NRows,NCols,reinterpret_cast<int*>(block+Offsets[1]));
+	FlowDirectionCode = Array2D<signed char>(NRows,NCols,reinterpret_cast<signed char*>(block+Offsets[2]));
+	NodeIndexStorage = Handle;
+	FlowDirectionCodeStorage = Handle;
+
+	LSDNodeArray* Vectors[FlowInfoCacheSections-3] =
+	    { &CellIndex, &BaseLevelNodeList, &ReceiverVector, &DeltaVector,
+	      &DonorStackVector, &SVector, &SVectorIndex, &NContributingNodes };
+	for (int i = 0; i<FlowInfoCacheSections-3; i++)
+	{
+		Vectors[i]->view(reinterpret_cast<int*>(block+Offsets[i+3]),size_t(Bytes[i+3]/4),Handle);
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This allocates the two NRows*NCols arrays and fills them with no data.
+// They go through LSDRasterStorage so that they are placed in scratch files
+// when those are switched on; they are the biggest arrays in the object.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::allocate_full_grid_arrays()
+{
+	NodeIndex = allocate_raster_array<int>(NRows,NCols,NodeIndexStorage);
+	FlowDirectionCode = allocate_raster_array<signed char>(NRows,NCols,FlowDirectionCodeStorage);
+
+	NodeIndex = NoDataValue;
+	FlowDirectionCode = FlowDirectionCodeNoData;
+}
+
 //
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // algorithms for searching the vectors
@@ -134,32 +329,176 @@ void LSDFlowInfo::retrieve_receiver_information(int current_node,
                                              int& receiver_col)
 {
 	int rn, rr, rc;
-	rn = ReceiverVector[current_node];
-	rr = RowIndex[rn];
-	rc = ColIndex[rn];
+	rn = retrieve_receiver_of_node(current_node);
+	retrieve_current_row_and_col(rn,rr,rc);
 	receiver_node = rn;
 	receiver_row = rr;
 	receiver_col = rc;
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-// algorithms for searching the vectors
-// This gets the row and column of the current node
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This finds the receiver of a node from its flow direction code. The step is
+// wrapped around the DEM, which only happens across periodic boundaries.
 //
-// SMM 01/06/2012
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+int LSDFlowInfo::derive_receiver_of_node(int node) const
+{
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+
+	int row, col;
+	retrieve_current_row_and_col(node,row,col);
+	int code = FlowDirectionCode[row][col];
+	if (code < 0)
+	{
+		return node;
+	}
+	int receive_row = (row+row_offsets[code]+NRows)%NRows;
+	int receive_col = (col+col_offsets[code]+NCols)%NCols;
+	return NodeIndex[receive_row][receive_col];
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This gets the donors of a node. In the compact layout they are the
+// neighbours that drain to the node, plus the node itself if it is its own
+// receiver. They are put in the order of the donor stack: ascending node
+// index, with the node itself swapped to the front.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+int LSDFlowInfo::retrieve_donors_of_node(int node, int* donors) const
+{
+	if (!CompactLayout)
+	{
+		int n_donors = DeltaVector[node+1]-DeltaVector[node];
+		copy(DonorStackVector.begin()+DeltaVector[node],
+		     DonorStackVector.begin()+DeltaVector[node+1],donors);
+		return n_donors;
+	}
+
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+
+	int row, col;
+	retrieve_current_row_and_col(node,row,col);
+	int n_donors = 0;
+	for (int k = 0; k<8; k++)
+	{
+		int donor_row = (row+row_offsets[k]+NRows)%NRows;
+		int donor_col = (col+col_offsets[k]+NCols)%NCols;
+		int donor_node = NodeIndex[donor_row][donor_col];
+		if (donor_node != NoDataValue && donor_node != node &&
+		    derive_receiver_of_node(donor_node) == node)
+		{
+			donors[n_donors] = donor_node;
+			n_donors++;
+		}
+	}
+
+	if (FlowDirectionCode[row][col] < 0)
+	{
+		donors[n_donors] = node;
+		n_donors++;
+	}
+
+	// on a DEM less than three cells across a neighbour can be seen twice
+	sort(donors,donors+n_donors);
+	n_donors = int(unique(donors,donors+n_donors)-donors);
+
+	// as in create, a node that is its own donor is swapped to the front
+	int* self = find(donors,donors+n_donors,node);
+	if (self != donors+n_donors)
+	{
+		swap(donors[0],*self);
+	}
+	return n_donors;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This releases ReceiverVector, DeltaVector and DonorStackVector, which are
+// then found from FlowDirectionCode and NodeIndex when they are needed.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::compact_layout()
+{
+	if (CompactLayout)
+	{
+		return;
+	}
+	ReceiverVector = vector<int>();
+	DeltaVector = vector<int>();
+	DonorStackVector = vector<int>();
+	CompactLayout = true;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This rebuilds ReceiverVector, DeltaVector and DonorStackVector from the
+// compact layout.
+//
+// 16/10/26
 //
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-void LSDFlowInfo::retrieve_current_row_and_col(int current_node,int& curr_row,
-                                             int& curr_col)
+void LSDFlowInfo::full_layout()
 {
-	int cr, cc;
-	cr = RowIndex[current_node];
-	cc = ColIndex[current_node];
-	curr_row = cr;
-	curr_col = cc;
+	if (!CompactLayout)
+	{
+		return;
+	}
+
+	vector<int> receivers(NDataNodes);
+	vector<int> delta(NDataNodes+1);
+	vector<int> donor_stack(NDataNodes);
+	int donors[9];
+	delta[0] = 0;
+	for (int node = 0; node<NDataNodes; node++)
+	{
+		receivers[node] = derive_receiver_of_node(node);
+		int n_donors = retrieve_donors_of_node(node,donors);
+		copy(donors,donors+n_donors,donor_stack.begin()+delta[node]);
+		delta[node+1] = delta[node]+n_donors;
+	}
+
+	ReceiverVector.swap(receivers);
+	DeltaVector.swap(delta);
+	DonorStackVector.swap(donor_stack);
+	CompactLayout = false;
 }
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This returns the donor stack, rebuilding it in the compact layout.
+//
+// 16/10/26
+//
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+vector<int> LSDFlowInfo::get_donorStack() const
+{
+	if (!CompactLayout)
+	{
+		return DonorStackVector;
+	}
 
+	vector<int> donor_stack;
+	donor_stack.reserve(NDataNodes);
+	int donors[9];
+	for (int node = 0; node<NDataNodes; node++)
+	{
+		int n_donors = retrieve_donors_of_node(node,donors);
+		donor_stack.insert(donor_stack.end(),donors,donors+n_donors);
+	}
+	return donor_stack;
+}
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -215,11 +554,13 @@ int LSDFlowInfo::retrieve_node_from_row_and_column(int row, int column)
 //
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDFlowInfo::create(vector<string> temp_BoundaryConditions,
-										  LSDRaster& TopoRaster)
+										  LSDRaster& TopoRaster, bool ResolveFlats)
 {
 
 	// initialize several data members
 	BoundaryConditions = temp_BoundaryConditions;
+	FlatsResolved = ResolveFlats;
+	CompactLayout = false;
 
 	NRows = TopoRaster.NRows;
 	NCols = TopoRaster.NCols;
@@ -228,16 +569,9 @@ void LSDFlowInfo::create(vector<string> temp_BoundaryConditions,
 	NoDataValue = int(TopoRaster.NoDataValue);
 	DataResolution = TopoRaster.DataResolution;
 
-	// Declare matrices for calculating flow routing
-	float one_ov_root2 = 0.707106781;
-	float target_elev;				// a placeholder for the elevation of the potential receiver
-	float slope;
-	float max_slope;				// the maximum slope away from a node
-	int max_slope_index;			// index into the maximum slope
-
 	int row, col;						// index for the rows and column
 	int receive_row,receive_col;
-	string::iterator string_iterator;	// used to get characters from string
+	int flow_direction, flow_length_code;
 
 	// we need logic for all of the boundaries.
 	// there are 3 kinds of edge boundaries:
@@ -258,12 +592,44 @@ void LSDFlowInfo::create(vector<string> temp_BoundaryConditions,
 	// row NRows-1 is the SOUTH boundary
 	// column 0 is the WEST boundary
 	// column NCols-1 is the EAST boundary
-	vector<float> slopes(8,NoDataValue);
-	vector<int> row_kernal(8);
-	vector<int> col_kernal(8);
 	int ndv = NoDataValue;
 	NDataNodes = 0; 			// the number of nodes in the raster that have data
-	int one_if_a_baselevel_node;	// this is a switch used to tag baseleve nodes
+
+	// periodic boundaries come in pairs; this is sorted out once, before any
+	// receivers are found
+	// check for periodic boundary conditions
+	if( BoundaryConditions[0].find("P") == 0 || BoundaryConditions[0].find("p") == 0 )
+	{
+		if( BoundaryConditions[2].find("P") != 0 && BoundaryConditions[2].find("p") != 0 )
+		{
+			cout << "WARNING!!! North boundary is periodic! Changing South boundary to periodic" << endl;
+			BoundaryConditions[2] = "P";
+		}
+	}
+	if( BoundaryConditions[1].find("P") == 0 || BoundaryConditions[1].find("p") == 0 )
+	{
+		if( BoundaryConditions[3].find("P") != 0 && BoundaryConditions[3].find("p") != 0 )
+		{
+			cout << "WARNING!!! East boundary is periodic! Changing West boundary to periodic" << endl;
+			BoundaryConditions[3] = "P";
+		}
+	}
+	if( BoundaryConditions[2].find("P") == 0 || BoundaryConditions[2].find("p") == 0 )
+	{
+		if( BoundaryConditions[0].find("P") != 0 && BoundaryConditions[0].find("p") != 0 )
+		{
+			cout << "WARNING!!! South boundary is periodic! Changing North boundary to periodic" << endl;
+			BoundaryConditions[0] = "P";
+		}
+	}
+	if( BoundaryConditions[3].find("P") == 0 || BoundaryConditions[3].find("p") == 0 )
+	{
+		if( BoundaryConditions[1].find("P") != 0 && BoundaryConditions[1].find("p") != 0 )
+		{
+			cout << "WARNING!!! West boundary is periodic! Changing East boundary to periodic" << endl;
+			BoundaryConditions[1] = "P";
+		}
+	}
 
 	// the first thing you need to do is construct a topoglogy matrix
 	// the donor, receiver, etc lists are as long as the number of nodes.
@@ -273,394 +639,779 @@ void LSDFlowInfo::create(vector<string> temp_BoundaryConditions,
 	// we need to loop through all the data before we calcualte slopes because the
 	// receiver node indices must be known before the slope calculations are run
 	vector<int> empty_vec;
-	RowIndex = empty_vec;
-	ColIndex = empty_vec;
+	CellIndex = empty_vec;
 	BaseLevelNodeList = empty_vec;
 	ReceiverVector = empty_vec;
-	Array2D<int> ndv_raster(NRows,NCols,ndv);
+	allocate_full_grid_arrays();
 
 
-	NodeIndex = ndv_raster.copy();
-	FlowDirection = ndv_raster.copy();
-	FlowLengthCode = ndv_raster.copy();
-
-
-	// loop through the topo data finding places where there is actually data
+	// loop through the topo data finding places where there is actually data.
+	// The cells are counted first so that CellIndex is allocated once
+	LSDRasterView<float> zeta = make_raster_view(TopoRaster.RasterData);
+	LSDRasterView<int> node_index = make_raster_view(NodeIndex);
+	float ndv_float = NoDataValue;
+	long n_data_cells = 0;
+	for (row = 0; row<NRows; row++)
+	{
+		const float* zeta_row = zeta.row(row);
+		for (col = 0; col<NCols; col++)
+		{
+			n_data_cells += (zeta_row[col] != ndv_float);
+		}
+	}
+	CellIndex.reserve(n_data_cells);
 	for (row = 0; row<NRows; row++)
 	{
+		const float* zeta_row = zeta.row(row);
+		int* node_row = node_index.row(row);
 		for (col = 0; col<NCols; col++)
 		{
 			// only do calcualtions if there is data
-			if(TopoRaster.RasterData[row][col] != NoDataValue)
+			if(zeta_row[col] != ndv_float)
 			{
-				RowIndex.push_back(row);
-				ColIndex.push_back(col);
-				NodeIndex[row][col] = NDataNodes;
+				CellIndex.push_back(row*NCols+col);
+				node_row[col] = NDataNodes;
 				NDataNodes++;
 			}
 		}
 	}
 	// now the row and col index are populated by the row and col of the node in row i
 	// and the node index has the indeces into the row and col vectors
-	// next up, make d, delta, and D vectors
-	vector<int> ndn_vec(NDataNodes,0);
-	vector<int> ndn_nodata_vec(NDataNodes,ndv);
-	vector<int> ndn_plusone_vec(NDataNodes+1,0);
+	// next up, make d, delta, and D vectors. They are sized in place rather
+	// than copied from temporary vectors
 	vector<int> w_vector(NDataNodes,0);
+	vector<int> ndonors_vector(NDataNodes,0);
 
-	NDonorsVector = ndn_vec;
-	DonorStackVector = ndn_vec;
-	DeltaVector = ndn_plusone_vec;
+	DonorStackVector.assign(NDataNodes,0);
+	DeltaVector.assign(NDataNodes+1,0);
 
-	SVector = ndn_nodata_vec;
-	BLBasinVector = ndn_nodata_vec;
+	SVector.assign(NDataNodes,ndv);
 
-	// this vector starts out empty and then base level nodes are added to it
+	// the receivers of the interior nodes are found in parallel, and then those
+	// of the nodes on the edges, where the boundary conditions come in
+	ReceiverVector.assign(NDataNodes,0);
+	find_interior_receivers(TopoRaster.RasterData);
 	for (row = 0; row<NRows; row++)
 	{
-		for (col = 0; col<NCols; col++)
+		int col_step = (row == 0 || row == NRows-1) ? 1 : max(NCols-1,1);
+		for (col = 0; col<NCols; col += col_step)
 		{
 
 			// only do calcualtions if there is data
 			if(TopoRaster.RasterData[row][col] != NoDataValue)
 			{
 
-				// calcualte 8 slopes
-				// no slopes mean get NoDataValue entries
-				// the algorithm loops through the neighbors to the cells, collecting
-				// receiver indices. The order is
-				// 7 0 1
-				// 6 - 2
-				// 5 4 3
-				// where the above directions are cardinal directions
-				// do slope 0
-				row_kernal[0] = row-1;
-				row_kernal[1] = row-1;
-				row_kernal[2] = row;
-				row_kernal[3] = row+1;
-				row_kernal[4] = row+1;
-				row_kernal[5] = row+1;
-				row_kernal[6] = row;
-				row_kernal[7] = row-1;
-
-				col_kernal[0] = col;
-				col_kernal[1] = col+1;
-				col_kernal[2] = col+1;
-				col_kernal[3] = col+1;
-				col_kernal[4] = col;
-				col_kernal[5] = col-1;
-				col_kernal[6] = col-1;
-				col_kernal[7] = col-1;
-
-
-				// check for periodic boundary conditions
-				if( BoundaryConditions[0].find("P") == 0 || BoundaryConditions[0].find("p") == 0 )
-				{
-					if( BoundaryConditions[2].find("P") != 0 && BoundaryConditions[2].find("p") != 0 )
-					{
-						cout << "WARNING!!! North boundary is periodic! Changing South boundary to periodic" << endl;
-						BoundaryConditions[2] = "P";
-					}
-				}
-				if( BoundaryConditions[1].find("P") == 0 || BoundaryConditions[1].find("p") == 0 )
-				{
-					if( BoundaryConditions[3].find("P") != 0 && BoundaryConditions[3].find("p") != 0 )
-					{
-						cout << "WARNING!!! East boundary is periodic! Changing West boundary to periodic" << endl;
-						BoundaryConditions[3] = "P";
-					}
-				}
-				if( BoundaryConditions[2].find("P") == 0 || BoundaryConditions[2].find("p") == 0 )
+				// find the steepest descent receiver
+				find_receiver(TopoRaster.RasterData,row,col,receive_row,receive_col,
+				              flow_direction,flow_length_code);
+				FlowDirectionCode[row][col] = flow_direction;
+				ReceiverVector[NodeIndex[row][col]] = NodeIndex[receive_row][receive_col];
+			}			// end if there is data conditional
+		}				// end col loop
+	}					// end row loop
+
+	// the base level nodes are listed in node order
+	for (int node = 0; node<NDataNodes; node++)
+	{
+		if (ReceiverVector[node] == node)
+		{
+			BaseLevelNodeList.push_back(node);
+		}
+	}
+
+	// nodes on flats have no lower neighbour, so at this point they are their own
+	// receivers; route them across the flats if asked to
+	if (ResolveFlats)
+	{
+		resolve_flats(TopoRaster.RasterData);
+	}
+
+	//cout << "LINE 1015, NDataNodes: " << NDataNodes
+	//     << " and size reciever: " << ReceiverVector.size() << endl;
+
+	//ofstream receiver_out;
+	//receiver_out.open("receiver_out.txt");
+	//cout << "LINE 414 LSDFlow info, writing receiver nodes to file" << endl;
+	//for (int i =0; i<int(ReceiverVector.size()); i++)
+	//{
+	//	receiver_out << ReceiverVector[i] << endl;
+	//}
+	//receiver_out.close();
+
+	// first create the number of donors vector
+	// from braun and willett eq. 5
+	for(int i = 0; i<NDataNodes; i++)
+	{
+		ndonors_vector[ ReceiverVector[i] ]++;
+	}
+
+	// now create the delta vector
+	// this starts on the last element and works its way backwards
+	// from Braun and Willett eq 7 and 8
+	DeltaVector[NDataNodes] = NDataNodes;
+	for(int i = NDataNodes; i>0; i--)
+	{
+		DeltaVector[i-1] = DeltaVector[i] -  ndonors_vector[i-1];
+	}
+
+	// now the DonorStack and the r vectors. These come from Braun and Willett
+	// equation 9.
+	// Note that in the manscript I have there is a typo in eqaution 9
+	// (Jean Braun's code is correct)
+	// it should be w_{r_i} = w_{r_i}+1
+	int r_index;
+	int w_index;
+	int delta_index;
+	for (int i = 0; i<NDataNodes; i++)
+	{
+		r_index = ReceiverVector[i];
+		delta_index = DeltaVector[ r_index ];
+		w_index = w_vector[ r_index ];
+		DonorStackVector[  delta_index+w_index ] = i;
+		w_vector[r_index] += 1;
+		//cout << "i: " << i << " r_i: " << r_index << " delta_i: " << delta_index << " w_index: " << w_index << endl;
+	}
+
+	// now go through the base level node list, building the drainage tree for each of these nodes as one goes along
+	// The basins do not share any nodes, so they are built in parallel, each
+	// into a buffer of the thread that builds it, and then copied into the
+	// stack one after another in the order of BaseLevelNodeList. The tree of
+	// a basin is the depth first order of add_to_stack (Braun and Willett
+	// eq. 12 and 13), walked with a stack of nodes rather than by recursion.
+	int n_base_level_nodes;
+	n_base_level_nodes = BaseLevelNodeList.size();
+	vector<int> BasinStart(n_base_level_nodes+1,0);
+
+	#pragma omp parallel
+	{
+		vector<int> ThreadStack;				// the basins built by this thread
+		vector<int> ThreadBasins;				// which basins they are
+		vector<int> ThreadBasinStart;			// and where they start in ThreadStack
+		vector<int> NodeStack;
+
+		#pragma omp for schedule(dynamic)
+		for (int i = 0; i<n_base_level_nodes; i++)
+		{
+			int k = BaseLevelNodeList[i];			// set k to the base level node
+
+			// This doesn't seem to be in Braun and Willet but to get the ordering correct you
+			// need to make sure that the base level node appears first in the donorstack
+			// of nodes contributing to the baselevel node.
+			// For example, if base level node is 4, with 4 donors
+			// and the donor stack has 3 4 8 9
+			// the code has to put the 4 first.
+			if (DonorStackVector[ DeltaVector[k] ] != k)
+			{
+				int this_index = DonorStackVector[ DeltaVector[k] ];
+				int bs_node = k;
+
+				for(int ds_node = 1; ds_node < ndonors_vector[k]; ds_node++)
 				{
-					if( BoundaryConditions[0].find("P") != 0 && BoundaryConditions[0].find("p") != 0 )
+					if( DonorStackVector[ DeltaVector[k] + ds_node ] == bs_node )
 					{
-						cout << "WARNING!!! South boundary is periodic! Changing North boundary to periodic" << endl;
-						BoundaryConditions[0] = "P";
+						DonorStackVector[ DeltaVector[k] ] = k;
+						DonorStackVector[ DeltaVector[k] + ds_node ] = this_index;
 					}
 				}
-				if( BoundaryConditions[3].find("P") == 0 || BoundaryConditions[3].find("p") == 0 )
+			}
+
+			// now walk the tree. The donors are pushed in reverse so that they come
+			// off the stack in the order add_to_stack visits them, and the base
+			// level node, which is its own donor, is not expanded again
+			ThreadBasins.push_back(i);
+			ThreadBasinStart.push_back(ThreadStack.size());
+			for (int d = DeltaVector[k+1]-1; d>=DeltaVector[k]; d--)
+			{
+				NodeStack.push_back(DonorStackVector[d]);
+			}
+			while (!NodeStack.empty())
+			{
+				int node = NodeStack.back();
+				NodeStack.pop_back();
+				ThreadStack.push_back(node);
+				if (node != k)
 				{
-					if( BoundaryConditions[1].find("P") != 0 && BoundaryConditions[1].find("p") != 0 )
+					for (int d = DeltaVector[node+1]-1; d>=DeltaVector[node]; d--)
 					{
-						cout << "WARNING!!! West boundary is periodic! Changing East boundary to periodic" << endl;
-						BoundaryConditions[1] = "P";
+						NodeStack.push_back(DonorStackVector[d]);
 					}
 				}
+			}
+			BasinStart[i+1] = ThreadStack.size()-ThreadBasinStart.back();
+		}
 
-				// reset baselevel switch for boundaries
-				one_if_a_baselevel_node = 0;
+		// the basin sizes become their starts in the stack
+		#pragma omp single
+		{
+			for (int i = 0; i<n_base_level_nodes; i++)
+			{
+				BasinStart[i+1] += BasinStart[i];
+			}
+		}
 
-				// NORTH BOUNDARY
-				if (row == 0)
-				{
-					if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
-					{
-						one_if_a_baselevel_node = 1;
-					}
-					else
-					{
-						// if periodic, reflect across to south boundary
-						if( BoundaryConditions[0].find("P") == 0 || BoundaryConditions[0].find("p") == 0 )
-						{
-							row_kernal[0] = NRows-1;
-							row_kernal[1] = NRows-1;
-							row_kernal[7] = NRows-1;
-						}
-						else
-						{
-							row_kernal[0] = ndv;
-							row_kernal[1] = ndv;
-							row_kernal[7] = ndv;
-						}
-					}
-				}
-				// EAST BOUNDAY
-				if (col == NCols-1)
+		for (int b = 0; b<int(ThreadBasins.size()); b++)
+		{
+			int i = ThreadBasins[b];
+			int j_index = BasinStart[i];
+			int n_nodes = BasinStart[i+1]-BasinStart[i];
+			copy(ThreadStack.begin()+ThreadBasinStart[b],ThreadStack.begin()+ThreadBasinStart[b]+n_nodes,
+			     SVector.begin()+j_index);
+		}
+	}					// end parallel region
+
+	// now calcualte the indices
+	calculate_upslope_reference_indices();
+
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This finds the steepest descent receiver of the node at row and col, together
+// with its flow direction and flow length code, following the boundary
+// conditions. Base level nodes, and nodes with no lower neighbour, are their
+// own receivers and get a flow length code of 0.
+// It is the per node part of create, and is also used when the flow routing
+// is patched after an edit (update_for_edited_region).
+//
+// SMM 01/06/2012, split out of create 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::find_receiver(Array2D<float>& zeta, int row, int col,
+                                int& receive_row, int& receive_col,
+                                int& flow_direction, int& flow_length_code)
+{
+	float one_ov_root2 = 0.707106781;
+	float target_elev;				// a placeholder for the elevation of the potential receiver
+	float slope;
+	float max_slope;				// the maximum slope away from a node
+	int max_slope_index;			// index into the maximum slope
+	int ndv = NoDataValue;
+	int one_if_a_baselevel_node;	// this is a switch used to tag baseleve nodes
+
+	vector<float> slopes(8,NoDataValue);
+	vector<int> row_kernal(8);
+	vector<int> col_kernal(8);
+
+	// calcualte 8 slopes
+	// no slopes mean get NoDataValue entries
+	// the algorithm loops through the neighbors to the cells, collecting
+	// receiver indices. The order is
+	// 7 0 1
+	// 6 - 2
+	// 5 4 3
+	// where the above directions are cardinal directions
+	// do slope 0
+	row_kernal[0] = row-1;
+	row_kernal[1] = row-1;
+	row_kernal[2] = row;
+	row_kernal[3] = row+1;
+	row_kernal[4] = row+1;
+	row_kernal[5] = row+1;
+	row_kernal[6] = row;
+	row_kernal[7] = row-1;
+
+	col_kernal[0] = col;
+	col_kernal[1] = col+1;
+	col_kernal[2] = col+1;
+	col_kernal[3] = col+1;
+	col_kernal[4] = col;
+	col_kernal[5] = col-1;
+	col_kernal[6] = col-1;
+	col_kernal[7] = col-1;
+
+	// reset baselevel switch for boundaries
+	one_if_a_baselevel_node = 0;
+
+	// NORTH BOUNDARY
+	if (row == 0)
+	{
+		if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
+		{
+			one_if_a_baselevel_node = 1;
+		}
+		else
+		{
+			// if periodic, reflect across to south boundary
+			if( BoundaryConditions[0].find("P") == 0 || BoundaryConditions[0].find("p") == 0 )
+			{
+				row_kernal[0] = NRows-1;
+				row_kernal[1] = NRows-1;
+				row_kernal[7] = NRows-1;
+			}
+			else
+			{
+				row_kernal[0] = ndv;
+				row_kernal[1] = ndv;
+				row_kernal[7] = ndv;
+			}
+		}
+	}
+	// EAST BOUNDAY
+	if (col == NCols-1)
+	{
+		if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
+		{
+			one_if_a_baselevel_node = 1;
+		}
+		else
+		{
+			if( BoundaryConditions[1].find("P") == 0 || BoundaryConditions[1].find("p") == 0)
+			{
+				col_kernal[1] = 0;
+				col_kernal[2] = 0;
+				col_kernal[3] = 0;
+			}
+			else
+			{
+				col_kernal[1] = ndv;
+				col_kernal[2] = ndv;
+				col_kernal[3] = ndv;
+			}
+		}
+	}
+	// SOUTH BOUNDARY
+	if (row == NRows-1)
+	{
+		if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
+		{
+			one_if_a_baselevel_node = 1;
+		}
+		else
+		{
+			if( BoundaryConditions[2].find("P") == 0 || BoundaryConditions[2].find("p") == 0)
+			{
+				row_kernal[3] = 0;
+				row_kernal[4] = 0;
+				row_kernal[5] = 0;
+			}
+			else
+			{
+				row_kernal[3] = ndv;
+				row_kernal[4] = ndv;
+				row_kernal[5] = ndv;
+			}
+		}
+	}
+	// WEST BOUNDARY
+	if (col == 0)
+	{
+		if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
+		{
+			one_if_a_baselevel_node = 1;
+		}
+		else
+		{
+			if( BoundaryConditions[3].find("P") == 0 || BoundaryConditions[3].find("p") == 0)
+			{
+				col_kernal[5] = NCols-1;
+				col_kernal[6] = NCols-1;
+				col_kernal[7] = NCols-1;
+			}
+			else
+			{
+				col_kernal[5] = ndv;
+				col_kernal[6] = ndv;
+				col_kernal[7] = ndv;
+			}
+		}
+	}
+
+	// now loop through the surrounding nodes, calcualting the slopes
+	// slopes with NoData get NoData slopes
+	// reminder of ordering:
+	// 7 0 1
+	// 6 - 2
+	// 5 4 3
+	// first logic for baselevel node
+	if (one_if_a_baselevel_node == 1)
+	{
+		// get reciever index
+		flow_direction = -1;
+		receive_row = row;
+		receive_col = col;
+		flow_length_code = 0;
+	}
+	// now the rest of the nodes
+	else
+	{
+		flow_length_code = 0;		// set flow length code to 0, this gets reset
+									// if there is a maximum slope
+		max_slope = 0;
+		max_slope_index = -1;
+		receive_row = row;
+		receive_col = col;
+		for (int slope_iter = 0; slope_iter<8; slope_iter++)
+		{
+			if (row_kernal[slope_iter] == ndv || col_kernal[slope_iter] == ndv)
+			{
+				slopes[slope_iter] = NoDataValue;
+			}
+			else
+			{
+				target_elev = zeta[ row_kernal[slope_iter] ][ col_kernal[slope_iter] ];
+				if(target_elev == NoDataValue)
 				{
-					if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
-					{
-						one_if_a_baselevel_node = 1;
-					}
-					else
-					{
-						if( BoundaryConditions[1].find("P") == 0 || BoundaryConditions[1].find("p") == 0)
-						{
-							col_kernal[1] = 0;
-							col_kernal[2] = 0;
-							col_kernal[3] = 0;
-						}
-						else
-						{
-							col_kernal[1] = ndv;
-							col_kernal[2] = ndv;
-							col_kernal[3] = ndv;
-						}
-					}
+					slopes[slope_iter] = NoDataValue;
 				}
-				// SOUTH BOUNDARY
-				if (row == NRows-1)
+				else
 				{
-					if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
+					if(slope_iter%2 == 0)
 					{
-						one_if_a_baselevel_node = 1;
+						//cout << "LINE 988, cardinal direction, slope iter = " << slope_iter << endl;
+						slope = zeta[row][col]-target_elev;
 					}
 					else
 					{
-						if( BoundaryConditions[2].find("P") == 0 || BoundaryConditions[2].find("p") == 0)
-						{
-							row_kernal[3] = 0;
-							row_kernal[4] = 0;
-							row_kernal[5] = 0;
-						}
-						else
-						{
-							row_kernal[3] = ndv;
-							row_kernal[4] = ndv;
-							row_kernal[5] = ndv;
-						}
-					}
-				}
-				// WEST BOUNDARY
-				if (col == 0)
-				{
-					if( BoundaryConditions[0].find("B") == 0 || BoundaryConditions[0].find("b") == 0 )
-					{
-						one_if_a_baselevel_node = 1;
+						slope = one_ov_root2*(zeta[row][col]-target_elev);
 					}
-					else
+
+					if (slope > max_slope)
 					{
-						if( BoundaryConditions[3].find("P") == 0 || BoundaryConditions[3].find("p") == 0)
+						max_slope_index = slope_iter;
+						receive_row = row_kernal[slope_iter];
+						receive_col = col_kernal[slope_iter];
+						max_slope = slope;
+						if(slope_iter%2 == 0)
 						{
-							col_kernal[5] = NCols-1;
-							col_kernal[6] = NCols-1;
-							col_kernal[7] = NCols-1;
+							flow_length_code = 1;
 						}
 						else
 						{
-							col_kernal[5] = ndv;
-							col_kernal[6] = ndv;
-							col_kernal[7] = ndv;
+							flow_length_code = 2;
 						}
 					}
 				}
+			}
+		}
+		// get reciever index
+		flow_direction = max_slope_index;
+	}		// end if baselevel boundary  conditional
+}
 
-				// now loop through the surrounding nodes, calcualting the slopes
-				// slopes with NoData get NoData slopes
-				// reminder of ordering:
-				// 7 0 1
-				// 6 - 2
-				// 5 4 3
-				// first logic for baselevel node
-				if (one_if_a_baselevel_node == 1)
-				{
-					// get reciever index
-					FlowDirection[row][col] = -1;
-					ReceiverVector.push_back(NodeIndex[row][col]);
-					FlowLengthCode[row][col] = 0;
-				}
-				// now the rest of the nodes
-				else
-				{
-					FlowLengthCode[row][col] = 0;		// set flow length code to 0, this gets reset
-														// if there is a maximum slope
-					max_slope = 0;
-					max_slope_index = -1;
-					receive_row = row;
-					receive_col = col;
-					for (int slope_iter = 0; slope_iter<8; slope_iter++)
-					{
-						if (row_kernal[slope_iter] == ndv || col_kernal[slope_iter] == ndv)
-						{
-							slopes[slope_iter] = NoDataValue;
-						}
-						else
-						{
-							target_elev = TopoRaster.RasterData[ row_kernal[slope_iter] ][ col_kernal[slope_iter] ];
-							if(target_elev == NoDataValue)
-							{
-								slopes[slope_iter] = NoDataValue;
-							}
-							else
-							{
-								if(slope_iter%2 == 0)
-								{
-									//cout << "LINE 988, cardinal direction, slope iter = " << slope_iter << endl;
-									slope = TopoRaster.RasterData[row][col]-target_elev;
-								}
-								else
-								{
-									slope = one_ov_root2*(TopoRaster.RasterData[row][col]-target_elev);
-								}
-
-								if (slope > max_slope)
-								{
-									max_slope_index = slope_iter;
-									receive_row = row_kernal[slope_iter];
-									receive_col = col_kernal[slope_iter];
-									max_slope = slope;
-									if(slope_iter%2 == 0)
-									{
-										FlowLengthCode[row][col] = 1;
-									}
-									else
-									{
-										FlowLengthCode[row][col] = 2;
-									}
-								}
-							}
-						}
-					}
-					// get reciever index
-					FlowDirection[row][col] = max_slope_index;
-					ReceiverVector.push_back(NodeIndex[receive_row][receive_col]);
-				}		// end if baselevel boundary  conditional
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This is the interior part of the receiver search in create. It gives exactly
+// the receivers of find_receiver, with the same slopes and the same tie break
+// (the first of the steepest neighbours in the order 0 to 7), but nodes off
+// the edges have all their neighbours in the grid, so the neighbours are a
+// fixed number of cells away in the raster block and there are no boundary
+// conditions to check. Each row writes only its own nodes, so the rows are
+// shared out between threads.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::find_interior_receivers(Array2D<float>& zeta)
+{
+	LSDRasterView<float> z = make_raster_view(zeta);
+	float one_ov_root2 = 0.707106781;
+	float ndv = NoDataValue;
+
+	// the neighbours in the order
+	// 7 0 1
+	// 6 - 2
+	// 5 4 3
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+	long offsets[8];
+	for (int n = 0; n<8; n++)
+	{
+		offsets[n] = row_offsets[n]*z.Stride+col_offsets[n];
+	}
+	const float distance_factor[8] = {1, one_ov_root2, 1, one_ov_root2, 1, one_ov_root2, 1, one_ov_root2};
+
+	// NodeIndex and FlowDirectionCode have the same shape as the DEM, so the
+	// same flat index and offsets step through them
+	LSDRasterView<int> node_index = make_raster_view(NodeIndex);
+	LSDRasterView<signed char> codes = make_raster_view(FlowDirectionCode);
 
-				// if the node is a base level node, add it to the base level node list
-				if (FlowLengthCode[row][col] == 0)
+	#pragma omp parallel for schedule(static)
+	for (int row = 1; row<NRows-1; row++)
+	{
+		for (int col = 1; col<NCols-1; col++)
+		{
+			long i = z.index(row,col);
+			float here = z[i];
+			if (here == ndv)
+			{
+				continue;
+			}
+
+			// a nodata neighbour gets a slope of zero, which never beats the
+			// starting max_slope, so the slopes are worked out without branches
+			// and only the comparisons are done one at a time
+			float slopes[8];
+			for (int n = 0; n<8; n++)
+			{
+				float target_elev = z[i+offsets[n]];
+				slopes[n] = (target_elev == ndv) ? 0 : distance_factor[n]*(here-target_elev);
+			}
+			float max_slope = 0;
+			int max_slope_index = -1;
+			for (int n = 0; n<8; n++)
+			{
+				if (slopes[n] > max_slope)
 				{
-					BaseLevelNodeList.push_back(NodeIndex[row][col]);
+					max_slope = slopes[n];
+					max_slope_index = n;
 				}
-			}			// end if there is data conditional
-		}				// end col loop
-	}					// end row loop
+			}
 
-	//cout << "LINE 1015, NDataNodes: " << NDataNodes
-	//     << " and size reciever: " << ReceiverVector.size() << endl;
+			int node = node_index[i];
+			codes[i] = max_slope_index;
+			ReceiverVector[node] = (max_slope_index == -1) ? node : node_index[i+offsets[max_slope_index]];
+		}
+	}
+}
 
-	//ofstream receiver_out;
-	//receiver_out.open("receiver_out.txt");
-	//cout << "LINE 414 LSDFlow info, writing receiver nodes to file" << endl;
-	//for (int i =0; i<int(ReceiverVector.size()); i++)
-	//{
-	//	receiver_out << ReceiverVector[i] << endl;
-	//}
-	//receiver_out.close();
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This routes flow across flats without touching the DEM, following
+// Barnes, Lehman and Mulla (2014), An efficient assignment of drainage direction
+// over flat surfaces in raster digital elevation models, Computers & Geosciences
+// 62, 128-135.
+//
+// An unresolved node is one that find_receiver left as its own receiver and that
+// is not an outlet: the edges of the DEM and nodes next to nodata drain out of
+// the DEM (they are where the fill spills), so they stay base level nodes.
+// Low edges are the nodes next to an unresolved node of the same elevation that
+// drain already; high edges are unresolved nodes next to higher terrain.
+// Each flat that can drain is labelled from its low edges, and then two
+// breadth first searches measure every node of the flat's distance from
+// higher terrain and to lower terrain. They are combined into a mask,
+//   2*(distance to lower) + (largest distance from higher - distance from higher),
+// which falls strictly towards the low edges, so routing each node to its
+// lowest masked neighbour in the same flat cannot form a loop and ends on a low
+// edge. The first term drains the flat and the second draws flow away from
+// the higher ground around it, so the flow lines run down the middle of
+// valleys rather than along their sides.
+//
+// Every node is put in each queue at most a few times, so this is linear.
+// Flats inside periodic edges are only resolved within the grid.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::resolve_flats(Array2D<float>& zeta)
+{
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
 
-	// first create the number of donors vector
-	// from braun and willett eq. 5
-	for(int i = 0; i<NDataNodes; i++)
+	// find the unresolved nodes
+	vector<char> Unresolved(NDataNodes,0);
+	for (int node = 0; node<NDataNodes; node++)
 	{
-		NDonorsVector[ ReceiverVector[i] ]++;
+		if (ReceiverVector[node] != node)
+		{
+			continue;
+		}
+		int row, col;
+		retrieve_current_row_and_col(node,row,col);
+		if (row == 0 || row == NRows-1 || col == 0 || col == NCols-1)
+		{
+			continue;
+		}
+		bool is_outlet = false;
+		for (int n = 0; n<8; n++)
+		{
+			if (NodeIndex[row+row_offsets[n]][col+col_offsets[n]] == NoDataValue)
+			{
+				is_outlet = true;
+				break;
+			}
+		}
+		if (!is_outlet)
+		{
+			Unresolved[node] = 1;
+		}
 	}
 
-	// now create the delta vector
-	// this starts on the last element and works its way backwards
-	// from Braun and Willett eq 7 and 8
-	DeltaVector[NDataNodes] = NDataNodes;
-	for(int i = NDataNodes; i>0; i--)
+	// find the low and high edges
+	vector<int> LowEdges;
+	vector<int> HighEdges;
+	vector<char> IsLowEdge(NDataNodes,0);
+	for (int node = 0; node<NDataNodes; node++)
 	{
-		DeltaVector[i-1] = DeltaVector[i] -  NDonorsVector[i-1];
+		int row, col;
+		retrieve_current_row_and_col(node,row,col);
+		float z = zeta[row][col];
+		for (int n = 0; n<8; n++)
+		{
+			int nrow = row+row_offsets[n];
+			int ncol = col+col_offsets[n];
+			if (nrow < 0 || nrow >= NRows || ncol < 0 || ncol >= NCols ||
+			    NodeIndex[nrow][ncol] == NoDataValue)
+			{
+				continue;
+			}
+			int neighbour = NodeIndex[nrow][ncol];
+			if (Unresolved[node] == 1 && zeta[nrow][ncol] > z)
+			{
+				HighEdges.push_back(node);
+				break;
+			}
+			if (Unresolved[node] == 0 && Unresolved[neighbour] == 1 && zeta[nrow][ncol] == z)
+			{
+				LowEdges.push_back(node);
+				IsLowEdge[node] = 1;
+				break;
+			}
+		}
 	}
 
-	// now the DonorStack and the r vectors. These come from Braun and Willett
-	// equation 9.
-	// Note that in the manscript I have there is a typo in eqaution 9
-	// (Jean Braun's code is correct)
-	// it should be w_{r_i} = w_{r_i}+1
-	int r_index;
-	int w_index;
-	int delta_index;
-	for (int i = 0; i<NDataNodes; i++)
+	// label the flats that can drain, flooding out from their low edges
+	vector<int> FlatLabel(NDataNodes,0);
+	int NFlats = 0;
+	vector<int> Flood;
+	for (int i = 0; i<int(LowEdges.size()); i++)
 	{
-		r_index = ReceiverVector[i];
-		delta_index = DeltaVector[ r_index ];
-		w_index = w_vector[ r_index ];
-		DonorStackVector[  delta_index+w_index ] = i;
-		w_vector[r_index] += 1;
-		//cout << "i: " << i << " r_i: " << r_index << " delta_i: " << delta_index << " w_index: " << w_index << endl;
+		if (FlatLabel[LowEdges[i]] != 0)
+		{
+			continue;
+		}
+		NFlats++;
+		int row, col;
+		retrieve_current_row_and_col(LowEdges[i],row,col);
+		float z = zeta[row][col];
+		FlatLabel[LowEdges[i]] = NFlats;
+		Flood.push_back(LowEdges[i]);
+		while (!Flood.empty())
+		{
+			int node = Flood.back();
+			Flood.pop_back();
+			retrieve_current_row_and_col(node,row,col);
+			for (int n = 0; n<8; n++)
+			{
+				int nrow = row+row_offsets[n];
+				int ncol = col+col_offsets[n];
+				if (nrow < 0 || nrow >= NRows || ncol < 0 || ncol >= NCols ||
+				    NodeIndex[nrow][ncol] == NoDataValue)
+				{
+					continue;
+				}
+				int neighbour = NodeIndex[nrow][ncol];
+				if (FlatLabel[neighbour] == 0 && zeta[nrow][ncol] == z &&
+				    (Unresolved[neighbour] == 1 || IsLowEdge[neighbour] == 1))
+				{
+					FlatLabel[neighbour] = NFlats;
+					Flood.push_back(neighbour);
+				}
+			}
+		}
 	}
 
-	// now go through the base level node list, building the drainage tree for each of these nodes as one goes along
-	int n_base_level_nodes;
-	n_base_level_nodes = BaseLevelNodeList.size();
-
-	int k;
-	int j_index;
-	int begin_delta_index, end_delta_index;
-	int l_index;
-
-	j_index = 0;
-	for (int i = 0; i<n_base_level_nodes; i++)
+	// breadth first searches over the unresolved nodes of each flat, one away
+	// from higher terrain and one towards lower terrain. Distances start at 1
+	// so that 0 means not reached
+	vector<int> FlatHeight(NFlats+1,0);
+	vector<int> AwayFromHigher(NDataNodes,0);
+	vector<int> TowardsLower(NDataNodes,0);
+	for (int pass = 0; pass<2; pass++)
 	{
-		k = BaseLevelNodeList[i];			// set k to the base level node
-
-		// This doesn't seem to be in Braun and Willet but to get the ordering correct you
-		// need to make sure that the base level node appears first in the donorstack
-		// of nodes contributing to the baselevel node.
-		// For example, if base level node is 4, with 4 donors
-		// and the donor stack has 3 4 8 9
-		// the code has to put the 4 first.
-		if (DonorStackVector[ DeltaVector[k] ] != k)
+		vector<int>& Distance = (pass == 0) ? AwayFromHigher : TowardsLower;
+		vector<int> Current = (pass == 0) ? HighEdges : LowEdges;
+		vector<int> Next;
+		int loops = 1;
+		while (!Current.empty())
 		{
-			int this_index = DonorStackVector[ DeltaVector[k] ];
-			int bs_node = k;
-
-			for(int ds_node = 1; ds_node < NDonorsVector[k]; ds_node++)
+			for (int i = 0; i<int(Current.size()); i++)
 			{
-				if( DonorStackVector[ DeltaVector[k] + ds_node ] == bs_node )
+				int node = Current[i];
+				int label = FlatLabel[node];
+				if (label == 0 || Distance[node] != 0)
+				{
+					continue;
+				}
+				Distance[node] = loops;
+				if (pass == 0)
+				{
+					FlatHeight[label] = loops;
+				}
+				int row, col;
+				retrieve_current_row_and_col(node,row,col);
+				for (int n = 0; n<8; n++)
 				{
-					DonorStackVector[ DeltaVector[k] ] = k;
-					DonorStackVector[ DeltaVector[k] + ds_node ] = this_index;
+					int nrow = row+row_offsets[n];
+					int ncol = col+col_offsets[n];
+					if (nrow < 0 || nrow >= NRows || ncol < 0 || ncol >= NCols ||
+					    NodeIndex[nrow][ncol] == NoDataValue)
+					{
+						continue;
+					}
+					int neighbour = NodeIndex[nrow][ncol];
+					if (FlatLabel[neighbour] == label && Unresolved[neighbour] == 1 &&
+					    Distance[neighbour] == 0)
+					{
+						Next.push_back(neighbour);
+					}
 				}
 			}
+			Current.swap(Next);
+			Next.clear();
+			loops++;
 		}
+	}
 
-		// now run recursive algorithm
-		begin_delta_index = DeltaVector[k];
-		end_delta_index = DeltaVector[k+1];
-
-		//cout << "base_level_node is: " << k << " begin_index: " << begin_delta_index << " end: " << end_delta_index << endl;
-
-		for (int delta_index = begin_delta_index; delta_index<end_delta_index; delta_index++)
+	// combine the two into the mask
+	vector<int> FlatMask(NDataNodes,0);
+	for (int node = 0; node<NDataNodes; node++)
+	{
+		if (FlatLabel[node] != 0)
 		{
-			l_index = DonorStackVector[delta_index];
-			add_to_stack(l_index, j_index, k);
+			FlatMask[node] = 2*TowardsLower[node];
+			if (AwayFromHigher[node] != 0)
+			{
+				FlatMask[node] += FlatHeight[FlatLabel[node]]-AwayFromHigher[node];
+			}
 		}
 	}
 
-	// now calcualte the indices
-	calculate_upslope_reference_indices();
+	// route every unresolved node of a labelled flat to its lowest masked
+	// neighbour in the same flat
+	for (int node = 0; node<NDataNodes; node++)
+	{
+		if (Unresolved[node] == 0 || FlatLabel[node] == 0)
+		{
+			continue;
+		}
+		int row, col;
+		retrieve_current_row_and_col(node,row,col);
+		int lowest = FlatMask[node];
+		int flow_direction = -1;
+		for (int n = 0; n<8; n++)
+		{
+			int nrow = row+row_offsets[n];
+			int ncol = col+col_offsets[n];
+			if (nrow < 0 || nrow >= NRows || ncol < 0 || ncol >= NCols ||
+			    NodeIndex[nrow][ncol] == NoDataValue)
+			{
+				continue;
+			}
+			int neighbour = NodeIndex[nrow][ncol];
+			if (FlatLabel[neighbour] == FlatLabel[node] && FlatMask[neighbour] < lowest)
+			{
+				lowest = FlatMask[neighbour];
+				flow_direction = n;
+			}
+		}
+		if (flow_direction != -1)
+		{
+			ReceiverVector[node] = NodeIndex[row+row_offsets[flow_direction]][col+col_offsets[flow_direction]];
+			FlowDirectionCode[row][col] = flow_direction;
+		}
+	}
 
+	// the resolved nodes are no longer base level nodes
+	vector<int> Remaining;
+	for (int i = 0; i<int(BaseLevelNodeList.size()); i++)
+	{
+		if (ReceiverVector[BaseLevelNodeList[i]] == BaseLevelNodeList[i])
+		{
+			Remaining.push_back(BaseLevelNodeList[i]);
+		}
+	}
+	BaseLevelNodeList = Remaining;
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -676,7 +1427,6 @@ void LSDFlowInfo::add_to_stack(int lm_index, int& j_index, int bl_node)
 	//cout << "j_index: " << j_index << " and s_vec: " << lm_index << endl;
 
 	SVector[j_index] = lm_index;
-	BLBasinVector[j_index] = bl_node;
 	j_index++;
 
 
@@ -716,6 +1466,15 @@ void LSDFlowInfo::add_to_stack(int lm_index, int& j_index, int bl_node)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDFlowInfo::pickle(string filename)
 {
+	// the pickle holds the full layout
+	if (CompactLayout)
+	{
+		full_layout();
+		pickle(filename);
+		compact_layout();
+		return;
+	}
+
 	string ext = ".FIpickle";
 	string hdr_ext = ".FIpickle.hdr";
 
@@ -747,15 +1506,17 @@ void LSDFlowInfo::pickle(string filename)
 	header_out.close();
 
 
-	cout << "sizes RC indices: " << RowIndex.size() << " " << ColIndex.size() << endl;
+	cout << "sizes cell indices: " << CellIndex.size() << endl;
 	cout << "BLNL size: " << BaseLevelNodeList.size() << endl;
-	cout << "donors: " << NDonorsVector.size() << " Reciev: " << ReceiverVector.size() << endl;
+	cout << "Reciev: " << ReceiverVector.size() << endl;
 	cout << "delta: " << DeltaVector.size() << " S: " << SVector.size() << endl;
-	cout << "donorstack: " << DonorStackVector.size() << " BBasin: " << BLBasinVector.size() << endl;
+	cout << "donorstack: " << DonorStackVector.size() << endl;
 	cout << "SVectorIndex " << SVectorIndex.size() << " NContrib: " << NContributingNodes.size() << endl;
 
 
-	// now do the main data
+	// now do the main data. The file keeps its original layout, so the flow
+	// length codes, rows, columns, donor counts and base level basins that
+	// are no longer stored are worked out as they are written
 	ofstream data_ofs(data_fname.c_str(), ios::out | ios::binary);
 	int temp;
 	for (int i=0; i<NRows; ++i)
@@ -770,7 +1531,7 @@ void LSDFlowInfo::pickle(string filename)
 	{
 		for (int j=0; j<NCols; ++j)
 		{
-			temp = FlowDirection[i][j];
+			temp = flow_direction(i,j);
 			data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 		}
 	}
@@ -778,18 +1539,18 @@ void LSDFlowInfo::pickle(string filename)
 	{
 		for (int j=0; j<NCols; ++j)
 		{
-			temp = FlowLengthCode[i][j];
+			temp = flow_length_code(i,j);
 			data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 		}
 	}
 	for (int i = 0; i<NDataNodes; i++)
 	{
-		temp = RowIndex[i];
+		temp = CellIndex[i]/NCols;
 		data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 	}
 	for (int i = 0; i<NDataNodes; i++)
 	{
-		temp = ColIndex[i];
+		temp = CellIndex[i]%NCols;
 		data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 	}
 	for (int i = 0; i<BLNodes; i++)
@@ -799,7 +1560,7 @@ void LSDFlowInfo::pickle(string filename)
 	}
 	for (int i = 0; i<NDataNodes; i++)
 	{
-		temp = NDonorsVector[i];
+		temp = retrieve_ndonors_of_node(i);
 		data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 	}
 	for (int i = 0; i<NDataNodes; i++)
@@ -822,9 +1583,13 @@ void LSDFlowInfo::pickle(string filename)
 		temp = SVector[i];
 		data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 	}
+	// each basin starts with its base level node in the stack
 	for (int i = 0; i<NDataNodes; i++)
 	{
-		temp = BLBasinVector[i];
+		if (ReceiverVector[ SVector[i] ] == SVector[i])
+		{
+			temp = SVector[i];
+		}
 		data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
 	}
 	for (int i = 0; i<NDataNodes; i++)
@@ -875,6 +1640,7 @@ void LSDFlowInfo::unpickle(string filename)
 			  >> temp_str >> bc[0] >> bc[1] >> bc[2] >> bc[3];
 	header_in.close();
 	BoundaryConditions = bc;
+	CompactLayout = false;
 
 
 	// now read the data, using the binary stream option
@@ -888,12 +1654,10 @@ void LSDFlowInfo::unpickle(string filename)
 	else
 	{
 		// initialze the arrays
-		Array2D<int> data_array(NRows,NCols,NoDataValue);
-		NodeIndex = data_array.copy();
-		FlowDirection = data_array.copy();
-		FlowLengthCode = data_array.copy();
+		allocate_full_grid_arrays();
 
 		vector<int> data_vector(NDataNodes,NoDataValue);
+		vector<int> row_vector(NDataNodes,NoDataValue);
 		vector<int> BLvector(BLNodes,NoDataValue);
 		vector<int> deltaV(NDataNodes+1,NoDataValue);
 		vector<int> CNvec(contributing_nodes,NoDataValue);
@@ -912,29 +1676,25 @@ void LSDFlowInfo::unpickle(string filename)
 			for (int j=0; j<NCols; ++j)
 			{
 				ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-				FlowDirection[i][j] =temp;
-			}
-		}
-		for (int i=0; i<NRows; ++i)
-		{
-			for (int j=0; j<NCols; ++j)
-			{
-				ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-				FlowLengthCode[i][j] =temp;
+				if (temp != NoDataValue)
+				{
+					FlowDirectionCode[i][j] =temp;
+				}
 			}
 		}
-		RowIndex = data_vector;
+		// the flow length codes follow from the flow directions
+		ifs_data.seekg(sizeof(temp)*NRows*NCols,ios::cur);
 		for (int i=0; i<NDataNodes; ++i)
 		{
 			ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-			RowIndex[i] =temp;
+			row_vector[i] =temp;
 
 		}
-		ColIndex = data_vector;
+		CellIndex = data_vector;
 		for (int i=0; i<NDataNodes; ++i)
 		{
 			ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-			ColIndex[i] =temp;
+			CellIndex[i] =row_vector[i]*NCols+temp;
 
 		}
 		BaseLevelNodeList = BLvector;
@@ -944,13 +1704,8 @@ void LSDFlowInfo::unpickle(string filename)
 			BaseLevelNodeList[i] =temp;
 
 		}
-		NDonorsVector = data_vector;
-		for (int i=0; i<NDataNodes; ++i)
-		{
-			ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-			NDonorsVector[i] =temp;
-
-		}
+		// the donor counts follow from the delta vector
+		ifs_data.seekg(sizeof(temp)*NDataNodes,ios::cur);
 		ReceiverVector = data_vector;
 		for (int i=0; i<NDataNodes; ++i)
 		{
@@ -979,13 +1734,8 @@ void LSDFlowInfo::unpickle(string filename)
 			SVector[i] =temp;
 
 		}
-		BLBasinVector = data_vector;
-		for (int i=0; i<NDataNodes; ++i)
-		{
-			ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-			BLBasinVector[i] =temp;
-
-		}
+		// the base level basins follow from the stack
+		ifs_data.seekg(sizeof(temp)*NDataNodes,ios::cur);
 		SVectorIndex = data_vector;
 		for (int i=0; i<NDataNodes; ++i)
 		{
@@ -1005,17 +1755,174 @@ void LSDFlowInfo::unpickle(string filename)
 	}
 	ifs_data.close();
 
-	cout << "sizes RC indices: " << RowIndex.size() << " " << ColIndex.size() << endl;
+	cout << "sizes cell indices: " << CellIndex.size() << endl;
 	cout << "BLNL size: " << BaseLevelNodeList.size() << endl;
-	cout << "donors: " << NDonorsVector.size() << " Reciev: " << ReceiverVector.size() << endl;
+	cout << "Reciev: " << ReceiverVector.size() << endl;
 	cout << "delta: " << DeltaVector.size() << " S: " << SVector.size() << endl;
-	cout << "donorstack: " << DonorStackVector.size() << " BBasin: " << BLBasinVector.size() << endl;
+	cout << "donorstack: " << DonorStackVector.size() << endl;
 	cout << "SVectorIndex " << SVectorIndex.size() << " NContrib: " << NContributingNodes.size() << endl;
 
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This makes the key of a flow info cache from the raw DEM, the minimum slope
+// it is filled with and the boundary conditions. Only the first letter of a
+// boundary condition matters, regardless of case, so only that goes in.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+unsigned long long LSDFlowInfo::cache_key(LSDRaster& RawDEM, vector<string> BoundaryConditions,
+                                          float FillSlope)
+{
+	unsigned long long Key = RawDEM.checksum();
+	Key = checksum_bytes(&FillSlope,sizeof(FillSlope),Key);
+	for (int i = 0; i<int(BoundaryConditions.size()); i++)
+	{
+		char first_letter = BoundaryConditions[i].empty() ? ' ' : tolower(BoundaryConditions[i][0]);
+		Key = checksum_bytes(&first_letter,1,Key);
+	}
+	return Key;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This writes the flow info, with the filled DEM it was made from, to a cache
+// file that create can map and use in place. Each array goes out in a single
+// write. Failing to write a cache is not fatal, since the flow info can
+// always be rebuilt; a partly written file is rejected by its size.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::write_cache(string filename, LSDRaster& FilledDEM, unsigned long long Key)
+{
+	// the cache holds the full layout
+	if (CompactLayout)
+	{
+		full_layout();
+		write_cache(filename,FilledDEM,Key);
+		compact_layout();
+		return;
+	}
+
+	if (FilledDEM.NRows != NRows || FilledDEM.NCols != NCols)
+	{
+		cout << "LSDFlowInfo::write_cache: the DEM must have the same dimensions as the flow info" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	FlowInfoCacheHeader Header;
+	memset(&Header,0,sizeof(Header));
+	memcpy(Header.Magic,FlowInfoCacheMagic,sizeof(FlowInfoCacheMagic));
+	Header.Version = FlowInfoCacheVersion;
+	Header.NRows = NRows;
+	Header.NCols = NCols;
+	Header.NDataNodes = NDataNodes;
+	Header.NBaseLevelNodes = int(BaseLevelNodeList.size());
+	Header.NoDataValue = NoDataValue;
+	Header.FlatsResolved = FlatsResolved ? 1 : 0;
+	Header.XMinimum = XMinimum;
+	Header.YMinimum = YMinimum;
+	Header.DataResolution = DataResolution;
+	for (int i = 0; i<4; i++)
+	{
+		Header.BoundaryConditions[i] = BoundaryConditions[i].empty() ? ' ' : BoundaryConditions[i][0];
+	}
+	Header.Key = Key;
+
+	unsigned long long Offsets[FlowInfoCacheSections];
+	unsigned long long Bytes[FlowInfoCacheSections];
+	Header.FileBytes = flow_info_cache_layout(Header,Offsets,Bytes);
+
+	const void* Sections[FlowInfoCacheSections] =
+	    { FilledDEM.get_RasterView().Data, make_raster_view(NodeIndex).Data,
+	      make_raster_view(FlowDirectionCode).Data, CellIndex.data(),
+	      BaseLevelNodeList.data(), ReceiverVector.data(), DeltaVector.data(),
+	      DonorStackVector.data(), SVector.data(), SVectorIndex.data(),
+	      NContributingNodes.data() };
+	for (int section = 0; section<FlowInfoCacheSections; section++)
+	{
+		Header.SectionChecksums[section] = checksum_words(Sections[section],size_t(Bytes[section]));
+	}
+
+	string cache_fname = filename+".FIcache";
+	ofstream cache_out(cache_fname.c_str(), ios::out | ios::binary | ios::trunc);
+	vector<char> Padding(64,0);
+	cache_out.write(reinterpret_cast<const char*>(&Header),sizeof(Header));
+	cache_out.write(&Padding[0],streamsize(Offsets[0]-sizeof(Header)));
+	for (int section = 0; section<FlowInfoCacheSections; section++)
+	{
+		unsigned long long end = (section+1<FlowInfoCacheSections) ? Offsets[section+1] : Header.FileBytes;
+		unsigned long long n_bytes = Bytes[section];
+		if (n_bytes > 0)
+		{
+			cache_out.write(static_cast<const char*>(Sections[section]),streamsize(n_bytes));
+		}
+		cache_out.write(&Padding[0],streamsize(end-Offsets[section]-n_bytes));
+	}
+	cache_out.close();
+	if (!cache_out)
+	{
+		cout << "WARNING: could not write the flow info cache \"" << cache_fname << "\"" << endl;
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This reads only the header of a cache and the size of the file, so that a
+// program can decide whether to use the cache before it does anything else.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool LSDFlowInfo::cache_matches(string filename, unsigned long long Key)
+{
+	ifstream cache_in((filename+".FIcache").c_str(), ios::in | ios::binary);
+	FlowInfoCacheHeader Header;
+	if (!cache_in.read(reinterpret_cast<char*>(&Header),sizeof(Header)))
+	{
+		return false;
+	}
+	cache_in.seekg(0,ios::end);
+	unsigned long long FileBytes = (unsigned long long)(cache_in.tellg());
+	return flow_info_cache_header_matches(Header,Key,FileBytes);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This reads the filled DEM out of a cache, and checks it against its
+// checksum, which catches a damaged file.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDRaster LSDFlowInfo::read_cached_DEM(string filename, unsigned long long Key)
+{
+	string cache_fname = filename+".FIcache";
+	size_t NBytes;
+	LSDStorageHandle Handle;
+	char* block = static_cast<char*>(map_file(cache_fname,NBytes,Handle));
+
+	FlowInfoCacheHeader Header;
+	if (block == NULL || NBytes < sizeof(Header))
+	{
+		cout << "\nFATAL ERROR: the flow info cache \"" << cache_fname
+		     << "\" doesn't exist or is too short" << endl;
+		exit(EXIT_FAILURE);
+	}
+	memcpy(&Header,block,sizeof(Header));
+	if (!flow_info_cache_header_matches(Header,Key,NBytes))
+	{
+		cout << "\nFATAL ERROR: the flow info cache \"" << cache_fname
+		     << "\" is of another version, has another key or is incomplete" << endl;
+		exit(EXIT_FAILURE);
+	}
+	check_flow_info_cache_sections(block,Header,0,0,cache_fname);
+	unsigned long long Offsets[FlowInfoCacheSections];
+	unsigned long long Bytes[FlowInfoCacheSections];
+	flow_info_cache_layout(Header,Offsets,Bytes);
+
+	Array2D<float> CachedData(Header.NRows,Header.NCols,reinterpret_cast<float*>(block+Offsets[0]));
+	return LSDRaster(Header.NRows,Header.NCols,Header.XMinimum,Header.YMinimum,
+	                 Header.DataResolution,Header.NoDataValue,CachedData);
+}
+
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Method to ingest the channel heads raster generated using channel_heads_driver.cpp
@@ -1058,6 +1965,14 @@ vector<int> LSDFlowInfo::Ingest_Channel_Heads(string filename, string extension)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDFlowInfo::print_flow_info_vectors(string filename)
 {
+	if (CompactLayout)
+	{
+		full_layout();
+		print_flow_info_vectors(filename);
+		compact_layout();
+		return;
+	}
+
 	string string_filename;
 	string dot = ".";
 	string extension = "txt";
@@ -1079,7 +1994,7 @@ void LSDFlowInfo::print_flow_info_vectors(string filename)
 	donor_info_out << endl;
 	for(int i = 0; i<NDataNodes; i++)
 	{
-		donor_info_out << NDonorsVector[i] << " ";
+		donor_info_out << retrieve_ndonors_of_node(i) << " ";
 	}
 	donor_info_out << endl;
 	for(int i = 0; i<NDataNodes+1; i++)
@@ -1134,15 +2049,41 @@ LSDIndexRaster LSDFlowInfo::write_NodeIndex_to_LSDIndexRaster()
 
 LSDIndexRaster LSDFlowInfo::write_FlowDirection_to_LSDIndexRaster()
 {
-	LSDIndexRaster temp_flowdir(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FlowDirection);
+	LSDIndexRaster temp_flowdir(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,get_FlowDirection());
 	return temp_flowdir;
 }
 
 LSDIndexRaster LSDFlowInfo::write_FlowLengthCode_to_LSDIndexRaster()
 {
+	Array2D<int> FlowLengthCode(NRows,NCols);
+	for (int row = 0; row<NRows; row++)
+	{
+		for (int col = 0; col<NCols; col++)
+		{
+			FlowLengthCode[row][col] = flow_length_code(row,col);
+		}
+	}
 	LSDIndexRaster temp_flc(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FlowLengthCode);
 	return temp_flc;
 }
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The flow directions are stored as one byte codes; this widens them.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+Array2D<int> LSDFlowInfo::get_FlowDirection() const
+{
+	Array2D<int> FlowDirection(NRows,NCols);
+	for (int row = 0; row<NRows; row++)
+	{
+		for (int col = 0; col<NCols; col++)
+		{
+			FlowDirection[row][col] = flow_direction(row,col);
+		}
+	}
+	return FlowDirection;
+}
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
 
@@ -1219,8 +2160,7 @@ LSDIndexRaster LSDFlowInfo::write_NContributingNodes_to_LSDIndexRaster()
 	// loop through the node vector, adding pixels to receiver nodes
 	for(int node = 0; node<NDataNodes; node++)
 	{
-		row = RowIndex[node];
-		col = ColIndex[node];
+		retrieve_current_row_and_col(node,row,col);
 		contributing_pixels[row][col] = NContributingNodes[node];
 	}
 
@@ -1254,39 +2194,40 @@ LSDIndexRaster LSDFlowInfo::write_FlowDirection_to_LSDIndexRaster_Arcformat()
 	{
 		for (int col = 0; col<NCols; col++)
 		{
-			if ( FlowDirection[row][col] == -1)
+			int flow_dir = flow_direction(row,col);
+			if ( flow_dir == -1)
 			{
 				FlowDirectionArc[row][col] = 0;
 			}
-			else if ( FlowDirection[row][col] == 0)
+			else if ( flow_dir == 0)
 			{
 				FlowDirectionArc[row][col] = 64;
 			}
-			else if ( FlowDirection[row][col] == 1)
+			else if ( flow_dir == 1)
 			{
 				FlowDirectionArc[row][col] = 128;
 			}
-			else if ( FlowDirection[row][col] == 2)
+			else if ( flow_dir == 2)
 			{
 				FlowDirectionArc[row][col] = 1;
 			}
-			else if ( FlowDirection[row][col] == 3)
+			else if ( flow_dir == 3)
 			{
 				FlowDirectionArc[row][col] = 2;
 			}
-			else if ( FlowDirection[row][col] == 4)
+			else if ( flow_dir == 4)
 			{
 				FlowDirectionArc[row][col] = 4;
 			}
-			else if ( FlowDirection[row][col] == 5)
+			else if ( flow_dir == 5)
 			{
 				FlowDirectionArc[row][col] = 8;
 			}
-			else if ( FlowDirection[row][col] == 6)
+			else if ( flow_dir == 6)
 			{
 				FlowDirectionArc[row][col] = 16;
 			}
-			else if ( FlowDirection[row][col] == 7)
+			else if ( flow_dir == 7)
 			{
 				FlowDirectionArc[row][col] = 32;
 			}
@@ -1358,8 +2299,7 @@ LSDIndexRaster LSDFlowInfo::calculate_n_pixels_contributing_from_upslope()
 	for(int node = NDataNodes-1; node>=0; node--)
 	{
 
-		row = RowIndex[SVector[node]];
-		col = ColIndex[SVector[node]];
+		retrieve_current_row_and_col(SVector[node],row,col);
 		// if the pixel exists and has no contributing pixels,
 		// change from nodata to zero
 
@@ -1368,9 +2308,8 @@ LSDIndexRaster LSDFlowInfo::calculate_n_pixels_contributing_from_upslope()
 			contributing_pixels[row][col] = 0;
 		}
 
-		receiver_node = ReceiverVector[ SVector[node] ] ;
-		receive_row = RowIndex[ receiver_node ];
-		receive_col = ColIndex[ receiver_node ];
+		receiver_node = retrieve_receiver_of_node( SVector[node] ) ;
+		retrieve_current_row_and_col(receiver_node,receive_row,receive_col);
 
 		cout << "node " << node << " pixel: " << SVector[node] << " receiver: " << receiver_node << endl;
 		cout << "contributing: " << contributing_pixels[row][col] << endl;
@@ -1410,8 +2349,11 @@ LSDIndexRaster LSDFlowInfo::calculate_n_pixels_contributing_from_upslope()
 //
 // In this function a pixel that has no donors contributes its own flow
 //
+// No node drains out of its base level basin, and each basin is a run of the
+// s vector that starts with its base level node, so the basins are done in
+// parallel.
 //
-// SMM 01/06/2012
+// SMM 01/06/2012, per basin 16/10/26
 //
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDFlowInfo::calculate_upslope_reference_indices()
@@ -1419,31 +2361,374 @@ void LSDFlowInfo::calculate_upslope_reference_indices()
 	vector<int> vectorized_area(NDataNodes,1);
 	SVectorIndex = vectorized_area;
 
-	int receiver_node;
-	int donor_node;
-
-	// loop through the s vector, adding pixels to receiver nodes
-	for(int node = NDataNodes-1; node>=0; node--)
+	// the start of each basin in the s vector, with the end of the vector last
+	vector<int> BasinStart;
+	for (int node = 0; node<NDataNodes; node++)
 	{
-		donor_node = SVector[node];
-		receiver_node = ReceiverVector[ donor_node ];
+		if (retrieve_receiver_of_node( SVector[node] ) == SVector[node])
+		{
+			BasinStart.push_back(node);
+		}
+	}
+	BasinStart.push_back(NDataNodes);
+	int n_basins = BasinStart.size()-1;
 
-		// every node is visited once and only once so we can map the
-		// unique positions of the nodes to the SVector
-		SVectorIndex[donor_node] = node;
+	#pragma omp parallel for schedule(dynamic)
+	for (int basin = 0; basin<n_basins; basin++)
+	{
+		int receiver_node;
+		int donor_node;
 
-		// add the upslope area (note no action is taken
-		// for base level nodes since they donate to themselves and
-		// we must avoid float counting
-		if (donor_node != receiver_node)
+		// loop through the s vector, adding pixels to receiver nodes
+		for(int node = BasinStart[basin+1]-1; node>=BasinStart[basin]; node--)
 		{
-			vectorized_area[ receiver_node ] +=  vectorized_area[ donor_node ];
+			donor_node = SVector[node];
+			receiver_node = retrieve_receiver_of_node( donor_node );
+
+			// every node is visited once and only once so we can map the
+			// unique positions of the nodes to the SVector
+			SVectorIndex[donor_node] = node;
+
+			// add the upslope area (note no action is taken
+			// for base level nodes since they donate to themselves and
+			// we must avoid float counting
+			if (donor_node != receiver_node)
+			{
+				vectorized_area[ receiver_node ] +=  vectorized_area[ donor_node ];
+			}
 		}
 	}
 
 	NContributingNodes = vectorized_area;
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This brings the filled DEM and the flow routing up to date after the raw DEM
+// has been edited inside a box (burning in a culvert, removing an artefact, etc),
+// without filling the whole DEM and building a new LSDFlowInfo.
+//
+// EditedDEM is the raw DEM after the edit; edits must be confined to the box
+// and must not change which cells have data. FilledDEM is the DEM this object
+// was built from, filled from the raw DEM before the edit, and is updated in
+// place. MinSlope is the minimum slope it was filled with.
+//
+// The filled elevations that can change are those of the box, of every cell
+// that drains into a cell that can change (raising a cell can pond water
+// upstream), and of every filled depression that touches a cell that can change
+// (lowering a cell can drain a depression). Only those cells are refilled. The
+// receivers are then recomputed for them and their neighbours, the donor stack
+// is rebuilt over the range of nodes whose donors changed, and the stack
+// (SVector) is rebuilt only for the base level basins that gained or lost
+// nodes; the other basins are copied across.
+//
+// With a MinSlope of zero the result is identical to filling the edited DEM and
+// building a new LSDFlowInfo from it.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDFlowInfo::update_for_edited_region(LSDRaster& EditedDEM, LSDRaster& FilledDEM,
+                                           float& MinSlope, int first_row, int first_col,
+                                           int last_row, int last_col)
+{
+	// the update works on the receivers and donor stack as they were before
+	// the edit, so a compact flow info is expanded for it
+	if (CompactLayout)
+	{
+		full_layout();
+		update_for_edited_region(EditedDEM,FilledDEM,MinSlope,first_row,first_col,last_row,last_col);
+		compact_layout();
+		return;
+	}
+
+	if (EditedDEM.NRows != NRows || EditedDEM.NCols != NCols ||
+	    FilledDEM.NRows != NRows || FilledDEM.NCols != NCols)
+	{
+		cout << "LSDFlowInfo::update_for_edited_region: the DEMs must have the "
+		     << "same dimensions as the flow info" << endl;
+		exit(EXIT_FAILURE);
+	}
+	if (FlatsResolved)
+	{
+		cout << "LSDFlowInfo::update_for_edited_region: flats were resolved when this "
+		     << "flow info was made; it has to be rebuilt instead" << endl;
+		exit(EXIT_FAILURE);
+	}
+	first_row = max(first_row,0);
+	first_col = max(first_col,0);
+	last_row = min(last_row,NRows-1);
+	last_col = min(last_col,NCols-1);
+
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+
+	// the nodes whose filled elevation can change, starting with the box
+	vector<int> Region;
+	vector<char> InRegion(NDataNodes,0);
+	for (int row = first_row; row<=last_row; row++)
+	{
+		for (int col = first_col; col<=last_col; col++)
+		{
+			bool has_data = (EditedDEM.RasterData[row][col] != NoDataValue);
+			if (has_data != (NodeIndex[row][col] != NoDataValue))
+			{
+				cout << "LSDFlowInfo::update_for_edited_region: the edit at row " << row
+				     << " col " << col << " changes which cells have data" << endl;
+				exit(EXIT_FAILURE);
+			}
+			if (has_data)
+			{
+				InRegion[ NodeIndex[row][col] ] = 1;
+				Region.push_back(NodeIndex[row][col]);
+			}
+		}
+	}
+	// then everything upslope of the region, and every cell next to the region
+	// that was raised by the fill or is a sink. Flats left by a fill with a
+	// MinSlope of zero are sinks, so water ponded on them does not show up as
+	// flowing into the region. The outlets of the fill never change
+	for (size_t i = 0; i<Region.size(); i++)
+	{
+		int node = Region[i];
+		for (int d = DeltaVector[node]; d<DeltaVector[node+1]; d++)
+		{
+			int donor = DonorStackVector[d];
+			if (InRegion[donor] == 0)
+			{
+				InRegion[donor] = 1;
+				Region.push_back(donor);
+			}
+		}
+
+		int row, col;
+		retrieve_current_row_and_col(node,row,col);
+		for (int n = 0; n<8; n++)
+		{
+			int nr = row+row_offsets[n];
+			int nc = col+col_offsets[n];
+			if (nr < 0 || nr >= NRows || nc < 0 || nc >= NCols || NodeIndex[nr][nc] == NoDataValue)
+			{
+				continue;
+			}
+			int neighbour = NodeIndex[nr][nc];
+			if (InRegion[neighbour] != 0)
+			{
+				continue;
+			}
+			bool raised = (FilledDEM.RasterData[nr][nc] != EditedDEM.RasterData[nr][nc]);
+			bool sink = (ReceiverVector[neighbour] == neighbour);
+			for (int m = 0; m<8 && sink; m++)
+			{
+				int mr = nr+row_offsets[m];
+				int mc = nc+col_offsets[m];
+				if (mr < 0 || mr >= NRows || mc < 0 || mc >= NCols ||
+				    EditedDEM.RasterData[mr][mc] == NoDataValue)
+				{
+					sink = false;
+				}
+			}
+			if (raised || sink)
+			{
+				InRegion[neighbour] = 1;
+				Region.push_back(neighbour);
+			}
+		}
+	}
+
+	// refill the region
+	vector<int> region_rows, region_cols;
+	for (size_t i = 0; i<Region.size(); i++)
+	{
+		int row, col;
+		retrieve_current_row_and_col(Region[i],row,col);
+		region_rows.push_back(row);
+		region_cols.push_back(col);
+	}
+	FilledDEM.refill_region(EditedDEM,MinSlope,region_rows,region_cols);
+
+	// the receivers of the region and of its neighbours, including those across
+	// periodic boundaries, can change
+	vector<int> Reroute = Region;
+	for (size_t i = 0; i<Region.size(); i++)
+	{
+		int row, col;
+		retrieve_current_row_and_col(Region[i],row,col);
+		for (int n = 0; n<8; n++)
+		{
+			int nr = (row+row_offsets[n]+NRows)%NRows;
+			int nc = (col+col_offsets[n]+NCols)%NCols;
+			int neighbour = NodeIndex[nr][nc];
+			if (neighbour != NoDataValue && InRegion[neighbour] == 0)
+			{
+				InRegion[neighbour] = 2;
+				Reroute.push_back(neighbour);
+			}
+		}
+	}
+
+	vector<int> Changed;
+	vector<int> OldReceiver;
+	vector<int> NewReceiver;
+	int receive_row, receive_col, flow_direction, flow_length_code;
+	for (size_t i = 0; i<Reroute.size(); i++)
+	{
+		int node = Reroute[i];
+		int row, col;
+		retrieve_current_row_and_col(node,row,col);
+		find_receiver(FilledDEM.RasterData,row,col,receive_row,receive_col,
+		              flow_direction,flow_length_code);
+		FlowDirectionCode[row][col] = flow_direction;
+		int receiver = NodeIndex[receive_row][receive_col];
+		if (receiver != ReceiverVector[node])
+		{
+			Changed.push_back(node);
+			OldReceiver.push_back(ReceiverVector[node]);
+			NewReceiver.push_back(receiver);
+		}
+	}
+	if (Changed.empty())
+	{
+		return;
+	}
+	int n_changed = int(Changed.size());
+
+	// the basins that lose nodes, before the receivers are changed
+	vector<char> BasinChanged(NDataNodes,0);
+	for (int i = 0; i<n_changed; i++)
+	{
+		int node = Changed[i];
+		while (ReceiverVector[node] != node)
+		{
+			node = ReceiverVector[node];
+		}
+		BasinChanged[node] = 1;
+	}
+
+	// new receivers and base level nodes
+	vector<char> IsChanged(NDataNodes,0);
+	int lo = NDataNodes, hi = -1;
+	for (int i = 0; i<n_changed; i++)
+	{
+		int node = Changed[i];
+		int receiver = NewReceiver[i];
+
+		IsChanged[node] = 1;
+		ReceiverVector[node] = receiver;
+		lo = min(lo,min(OldReceiver[i],receiver));
+		hi = max(hi,max(OldReceiver[i],receiver));
+
+		if (OldReceiver[i] == node)
+		{
+			BaseLevelNodeList.erase(lower_bound(BaseLevelNodeList.begin(),BaseLevelNodeList.end(),node));
+		}
+		if (receiver == node)
+		{
+			BaseLevelNodeList.insert(lower_bound(BaseLevelNodeList.begin(),BaseLevelNodeList.end(),node),node);
+		}
+	}
+
+	// the basins that gain nodes
+	for (int i = 0; i<n_changed; i++)
+	{
+		int node = Changed[i];
+		while (ReceiverVector[node] != node)
+		{
+			node = ReceiverVector[node];
+		}
+		BasinChanged[node] = 1;
+	}
+
+	// rebuild the donor stack of the nodes lo to hi. The donors of a node are in
+	// order of node index, except that a base level node comes first in its own
+	// list (see create)
+	vector< vector<int> > Donors(hi-lo+1);
+	for (int node = lo; node<=hi; node++)
+	{
+		for (int d = DeltaVector[node]; d<DeltaVector[node+1]; d++)
+		{
+			if (IsChanged[ DonorStackVector[d] ] == 0)
+			{
+				Donors[node-lo].push_back(DonorStackVector[d]);
+			}
+		}
+	}
+	for (int i = 0; i<n_changed; i++)
+	{
+		Donors[ ReceiverVector[ Changed[i] ]-lo ].push_back(Changed[i]);
+	}
+	for (int node = lo; node<=hi; node++)
+	{
+		vector<int>& donors = Donors[node-lo];
+		sort(donors.begin(),donors.end());
+		if (ReceiverVector[node] == node && donors[0] != node)
+		{
+			swap(donors[0],*find(donors.begin(),donors.end(),node));
+		}
+		DeltaVector[node+1] = DeltaVector[node]+int(donors.size());
+		copy(donors.begin(),donors.end(),DonorStackVector.begin()+DeltaVector[node]);
+	}
+
+	// rebuild the stack. Basins that have not changed keep their order and are
+	// only moved; the others are traversed again as in add_to_stack
+	vector<int> NewSVector(NDataNodes);
+	vector<int> NodeStack;
+	int j_index = 0;
+	int n_base_level_nodes = BaseLevelNodeList.size();
+	for (int i = 0; i<n_base_level_nodes; i++)
+	{
+		int k = BaseLevelNodeList[i];
+		int start = j_index;
+		if (BasinChanged[k] == 0)
+		{
+			int old_start = SVectorIndex[k];
+			int n_nodes = NContributingNodes[k];
+			for (int s = 0; s<n_nodes; s++)
+			{
+				int node = SVector[old_start+s];
+				NewSVector[j_index] = node;
+				SVectorIndex[node] = j_index;
+				j_index++;
+			}
+			continue;
+		}
+
+		for (int d = DeltaVector[k+1]-1; d>=DeltaVector[k]; d--)
+		{
+			NodeStack.push_back(DonorStackVector[d]);
+		}
+		while (!NodeStack.empty())
+		{
+			int node = NodeStack.back();
+			NodeStack.pop_back();
+			NewSVector[j_index] = node;
+			NContributingNodes[node] = 1;
+			j_index++;
+			if (node != k)
+			{
+				for (int d = DeltaVector[node+1]-1; d>=DeltaVector[node]; d--)
+				{
+					NodeStack.push_back(DonorStackVector[d]);
+				}
+			}
+		}
+
+		// contributing nodes and stack indices for the basin, as in
+		// calculate_upslope_reference_indices
+		for (int s = j_index-1; s>=start; s--)
+		{
+			int donor_node = NewSVector[s];
+			int receiver_node = ReceiverVector[donor_node];
+			SVectorIndex[donor_node] = s;
+			if (donor_node != receiver_node)
+			{
+				NContributingNodes[receiver_node] += NContributingNodes[donor_node];
+			}
+		}
+	}
+	SVector.swap(NewSVector);
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
 
@@ -1458,23 +2743,31 @@ void LSDFlowInfo::calculate_upslope_reference_indices()
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 vector<int> LSDFlowInfo::get_upslope_nodes(int node_number_outlet)
 {
-	vector<int> us_nodes;
+	LSDNodeView upslope_nodes = get_upslope_node_view(node_number_outlet);
+	vector<int> us_nodes(upslope_nodes.begin(),upslope_nodes.end());
+
+	return us_nodes;
+}
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// This function returns the nodes upslope of node_number_outlet as a view of
+// their range of the stack, so nothing is copied or allocated
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDNodeView LSDFlowInfo::get_upslope_node_view(int node_number_outlet) const
+{
 	if(node_number_outlet < 0 || node_number_outlet > NDataNodes-1)
 	{
 		cout << "the junction number does not exist" << endl;
 		exit(EXIT_FAILURE);
 	}
 
-	int start_SVector_node = SVectorIndex[node_number_outlet];
-	int end_SVector_node = start_SVector_node+NContributingNodes[node_number_outlet];
-
-	for(int node = start_SVector_node; node < end_SVector_node; node++)
-	{
-		us_nodes.push_back(SVector[node]);
-	}
-
-	return us_nodes;
+	return LSDNodeView(SVector.data()+SVectorIndex[node_number_outlet],
+	                   NContributingNodes[node_number_outlet]);
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -1483,6 +2776,8 @@ vector<int> LSDFlowInfo::get_upslope_nodes(int node_number_outlet)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //
 // This function tests whether one node is upstream of another node
+// The upslope nodes of current_node are a range of the stack, so this is a
+// range check on the stack index of test_node.
 //
 // FC 01/06/2012
 //
@@ -1496,17 +2791,50 @@ int LSDFlowInfo::is_node_upstream(int current_node, int test_node)
 
 	int SVector_test_node = SVectorIndex[test_node];
 
-	for(int node = start_SVector_node; node < end_SVector_node; node++)
+	if (SVector_test_node >= start_SVector_node && SVector_test_node < end_SVector_node)
 	{
-		if (node == SVector_test_node)
-		{
-      i = 1;
-    }
-	}
+    i = 1;
+  }
 
   return i;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// This function returns the nodes of a list that have no other node of the
+// list upstream. A node is at the start of its upslope range of the stack, so
+// another node is upstream of it if the next stack position of the list after
+// its own is still inside that range.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+vector<int> LSDFlowInfo::get_most_upstream_nodes(vector<int>& node_list)
+{
+	int n_nodes = node_list.size();
+	vector<int> Positions(n_nodes);
+	for (int i = 0; i<n_nodes; i++)
+	{
+		Positions[i] = SVectorIndex[ node_list[i] ];
+	}
+	sort(Positions.begin(),Positions.end());
+	Positions.erase(unique(Positions.begin(),Positions.end()),Positions.end());
+
+	vector<int> most_upstream_nodes;
+	for (int i = 0; i<n_nodes; i++)
+	{
+		int node = node_list[i];
+		int start_SVector_node = SVectorIndex[node];
+		vector<int>::iterator next = upper_bound(Positions.begin(),Positions.end(),start_SVector_node);
+		if (next == Positions.end() || *next >= start_SVector_node+NContributingNodes[node])
+		{
+			most_upstream_nodes.push_back(node);
+		}
+	}
+	return most_upstream_nodes;
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //
@@ -1518,16 +2846,10 @@ int LSDFlowInfo::is_node_upstream(int current_node, int test_node)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 vector<int> LSDFlowInfo::get_donor_nodes(int current_node)
 {
-	int start_D = DeltaVector[current_node];
-	int end_D = DeltaVector[current_node+1];
-
-	vector<int> donor_nodes;
-	for(int this_node = start_D; this_node<end_D; this_node++)
-	{
-		//cout << "node " << current_node << " and donor: " << DonorStackVector[ this_node ] << endl;
-		donor_nodes.push_back( DonorStackVector[ this_node ] );
-	}
+	int donors[9];
+	int n_donors = retrieve_donors_of_node(current_node,donors);
 
+	vector<int> donor_nodes(donors,donors+n_donors);
 	return donor_nodes;
 }
 
@@ -1545,12 +2867,17 @@ vector<int> LSDFlowInfo::get_donor_nodes(int current_node)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 vector<float> LSDFlowInfo::get_upslope_chi(int starting_node, float m_over_n, float A_0)
 {
-	vector<int> upslope_pixel_list = get_upslope_nodes(starting_node);
+	LSDNodeView upslope_pixel_list = get_upslope_node_view(starting_node);
 	vector<float> chi_vec = get_upslope_chi(upslope_pixel_list, m_over_n, A_0);
 	return chi_vec;
 }
 
 vector<float> LSDFlowInfo::get_upslope_chi(vector<int>& upslope_pixel_list, float m_over_n, float A_0)
+{
+	return get_upslope_chi(LSDNodeView(upslope_pixel_list), m_over_n, A_0);
+}
+
+vector<float> LSDFlowInfo::get_upslope_chi(LSDNodeView upslope_pixel_list, float m_over_n, float A_0)
 {
 
 	int receiver_node;
@@ -1575,12 +2902,11 @@ vector<float> LSDFlowInfo::get_upslope_chi(vector<int>& upslope_pixel_list, floa
 	for (int n_index = 1; n_index<n_nodes_upslope; n_index++)
 	{
 		node = upslope_pixel_list[n_index];
-		receiver_node = ReceiverVector[ node ];
+		receiver_node = retrieve_receiver_of_node( node );
 		IndexOfReceiverInUplsopePList = SVectorIndex[receiver_node]-start_SVector_node;
-		row = RowIndex[node];
-		col = ColIndex[node];
+		retrieve_current_row_and_col(node,row,col);
 
-		if (FlowLengthCode[row][col] == 2)
+		if (flow_length_code(row,col) == 2)
 		{
 			dx = diag_length;
 		}
@@ -1603,6 +2929,72 @@ vector<float> LSDFlowInfo::get_upslope_chi(vector<int>& upslope_pixel_list, floa
 	return chi_vec;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// This calculates chi for every node, measured from the base level node of its
+// basin. A receiver always comes before its donors in the stack, so one pass
+// up the stack adds each node's increment to the chi of its receiver. The
+// increment is computed exactly as in get_upslope_chi; the sum is kept in double
+// so that differences between nodes far from the outlet keep float precision.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+vector<double> LSDFlowInfo::calculate_base_level_chi(float m_over_n, float A_0)
+{
+	float root2 = 1.41421356;
+	float diag_length = root2*DataResolution;
+	float dx;
+	float pixel_area = DataResolution*DataResolution;
+	int node,receiver_node,row,col;
+
+	vector<double> BaseLevelChi(NDataNodes,0.0);
+	for (int s = 0; s<NDataNodes; s++)
+	{
+		node = SVector[s];
+		receiver_node = retrieve_receiver_of_node(node);
+		if (receiver_node == node)
+		{
+			continue;
+		}
+
+		retrieve_current_row_and_col(node,row,col);
+		if (flow_length_code(row,col) == 2)
+		{
+			dx = diag_length;
+		}
+		else
+		{
+			dx = DataResolution;
+		}
+
+		float dchi = dx*(pow( (A_0/ (float(NContributingNodes[node])*pixel_area) ),m_over_n));
+		BaseLevelChi[node] = BaseLevelChi[receiver_node]+dchi;
+	}
+
+	return BaseLevelChi;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The upslope chi of a node, from the table of calculate_base_level_chi
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+vector<float> LSDFlowInfo::get_upslope_chi(int starting_node, vector<double>& BaseLevelChi)
+{
+	LSDNodeView upslope_pixel_list = get_upslope_node_view(starting_node);
+	int n_nodes_upslope = upslope_pixel_list.size();
+	double start_chi = BaseLevelChi[starting_node];
+
+	vector<float> chi_vec(n_nodes_upslope);
+	for (int n_index = 0; n_index<n_nodes_upslope; n_index++)
+	{
+		chi_vec[n_index] = float(BaseLevelChi[ upslope_pixel_list[n_index] ]-start_chi);
+	}
+
+	return chi_vec;
+}
+
 
 
 
@@ -1633,7 +3025,6 @@ LSDRaster LSDFlowInfo::distance_from_outlet()
 
 	int row,col,bl_row,bl_col,receive_row,receive_col;
 
-	//cout << "FlowLengthCode: " << FlowLengthCode << endl;
 
 	int start_node = 0;
 	int end_node;
@@ -1646,8 +3037,7 @@ LSDRaster LSDFlowInfo::distance_from_outlet()
 
 		baselevel_node = BaseLevelNodeList[bl];
 
-		bl_row = RowIndex[baselevel_node];
-		bl_col = ColIndex[baselevel_node];
+		retrieve_current_row_and_col(baselevel_node,bl_row,bl_col);
 		// get the number of nodes upslope and including this node
 		nodes_in_bl_tree = NContributingNodes[baselevel_node];
 		//cout << "LINE 938, FlowInfo, base level: " << bl << " with " << nodes_in_bl_tree << " nodes upstream" << endl;
@@ -1662,19 +3052,18 @@ LSDRaster LSDFlowInfo::distance_from_outlet()
 		{
 			//cout << "Line 953 flow info, s_node is: " << s_node << endl;
 
-			//cout << SVector.size() << " " << ReceiverVector.size() << " " << RowIndex.size() << " " << ColIndex.size() << endl;
-			row = RowIndex[ SVector[ s_node]  ];
-			col = ColIndex[ SVector[ s_node]  ];
+			//cout << SVector.size() << " " << ReceiverVector.size() << " " << CellIndex.size() << endl;
+			retrieve_current_row_and_col(SVector[ s_node],row,col);
 			//cout << "got rows and columns " << row << " " << col << endl;
-			receive_row = RowIndex[ ReceiverVector[SVector[s_node] ]];
-			receive_col = ColIndex[ ReceiverVector[SVector[s_node] ]];
+			retrieve_current_row_and_col(retrieve_receiver_of_node(SVector[s_node]),receive_row,receive_col);
 			//cout <<  "get receive " << receive_row << " " << receive_col << endl;
 
-			if ( FlowLengthCode[row][col] == 1)
+			int flow_length = flow_length_code(row,col);
+			if ( flow_length == 1)
 			{
 				flow_distance[row][col] = flow_distance[receive_row][receive_col]+DataResolution;
 			}
-			else if ( FlowLengthCode[row][col] == 2 )
+			else if ( flow_length == 2 )
 			{
 				flow_distance[row][col] = flow_distance[receive_row][receive_col]
 											+ diag_length;
@@ -1709,7 +3098,7 @@ int LSDFlowInfo::find_farthest_upslope_node(int node, LSDRaster& DistFromOutlet)
 	int farthest_upslope_node = node;
 
 	// first get the nodes that are upslope
-	vector<int> upslope_node_list = get_upslope_nodes(node);
+	LSDNodeView upslope_node_list = get_upslope_node_view(node);
 
 	int row, col;
 	float this_flow_distance;
@@ -1720,8 +3109,7 @@ int LSDFlowInfo::find_farthest_upslope_node(int node, LSDRaster& DistFromOutlet)
 	for (int i = 0; i<n_upslope_nodes; i++)
 	{
 		// get the row and col of upslope nodes
-		row = RowIndex[ upslope_node_list[i] ];
-		col = ColIndex[ upslope_node_list[i] ];
+		retrieve_current_row_and_col(upslope_node_list[i],row,col);
 
 		// get the flow distance
 		this_flow_distance = DistFromOutlet.get_data_element(row, col);
@@ -1736,6 +3124,60 @@ int LSDFlowInfo::find_farthest_upslope_node(int node, LSDRaster& DistFromOutlet)
 
 	return farthest_upslope_node;
 }
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// this finds the farthest upslope node of every node at once. The stack is
+// walked backwards, so every donor is finished before its receiver, and each
+// node passes the farthest node found above it down to its receiver. As in
+// find_farthest_upslope_node, only distances above zero count, ties go to the
+// node that comes first in the stack, and a node with nothing farther than
+// zero upslope is its own farthest node.
+//
+// 16/10/26
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+vector<int> LSDFlowInfo::calculate_farthest_upslope_nodes(LSDRaster& DistFromOutlet)
+{
+	vector<int> FarthestUpslopeNodes(NDataNodes,NoDataValue);
+	vector<float> Farthest(NDataNodes,0.0);
+
+	int row, col;
+	for (int s = NDataNodes-1; s>=0; s--)
+	{
+		int node = SVector[s];
+		retrieve_current_row_and_col(node,row,col);
+		float this_flow_distance = DistFromOutlet.get_data_element(row,col);
+
+		// the node comes before all its upslope nodes in the stack
+		if (this_flow_distance > 0 && this_flow_distance >= Farthest[node])
+		{
+			Farthest[node] = this_flow_distance;
+			FarthestUpslopeNodes[node] = node;
+		}
+
+		int receiver_node = retrieve_receiver_of_node(node);
+		int farthest_node = FarthestUpslopeNodes[node];
+		if (receiver_node != node && farthest_node != NoDataValue)
+		{
+			if (Farthest[node] > Farthest[receiver_node] ||
+			    (Farthest[node] == Farthest[receiver_node] &&
+			     SVectorIndex[farthest_node] < SVectorIndex[ FarthestUpslopeNodes[receiver_node] ]))
+			{
+				Farthest[receiver_node] = Farthest[node];
+				FarthestUpslopeNodes[receiver_node] = farthest_node;
+			}
+		}
+
+		if (farthest_node == NoDataValue)
+		{
+			FarthestUpslopeNodes[node] = node;
+		}
+	}
+
+	return FarthestUpslopeNodes;
+}
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
 
@@ -1782,6 +3224,8 @@ vector<int> LSDFlowInfo::get_sources_index_threshold(LSDIndexRaster& FlowPixels,
 	int donor_row,donor_col;
 	int thresh_switch;
 	int donor_node;
+	int donors[9];
+	int n_donors;
 
 	// drop down through the stack
 	// if the node is greater than or equal to the threshold
@@ -1790,18 +3234,18 @@ vector<int> LSDFlowInfo::get_sources_index_threshold(LSDIndexRaster& FlowPixels,
 	// if none of the donors are greater than the threshold, then it also is a source
 	for (int node = 0; node<NDataNodes; node++)
 	{
-		row = RowIndex[node];
-		col = ColIndex[node];
+		retrieve_current_row_and_col(node,row,col);
 
 		// see if node is greater than threshold
 		if(FlowPixels.get_data_element(row,col)>=threshold)
 		{
 			//cout << "node " << node << " is a potential source, it has a value of "
 			//     << FlowPixels.get_data_element(row,col)
-			//     << "and it has " << NDonorsVector[node] <<" donors " << endl;
+			//     << "and it has " << retrieve_ndonors_of_node(node) <<" donors " << endl;
 
 			// if it doesn't have donors, it is a source
-			if(NDonorsVector[node] == 0)
+			n_donors = retrieve_donors_of_node(node,donors);
+			if(n_donors == 0)
 			{
 				sources.push_back(node);
 			}
@@ -1810,11 +3254,10 @@ vector<int> LSDFlowInfo::get_sources_index_threshold(LSDIndexRaster& FlowPixels,
 				thresh_switch = 1;
 				// figure out where the donor nodes are, and if
 				// the donor node is greater than the threshold
-				for(int dnode = 0; dnode<NDonorsVector[node]; dnode++)
+				for(int dnode = 0; dnode<n_donors; dnode++)
 				{
-					donor_node = DonorStackVector[ DeltaVector[node]+dnode];
-					donor_row = RowIndex[ donor_node ];
-					donor_col = ColIndex[ donor_node ];
+					donor_node = donors[dnode];
+					retrieve_current_row_and_col(donor_node,donor_row,donor_col);
 
 					// we don't float count base level nodes, which donate to themselves
 					if (donor_node != node)
@@ -1856,6 +3299,8 @@ vector<int> LSDFlowInfo::get_sources_slope_area(LSDIndexRaster& FlowPixels, LSDR
 	int donor_row,donor_col;
 	int thresh_switch;
 	int donor_node;
+	int donors[9];
+	int n_donors;
 
 	// drop down through the stack
 	// if the node is greater than or equal to the threshold
@@ -1864,8 +3309,7 @@ vector<int> LSDFlowInfo::get_sources_slope_area(LSDIndexRaster& FlowPixels, LSDR
 	// if none of the donors are greater than the threshold, then it also is a source
 	for (int node = 0; node<NDataNodes; node++)
 	{
-		row = RowIndex[node];
-		col = ColIndex[node];
+		retrieve_current_row_and_col(node,row,col);
 		
 		float area = FlowPixels.get_data_element(row,col);
 		float slope = Slope.get_data_element(row,col);
@@ -1875,10 +3319,11 @@ vector<int> LSDFlowInfo::get_sources_slope_area(LSDIndexRaster& FlowPixels, LSDR
 		{
 			//cout << "node " << node << " is a potential source, it has a value of "
 			//     << SA_product
-			//     << "and it has " << NDonorsVector[node] <<" donors " << endl;
+			//     << "and it has " << retrieve_ndonors_of_node(node) <<" donors " << endl;
 
 			// if it doesn't have donors, it is a source
-			if(NDonorsVector[node] == 0)
+			n_donors = retrieve_donors_of_node(node,donors);
+			if(n_donors == 0)
 			{
 				sources.push_back(node);
 			}
@@ -1887,11 +3332,10 @@ vector<int> LSDFlowInfo::get_sources_slope_area(LSDIndexRaster& FlowPixels, LSDR
 				thresh_switch = 1;
 				// figure out where the donor nodes are, and if
 				// the donor node is greater than the threshold
-				for(int dnode = 0; dnode<NDonorsVector[node]; dnode++)
+				for(int dnode = 0; dnode<n_donors; dnode++)
 				{
-					donor_node = DonorStackVector[ DeltaVector[node]+dnode];
-					donor_row = RowIndex[ donor_node ];
-					donor_col = ColIndex[ donor_node ];
+					donor_node = donors[dnode];
+					retrieve_current_row_and_col(donor_node,donor_row,donor_col);
 
 					// we don't float count base level nodes, which donate to themselves
 					if (donor_node != node)
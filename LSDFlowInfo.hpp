@@ -77,12 +77,139 @@ It is the object that is used to generate contributing area, etc.
 #include "TNT/tnt.h"
 #include "LSDRaster.hpp"
 #include "LSDIndexRaster.hpp"
+#include "LSDRasterStorage.hpp"
 using namespace std;
 using namespace TNT;
 
 #ifndef LSDFlowInfo_H
 #define LSDFlowInfo_H
 
+/// @brief A read only view of a run of node indices held by an LSDFlowInfo,
+/// such as the nodes upslope of a node, which are one range of the stack.
+/// @details The view does not own the nodes, so it must not outlive the
+/// LSDFlowInfo it came from. It can be indexed and iterated like the vector
+/// it replaces.
+/// @date 16/10/26
+struct LSDNodeView
+{
+  /// The first node.
+  const int* Nodes;
+  /// Number of nodes.
+  int NNodes;
+
+  LSDNodeView() : Nodes(NULL), NNodes(0) {}
+  LSDNodeView(const int* nodes, int n_nodes) : Nodes(nodes), NNodes(n_nodes) {}
+  /// A view of all the nodes of a vector.
+  LSDNodeView(const vector<int>& nodes) : Nodes(nodes.data()), NNodes(int(nodes.size())) {}
+
+  /// @return The number of nodes, as a size_t like vector::size().
+  size_t size() const                { return size_t(NNodes); }
+  /// @return True if there are no nodes.
+  bool empty() const                 { return NNodes == 0; }
+  /// @return The i-th node.
+  int operator[](size_t i) const     { return Nodes[i]; }
+  const int* begin() const           { return Nodes; }
+  const int* end() const             { return Nodes+NNodes; }
+};
+
+/// @brief A vector of nodes held by an LSDFlowInfo, such as ReceiverVector.
+/// @details It is used like the vector<int> it replaces, but it can also be a
+/// view of nodes held somewhere else, such as a section of a mapped flow info
+/// cache, which its storage handle keeps alive. A view is read and written in
+/// place; anything that changes the number of nodes first copies the nodes
+/// into a vector of its own. Copies of the array always have their own nodes.
+/// @date 16/10/26
+class LSDNodeArray
+{
+  public:
+  typedef int value_type;
+  typedef int* iterator;
+  typedef const int* const_iterator;
+
+  LSDNodeArray() : Data(NULL), NNodes(0) {}
+  LSDNodeArray(const LSDNodeArray& other) : Owned(other.begin(), other.end()) { sync(); }
+  LSDNodeArray& operator=(const LSDNodeArray& other)
+  {
+    if (this != &other)
+    {
+      Storage.reset();
+      Owned.assign(other.begin(), other.end());
+      sync();
+    }
+    return *this;
+  }
+  /// Takes the nodes of a vector; assigning an empty vector frees the nodes.
+  LSDNodeArray& operator=(vector<int> nodes)  { Storage.reset(); Owned.swap(nodes); sync(); return *this; }
+  /// @return A copy of the nodes as a vector.
+  operator vector<int>() const                { return vector<int>(begin(), end()); }
+
+  /// @brief Makes the array a view of NNodes nodes at nodes, kept alive by
+  /// storage.
+  void view(int* nodes, size_t n_nodes, const LSDStorageHandle& storage)
+  {
+    vector<int>().swap(Owned);
+    Storage = storage;
+    Data = nodes;
+    NNodes = n_nodes;
+  }
+  /// @return True if the array is a view of nodes held elsewhere.
+  bool is_view() const                        { return bool(Storage); }
+
+  size_t size() const                         { return NNodes; }
+  bool empty() const                          { return NNodes == 0; }
+  int* data()                                 { return Data; }
+  const int* data() const                     { return Data; }
+  int* begin()                                { return Data; }
+  int* end()                                  { return Data+NNodes; }
+  const int* begin() const                    { return Data; }
+  const int* end() const                      { return Data+NNodes; }
+  int& operator[](size_t i)                   { return Data[i]; }
+  const int& operator[](size_t i) const       { return Data[i]; }
+
+  void push_back(int node)                    { detach(); Owned.push_back(node); sync(); }
+  void reserve(size_t n_nodes)                { detach(); Owned.reserve(n_nodes); sync(); }
+  void assign(size_t n_nodes, int node)       { Storage.reset(); Owned.assign(n_nodes, node); sync(); }
+  void clear()                                { Storage.reset(); Owned.clear(); sync(); }
+  void swap(vector<int>& nodes)               { detach(); Owned.swap(nodes); sync(); }
+  /// Removes the node at position.
+  void erase(const int* position)
+  {
+    size_t i = size_t(position-Data);
+    detach();
+    Owned.erase(Owned.begin()+i);
+    sync();
+  }
+  /// Inserts node before position.
+  void insert(const int* position, int node)
+  {
+    size_t i = size_t(position-Data);
+    detach();
+    Owned.insert(Owned.begin()+i, node);
+    sync();
+  }
+
+  private:
+  /// Copies the nodes of a view into Owned.
+  void detach()
+  {
+    if (Storage)
+    {
+      Owned.assign(Data, Data+NNodes);
+      Storage.reset();
+    }
+  }
+  void sync()                                 { Data = Owned.data(); NNodes = Owned.size(); }
+
+  /// The nodes, when the array holds its own.
+  vector<int> Owned;
+  /// Keeps the nodes of a view alive; empty if the array holds its own nodes.
+  LSDStorageHandle Storage;
+  /// The first node.
+  int* Data;
+  /// Number of nodes.
+  size_t NNodes;
+};
+
 /// @brief Object to perform flow routing.
 class LSDFlowInfo
 {
@@ -96,6 +223,15 @@ class LSDFlowInfo
 	/// @author SMM
     /// @date 01/016/12
 	LSDFlowInfo(string fname)							{ create(fname); }
+	/// @brief Creates a FlowInfo object from a cache file written by write_cache.
+	/// @details Nothing is copied: the full grid arrays and the node vectors
+	/// are all views of the mapped file (see LSDNodeArray). The program stops if
+	/// the file does not match Key, so check it with cache_matches first, or if
+	/// an array of the flow routing does not match its checksum.
+	/// @param fname The name of the cache, without the .FIcache extension.
+	/// @param Key The key the cache must have been written with.
+	/// @date 16/10/26
+	LSDFlowInfo(string fname, unsigned long long Key)	{ create(fname, Key); }
 	/// @brief Creates a FlowInfo object from topography.
 	/// @param BoundaryConditions Vector<string> of the boundary conditions at each edge of the
     /// DEM file. Boundary conditions can start with 'P' or 'p' for periodic,
@@ -105,7 +241,22 @@ class LSDFlowInfo
 	/// @author SMM
     /// @date 01/016/12
 	LSDFlowInfo(vector<string> BoundaryConditions, LSDRaster& TopoRaster)
-									{ create(BoundaryConditions, TopoRaster); }
+									{ create(BoundaryConditions, TopoRaster, false); }
+	/// @brief Creates a FlowInfo object from topography, routing flow across flats.
+	/// @details Meant for a DEM filled with a minimum slope of zero. Instead of
+	/// relying on an epsilon gradient, cells on flats are given receivers that
+	/// lead away from higher terrain and towards lower terrain (Barnes et al.,
+	/// 2014, Computers & Geosciences 62, 128-135). The DEM is not altered and the
+	/// extra work is linear in the number of nodes. Flats with no lower outlet
+	/// keep their nodes as base level nodes.
+	/// @param BoundaryConditions Vector<string> of the boundary conditions at each
+	/// edge of the DEM, as for the other topographic constructor.
+	/// @param TopoRaster LSDRaster object containing the topographic data.
+	/// @param ResolveFlats If false this is the same as the other topographic
+	/// constructor.
+	/// @date 16/10/26
+	LSDFlowInfo(vector<string> BoundaryConditions, LSDRaster& TopoRaster, bool ResolveFlats)
+									{ create(BoundaryConditions, TopoRaster, ResolveFlats); }
 
 	/// @brief Copy of the LSDJunctionNetwork description here when written.
 	friend class LSDJunctionNetwork;
@@ -134,7 +285,8 @@ class LSDFlowInfo
   	/// @author SMM
     /// @date 01/016/12
 	void retrieve_current_row_and_col(int current_node,int& curr_row,
-                                             int& curr_col);
+                                             int& curr_col) const
+	  { curr_row = CellIndex[current_node]/NCols; curr_col = CellIndex[current_node]-curr_row*NCols; }
 
   ///@brief Get the number of pixels flowing into a node.
   ///@param node Integer of node index value.
@@ -144,13 +296,60 @@ class LSDFlowInfo
 	int retrieve_contributing_pixels_of_node(int node)
 										{ return NContributingNodes[node]; }
 
+  ///@brief Get the number of donors of a node.
+  ///@param node Integer of node index value.
+  ///@return Integer of the number of donors.
+  	/// @date 16/10/26
+	int retrieve_ndonors_of_node(int node) const
+										{ if (!CompactLayout) return DeltaVector[node+1]-DeltaVector[node];
+										  int donors[9]; return retrieve_donors_of_node(node,donors); }
+
+  ///@brief Get the receiver of a node.
+  ///@details Works in both the full and the compact layout; in the compact
+  ///layout the receiver is found from FlowDirectionCode.
+  ///@param node Integer of node index value.
+  ///@return Integer of the receiver node.
+  	/// @date 16/10/26
+	int retrieve_receiver_of_node(int node) const
+										{ return CompactLayout ? derive_receiver_of_node(node) : ReceiverVector[node]; }
+
+  ///@brief Get the donors of a node.
+  ///@details Works in both the full and the compact layout and gives the
+  ///donors in the same order, that of DonorStackVector.
+  ///@param node Integer of node index value.
+  ///@param donors Array of at least nine integers that is set to the donors.
+  ///@return Integer of the number of donors.
+  	/// @date 16/10/26
+	int retrieve_donors_of_node(int node, int* donors) const;
+
+  ///@brief Switches to the compact layout, which releases ReceiverVector,
+  ///DeltaVector and DonorStackVector.
+  ///@details Receivers are then found from FlowDirectionCode and NodeIndex,
+  ///and donors by testing the eight neighbours of a node, so the object holds
+  ///21 bytes per cell rather than 33, at the cost of slower receiver and
+  ///donor lookups. Functions that need the full vectors, such as pickle,
+  ///write_cache and update_for_edited_region, rebuild them for their run.
+  ///The full layout is the default.
+  	/// @date 16/10/26
+	void compact_layout();
+
+  ///@brief Switches back to the full layout, rebuilding ReceiverVector,
+  ///DeltaVector and DonorStackVector.
+  	/// @date 16/10/26
+	void full_layout();
+
+  ///@return True if the object is in the compact layout, see compact_layout().
+  	/// @date 16/10/26
+	bool is_compact_layout() const		{ return CompactLayout; }
+
   ///@brief Get the FlowLengthCode of a given node.
   ///@param node Integer of node index value.
   ///@return Integer of the FlowLengthCode.
   	/// @author SMM
     /// @date 01/016/12
   int retrieve_flow_length_code_of_node(int node)
-										{ return FlowLengthCode[ RowIndex[node] ][ ColIndex[node] ]; }
+										{ int row, col; retrieve_current_row_and_col(node,row,col);
+										  return flow_length_code(row,col); }
 
   ///@brief Get the FlowDirection of a row and column pair.
   ///@param row Integer of row index.
@@ -159,7 +358,7 @@ class LSDFlowInfo
   ///@author SWDG
   ///@date 04/02/14
   int get_LocalFlowDirection(int row, int col)
-										{ return FlowDirection[row][col]; }
+										{ return flow_direction(row,col); }
 
   ///@brief Get the node for a cell at a given row and column
   ///@param row index
@@ -190,9 +389,10 @@ class LSDFlowInfo
 										{ return BaseLevelNodeList; }
 
   	/// @return donor stack vector (depth first search sequence of nodes)
-	vector <int> get_donorStack( void ) { return DonorStackVector; }
-  	/// @return FlowDirection values as a 2D Array.
-	Array2D<int> get_FlowDirection() const { return FlowDirection; }
+	vector <int> get_donorStack( void ) const;
+  	/// @return FlowDirection values as a 2D Array, with NoDataValue where there
+  	/// is no data. See FlowDirectionCode.
+	Array2D<int> get_FlowDirection() const;
 
   ///@brief Recursive add_to_stack routine, from Braun and Willett (2012)
   ///equations 12 and 13.
@@ -275,6 +475,47 @@ class LSDFlowInfo
   /// @date 01/016/12
   void pickle(string filename);
 
+  /// @brief Makes the key a cache is looked up by: a checksum of the raw DEM,
+  /// the minimum slope it is filled with and the boundary conditions.
+  /// @details Keying on the raw DEM rather than the filled one means that a
+  /// matching cache lets a program skip the fill as well as the flow routing.
+  /// @param RawDEM The DEM before filling.
+  /// @param BoundaryConditions The boundary conditions of the flow routing.
+  /// @param FillSlope The minimum slope the DEM is filled with.
+  /// @return The key.
+  /// @date 16/10/26
+  static unsigned long long cache_key(LSDRaster& RawDEM, vector<string> BoundaryConditions,
+                                      float FillSlope);
+
+  /// @brief Writes this flow routing and the filled DEM it was made from to a
+  /// versioned binary cache, filename.FIcache.
+  /// @details The file is a header followed by the filled DEM, the three full
+  /// grid arrays and the node vectors, each written in one block and starting
+  /// on a 64 byte boundary, so that it can be mapped and used in place. The
+  /// header holds the key, a checksum of each array, the boundary conditions
+  /// and the size of the file.
+  /// @param filename The name of the cache, without the extension.
+  /// @param FilledDEM The DEM this object was made from.
+  /// @param Key The key to file the cache under, usually from cache_key.
+  /// @date 16/10/26
+  void write_cache(string filename, LSDRaster& FilledDEM, unsigned long long Key);
+
+  /// @brief Checks the header of a cache without reading the rest of it.
+  /// @param filename The name of the cache, without the extension.
+  /// @param Key The key the cache must have been written with.
+  /// @return True if the file exists, is of this version, has this key and is
+  /// complete.
+  /// @date 16/10/26
+  static bool cache_matches(string filename, unsigned long long Key);
+
+  /// @brief Reads the filled DEM out of a cache. The program stops if the
+  /// cache does not match Key or its checksum of the DEM.
+  /// @param filename The name of the cache, without the extension.
+  /// @param Key The key the cache must have been written with.
+  /// @return The filled DEM.
+  /// @date 16/10/26
+  static LSDRaster read_cached_DEM(string filename, unsigned long long Key);
+
   /// @brief Method to ingest the channel heads raster generated using channel_heads_driver.cpp
   /// into a vector of source nodes so that an LSDJunctionNetwork can be created easily 
   /// from them. 
@@ -304,6 +545,28 @@ class LSDFlowInfo
   /// @date 01/016/12
   void calculate_upslope_reference_indices();
 
+	///@brief Brings a filled DEM and this flow routing up to date after the raw
+	///DEM has been edited inside a box, without refilling the whole DEM.
+	///@details Only the cells whose filled elevation can change are refilled:
+	///the box, everything that drains into it and any filled depression that
+	///touches those cells. The receivers, donor stack, stack, contributing
+	///nodes and base level nodes are then patched in place. The result is
+	///identical to filling the edited DEM and building a new LSDFlowInfo from
+	///it.
+	///@param EditedDEM The raw DEM after the edit. The edit must be confined to
+	///the box and must not change which cells have data.
+	///@param FilledDEM The filled DEM this object was built from; it is refilled
+	///in place.
+	///@param MinSlope The minimum slope FilledDEM was filled with.
+	///@param first_row First row of the box.
+	///@param first_col First column of the box.
+	///@param last_row Last row of the box.
+	///@param last_col Last column of the box.
+	///@date 16/10/26
+	void update_for_edited_region(LSDRaster& EditedDEM, LSDRaster& FilledDEM,
+	                              float& MinSlope, int first_row, int first_col,
+	                              int last_row, int last_col);
+
 	// algorithms for basin collection
 	///@brief This function returns the base level node with the greatest
   ///drainage area.
@@ -318,6 +581,15 @@ class LSDFlowInfo
   /// @date 01/016/12
 	vector<int> get_upslope_nodes(int node_number_outlet);
 
+  ///@brief This function returns a view of all the node indexes upslope of
+  ///the node with number node_number_outlet, in the same order as
+  ///get_upslope_nodes but without copying them.
+  ///@param node_number_outlet Integer of the target node.
+  ///@return View of the upslope node indexes, valid as long as the stack of
+  ///this object is not changed.
+  /// @date 16/10/26
+	LSDNodeView get_upslope_node_view(int node_number_outlet) const;
+
 	///@brief This function tests whether one node is upstream of another node
 	///@param current_node
 	///@param test_node
@@ -326,6 +598,18 @@ class LSDFlowInfo
 	///@date 08/10/13
   int is_node_upstream(int current_node, int test_node);
 
+	///@brief This function finds the nodes of a list that have no other node of
+	///the list upstream of them.
+	///@details The upslope nodes of a node are one range of the stack, so this
+	///sorts the stack positions of the list once and needs one search per node
+	///instead of testing every pair with is_node_upstream.
+	///@param node_list The nodes. Repeats of a node do not count as upstream of
+	///it.
+	///@return The nodes of node_list with nothing upstream, in the order of
+	///node_list.
+	///@date 16/10/26
+  vector<int> get_most_upstream_nodes(vector<int>& node_list);
+
 
 	/// @brief this function gets a list of the node indices of the donors to a particular node
 	/// @param node this is the nodeindex of the node for which you want to find the donors
@@ -353,6 +637,33 @@ class LSDFlowInfo
    /// @author SMM
   /// @date 01/016/12
   vector<float> get_upslope_chi(vector<int>& upslope_pixel_list, float m_over_n, float A_0);
+  ///@brief This function calculates the chi function for all the nodes of a
+  ///view of upslope nodes, see get_upslope_node_view.
+  ///@param upslope_pixel_list View of the nodes to analyse.
+  ///@param m_over_n
+  ///@param A_0
+  ///@return Vector of chi values.
+  /// @date 16/10/26
+  vector<float> get_upslope_chi(LSDNodeView upslope_pixel_list, float m_over_n, float A_0);
+
+  ///@brief This function calculates chi for every node in the DEM, measured
+  ///from the base level node of its basin.
+  ///@details The stack is walked once from the outlets up, so each node costs
+  ///one pow. The chi of any node measured from an outlet downslope of it is
+  ///then the difference between their values in the table, which is why the
+  ///table is kept in double precision.
+  ///@param m_over_n
+  ///@param A_0
+  ///@return A vector indexed by node with the chi of each node.
+  /// @date 16/10/26
+  vector<double> calculate_base_level_chi(float m_over_n, float A_0);
+  ///@brief This function gets the chi of all the nodes upslope of a given
+  ///node from a table made by calculate_base_level_chi.
+  ///@param starting_node Integer index of node to analyse upslope of.
+  ///@param BaseLevelChi The table from calculate_base_level_chi.
+  ///@return Vector of chi values, in the order of get_upslope_nodes.
+  /// @date 16/10/26
+  vector<float> get_upslope_chi(int starting_node, vector<double>& BaseLevelChi);
 
 	/// @brief Calculates the distance from outlet of all the base level nodes.
 	/// Distance is given in spatial units, not in pixels.
@@ -369,6 +680,15 @@ class LSDFlowInfo
   /// @author SMM
   /// @date 25/19/13
 	int find_farthest_upslope_node(int node, LSDRaster& DistFromOutlet);
+
+	/// @brief This returns the farthest upslope node of every node, as found by
+	/// find_farthest_upslope_node, in one pass up the stack.
+	/// @details Use it when many nodes are queried, since each call of
+	/// find_farthest_upslope_node scans the whole upslope area of its node.
+	/// @param DistFromOutlet an LSDRaster containing the distance from the outlet.
+	/// @return A vector indexed by node with the farthest upslope node of each.
+	/// @date 16/10/26
+	vector<int> calculate_farthest_upslope_nodes(LSDRaster& DistFromOutlet);
 	
 	/// @brief Function to get the node index for a point using its X and Y coordinates
   /// @param X_coordinate X_coord of point
@@ -546,7 +866,7 @@ class LSDFlowInfo
 	/// An array that says what node number is at a given row and column.
 	Array2D<int> NodeIndex;
 
-  /// @brief A raster of flow direction information.
+  /// @brief A raster of flow direction information, one byte per cell.
   ///
 	/// In the format:
 	///
@@ -555,60 +875,54 @@ class LSDFlowInfo
 	/// 5  4 3 \n
 	///
 	/// Nodes with flow direction of -1 drain to themselvs and are base level/sink nodes.
-  Array2D<int> FlowDirection;
-
-  /// @brief A code to denote the flow length from the node to its reciever node.
-  /// <b>Each node has one and only one receiver.</b>
-  /// \n\n
-	/// 0 == no receiver/self receiver (base level) \n
-	/// 1 == cardinal direction, flow length = DataResolution \n
-	/// 2 == diagonal, flow length = DataResolution*(1/sqrt(2)) \n
-	Array2D<int> FlowLengthCode;
-
-	/// @brief This stores the row of a node in the vectorized
-	/// node index. It, combined with ColIndex, is the
-	/// inverse of NodeIndex.
-	vector<int> RowIndex;
-
-  /// @brief This stores the column of a node in the vectorized
-  /// node index. It, combined with RowIndex, is the
-  /// inverse of NodeIndex.
-	vector<int> ColIndex;
+	/// Cells without data hold FlowDirectionCodeNoData. Use flow_direction()
+	/// and flow_length_code() to read it: the flow length code, 0 for a self
+	/// receiver, 1 for a cardinal and 2 for a diagonal receiver, follows from
+	/// the direction and is not stored.
+  Array2D<signed char> FlowDirectionCode;
+
+	/// The value of FlowDirectionCode in cells without data.
+	static const signed char FlowDirectionCodeNoData = -128;
+
+	/// @brief Keep the scratch files behind NodeIndex and FlowDirectionCode
+	/// mapped. Empty when the arrays live on the heap.
+	/// See LSDRasterStorage.hpp.
+	LSDStorageHandle NodeIndexStorage;
+	LSDStorageHandle FlowDirectionCodeStorage;
+
+	/// @brief The row major index, row*NCols+col, of the cell of each node in
+	/// the vectorized node index. It is the inverse of NodeIndex; see
+	/// retrieve_current_row_and_col.
+	LSDNodeArray CellIndex;
 
   /// A list of base level nodes.
-	vector<int> BaseLevelNodeList;
-
-  /// Stores the number of donors to each node.
-	vector<int> NDonorsVector;
+	LSDNodeArray BaseLevelNodeList;
 
   /// Stores the node index of the receiving node.
-	vector<int> ReceiverVector;
+	LSDNodeArray ReceiverVector;
 
   /// @brief Stores the delta vector which is used to index into the donor stack
   /// and order contributing nodes. See Braun and Willett (2012).
-  vector<int> DeltaVector;
+  LSDNodeArray DeltaVector;
 
   /// This is a vector that stores the donor nodes of of the nodes and is
   /// indexed by the DeltaVector.
-  vector<int> DonorStackVector;
+  LSDNodeArray DonorStackVector;
 
   /// @brief This vector is used to caluculate flow accumulation. For each base
   /// level node it progresses from a hilltop to a confluence and then jumps to
   /// the next hilltop so that by cascading down through the node indices in
   /// this list one can quickly calculate drainage area, discharge, sediment
   /// flux, etc.
-	vector<int> SVector;
-
-  /// This stores the base level node for all of the nodes in the DEM.
-	vector<int> BLBasinVector;
+	LSDNodeArray SVector;
 
   /// This points to the starting point in the S vector of each node.
-	vector<int> SVectorIndex;
+	LSDNodeArray SVectorIndex;
 
   /// @brief The number of contributing nodes <b>INCULDING SELF</b> to a current
 	/// pixel. It is used in conjunction with the SVectorIndex to build
 	/// basins upslope of any and all nodes in the node list.
-	vector<int> NContributingNodes;
+	LSDNodeArray NContributingNodes;
 
   /// @brief Boundary conditions stored in a vector of four strings.
 	/// The conditions are North[0] East[1] South[2] West[3].
@@ -619,10 +933,77 @@ class LSDFlowInfo
 	/// first letter of the boundary condition. It is not case sensitive.
   vector<string> BoundaryConditions;
 
+  /// @brief True if the receivers on flats were assigned with the flat
+  /// resolution of the ResolveFlats constructor.
+  bool FlatsResolved;
+
+  /// @brief True if ReceiverVector, DeltaVector and DonorStackVector are
+  /// released, see compact_layout().
+  bool CompactLayout;
+
 	private:
 	void create();
 	void create(string fname);
-	void create(vector<string> temp_BoundaryConditions, LSDRaster& TopoRaster);
+	void create(string fname, unsigned long long Key);
+	void create(vector<string> temp_BoundaryConditions, LSDRaster& TopoRaster,
+	            bool ResolveFlats);
+
+	/// @brief Allocates NodeIndex and FlowDirectionCode, in scratch files if
+	/// these are switched on, and sets them to no data.
+	/// @date 16/10/26
+	void allocate_full_grid_arrays();
+
+	/// @return The receiver of a node, found from FlowDirectionCode.
+	/// @date 16/10/26
+	int derive_receiver_of_node(int node) const;
+
+	/// @return The flow direction of a cell, or NoDataValue if it has no data.
+	/// @date 16/10/26
+	int flow_direction(int row, int col) const
+	  { signed char code = FlowDirectionCode[row][col];
+	    return (code == FlowDirectionCodeNoData) ? NoDataValue : int(code); }
+
+	/// @return The flow length code of a cell, or NoDataValue if it has no data.
+	/// @date 16/10/26
+	int flow_length_code(int row, int col) const
+	  { signed char code = FlowDirectionCode[row][col];
+	    return (code == FlowDirectionCodeNoData) ? NoDataValue : ((code < 0) ? 0 : 1+(code&1)); }
+
+	/// @brief Finds the steepest descent receiver of a node, following the
+	/// boundary conditions.
+	/// @details Base level nodes and nodes with no lower neighbour are their own
+	/// receivers and get a flow direction of -1 and a flow length code of 0.
+	/// @param zeta The topography.
+	/// @param row Row of the node.
+	/// @param col Column of the node.
+	/// @param receive_row Set to the row of the receiver.
+	/// @param receive_col Set to the column of the receiver.
+	/// @param flow_direction Set to the flow direction code, see FlowDirectionCode.
+	/// @param flow_length_code Set to the flow length code, see FlowDirectionCode.
+	/// @date 16/10/26
+	void find_receiver(Array2D<float>& zeta, int row, int col,
+	                   int& receive_row, int& receive_col,
+	                   int& flow_direction, int& flow_length_code);
+
+	/// @brief Finds the steepest descent receivers of all the nodes that are not
+	/// on the edge of the DEM, in parallel.
+	/// @details Gives the same receivers as find_receiver, but as every interior
+	/// node has all eight neighbours in the grid it steps through the topography
+	/// with a table of flat offsets and has no boundary conditions to check.
+	/// Sets ReceiverVector, which must already have NDataNodes elements, and
+	/// FlowDirectionCode of the interior nodes.
+	/// @param zeta The topography.
+	/// @date 16/10/26
+	void find_interior_receivers(Array2D<float>& zeta);
+
+	/// @brief Gives receivers to the nodes on flats, which find_receiver leaves
+	/// as their own receivers, following Barnes et al. (2014).
+	/// @details Needs ReceiverVector, FlowDirectionCode and BaseLevelNodeList
+	/// as left by the receiver loop of create, and updates all of them. Sinks on the edge of the DEM or next to nodata are outlets and
+	/// keep draining out of the DEM.
+	/// @param zeta The topography.
+	/// @date 16/10/26
+	void resolve_flats(Array2D<float>& zeta);
 };
 
 #endif
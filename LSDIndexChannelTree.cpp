@@ -656,6 +656,32 @@ vector<LSDChannel> LSDIndexChannelTree::retrieve_LSDChannels_from_tree(float m_o
 	return vector_of_channels;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this sets the chi of the channels from retrieve_LSDChannels_from_tree to one
+// m over n value of their chi batches. The batches are measured from the bottom
+// of each channel, so the chi at the bottom is taken from the receiver channel,
+// as in retrieve_LSDChannels_from_tree
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDIndexChannelTree::set_chi_of_channels_from_batch(vector<LSDChannel>& vector_of_channels,
+                                    vector< Array2D<float> >& ChiBatches, int movn)
+{
+	int n_channels = vector_of_channels.size();
+	if (n_channels == 0)
+	{
+		return;
+	}
+
+	float downslope_chi = 0.0;
+	vector_of_channels[0].set_chi_from_batch(downslope_chi, ChiBatches[0], movn);
+	for(int trib = 1; trib<n_channels; trib++)
+	{
+		downslope_chi = vector_of_channels[receiver_channel[trib]].retrieve_chi_at_channel_node(node_on_receiver_channel[trib]);
+		vector_of_channels[trib].set_chi_from_batch(downslope_chi, ChiBatches[trib], movn);
+	}
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // this function uses the segment fitting tool to look for the best fit values of m over n
 //
@@ -719,14 +745,25 @@ float LSDIndexChannelTree::search_for_best_fit_m_over_n(float A_0, int n_movern,
 
   // some data about the AICc
 
+  // the channels are only built once. Their chi values for all the m_over_n
+  // values are calculated together, in the arrays of the last search, and each
+  // m_over_n takes one column of these
+  vector<LSDChannel> vector_of_channels = retrieve_LSDChannels_from_tree(start_movern, A_0, FlowInfo,
+									 Elevation_Raster);
+  chi_batches.resize(n_channels);
+  for (int chan = 0; chan<n_channels; chan++)
+    {
+      vector_of_channels[chan].calculate_chi_batch(A_0, n_movern, d_movern, start_movern,
+                                                   FlowInfo, chi_batches[chan]);
+    }
+
   // loop through m_over_n values
   for(int movn = 0; movn< n_movern; movn++)
     {
       m_over_n = float(movn)*d_movern+start_movern;
 
-      // get the vector of channels for this m_over_n
-      vector<LSDChannel> vector_of_channels = retrieve_LSDChannels_from_tree(m_over_n, A_0, FlowInfo,
-									 Elevation_Raster);
+      // set the chi of the channels for this m_over_n
+      set_chi_of_channels_from_batch(vector_of_channels, chi_batches, movn);
 
       vector<float> MLEs_thischan(n_channels);
       vector<int> n_segs_thischan(n_channels);
@@ -803,6 +840,7 @@ float LSDIndexChannelTree::search_for_best_fit_m_over_n(float A_0, int n_movern,
     //cout << "and the cumulative m_over n values"<< endl;
     float min_cum_AICc = 9999;
     float bf_cum_movn = start_movern;
+    int bf_cum_mn = 0;
     for (int mn = 0; mn< int(m_over_n_vec.size()); mn++)
       {
 		//cout << "m over n: " << m_over_n_vec[mn] << " and AICc: " << AICc_combined_vec[mn] << endl;
@@ -811,17 +849,17 @@ float LSDIndexChannelTree::search_for_best_fit_m_over_n(float A_0, int n_movern,
 	  	{
 	   	 	min_cum_AICc = AICc_combined_vec[mn];
 	    	bf_cum_movn = m_over_n_vec[mn];
+	    	bf_cum_mn = mn;
 	  	}
       }
 
     // now get the cumulative best fit channels
-    vector<LSDChannel> cum_bf_vector_of_channels = retrieve_LSDChannels_from_tree(bf_cum_movn, A_0, FlowInfo,
-									 Elevation_Raster);
+    set_chi_of_channels_from_batch(vector_of_channels, chi_batches, bf_cum_mn);
     // now loop through channels
     for (int chan = 0; chan<n_channels; chan++)
       {
 	// get the channels for this m over n ratio
-	cum_bf_vector_of_channels[chan].find_most_likeley_segments(minimum_segment_length, sigma, target_nodes,
+	vector_of_channels[chan].find_most_likeley_segments(minimum_segment_length, sigma, target_nodes,
 					    b_vec, m_vec, r2_vec,DW_vec,chi_thinned, elev_thinned,
 					    elev_fitted, node_ref_thinned,these_segment_lengths,
 					    this_MLE, this_n_segments, n_data_nodes,
@@ -312,6 +312,11 @@ class LSDIndexChannelTree
 	/// Vector of nodes along reciever channel.
 	vector<int> node_on_receiver_channel;
 
+	/// The chi values of every m over n of each channel from the last m over n
+	/// search, from LSDChannel::calculate_chi_batch. They are kept so that the
+	/// next search can reuse the arrays.
+	vector< Array2D<float> > chi_batches;
+
 	private:
 	void create(LSDFlowInfo& FlowInfo, LSDJunctionNetwork& ChannelNetwork, int starting_junction);
 	void create(LSDFlowInfo& FlowInfo, LSDJunctionNetwork& ChannelNetwork,
@@ -319,6 +324,15 @@ class LSDIndexChannelTree
 	void create(LSDFlowInfo& FlowInfo, LSDJunctionNetwork& ChannelNetwork,
 									int starting_junction, int org_switch, LSDRaster& DistanceFromOutlet,
 									int pruning_switch, float pruning_threshold);
+
+	/// @brief This sets the chi values of channels retrieved from the tree to one
+	/// m over n value of their batches, passing chi down from each receiver channel.
+	/// @param vector_of_channels The channels from retrieve_LSDChannels_from_tree.
+	/// @param ChiBatches The LSDChannel::calculate_chi_batch array of each channel.
+	/// @param movn The index of the m over n value.
+  /// @date 16/10/26
+	void set_chi_of_channels_from_batch(vector<LSDChannel>& vector_of_channels,
+	                                    vector< Array2D<float> >& ChiBatches, int movn);
 };
 
 #endif
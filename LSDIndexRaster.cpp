@@ -81,8 +81,14 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
 #include "TNT/tnt.h"
 #include "LSDIndexRaster.hpp"
+#include "LSDShapeTools.hpp"
+#include "LSDRasterWriteQueue.hpp"
+#include "LSDRasterTiles.hpp"
 using namespace std;
 using namespace TNT;
 
@@ -96,7 +102,7 @@ LSDIndexRaster& LSDIndexRaster::operator=(const LSDIndexRaster& rhs)
   if (&rhs != this)
    {
     create(rhs.get_NRows(),rhs.get_NCols(),rhs.get_XMinimum(),rhs.get_YMinimum(),
-           rhs.get_DataResolution(), rhs.get_NoDataValue(), rhs.get_RasterData() );
+           rhs.get_DataResolution(), rhs.get_NoDataValue(), rhs.RasterData );
    }
   return *this;
  }
@@ -128,19 +134,25 @@ void LSDIndexRaster::create(int nrows, int ncols, float xmin, float ymin,
 	DataResolution = cellsize;
 	NoDataValue = ndv;
 
-	RasterData = data.copy();
-
-	if (RasterData.dim1() != NRows)
+	if (data.dim1() != NRows)
 	{
 		cout << "dimesntion of data is not the same as stated in NRows!" << endl;
 		exit(EXIT_FAILURE);
 	}
-	if (RasterData.dim2() != NCols)
+	if (data.dim2() != NCols)
 	{
 		cout << "dimesntion of data is not the same as stated in NRows!" << endl;
 		exit(EXIT_FAILURE);
 	}
 
+	// copy the data into storage of our own, which is in a scratch file
+	// if one has been set up in LSDRasterStorage
+	LSDStorageHandle storage;
+	Array2D<int> own_data = allocate_raster_array<int>(NRows,NCols,storage);
+	own_data.inject(data);
+	RasterData = own_data;
+	RasterDataStorage = storage;
+
 }
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -178,6 +190,8 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 			    >> str >> XMinimum >> str >> YMinimum
 		   		>> str >> DataResolution
 			    >> str >> NoDataValue;
+		long header_length = long(data_in.tellg());
+		data_in.close();
 
 		cout << "Loading asc file; NCols: " << NCols << " NRows: " << NRows << endl
 		     << "X minimum: " << XMinimum << " YMinimum: " << YMinimum << endl
@@ -185,20 +199,39 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 		     << NoDataValue << endl;
 
 		// this is the array into which data is fed
-		Array2D<int> data(NRows,NCols,NoDataValue);
-
-		// read the data
-		for (int i=0; i<NRows; ++i)
+		LSDStorageHandle storage;
+		Array2D<int> data = allocate_raster_array<int>(NRows,NCols,storage);
+		data = NoDataValue;
+
+		// read the data. The whole file is read in one go and the values are
+		// then parsed in parallel, see ParseAsciiValues in LSDShapeTools
+		vector<char> text;
+		if (header_length < 0 || !ReadTextFile(string_filename, text))
 		{
-			for (int j=0; j<NCols; ++j)
-			{
-				data_in >> data[i][j];
-			}
+			cout << "\nFATAL ERROR: unable to read " << string_filename << endl;
+			exit(EXIT_FAILURE);
+		}
+		long NCells = long(NRows)*long(NCols);
+		long NValuesRead = 0;
+		if (NCells > 0)
+		{
+			NValuesRead = ParseAsciiValues(&text[0]+header_length, &text[0]+text.size(),
+			                               data[0], NCells);
+		}
+		if (NValuesRead < 0)
+		{
+			cout << "\nFATAL ERROR: " << string_filename << " contains a value that is not a number" << endl;
+			exit(EXIT_FAILURE);
+		}
+		else if (NValuesRead < NCells)
+		{
+			cout << "WARNING: " << string_filename << " only holds " << NValuesRead << " of "
+			     << NCells << " values, the rest are set to NoData" << endl;
 		}
-		data_in.close();
 
 		// now update the objects raster data
-		RasterData = data.copy();
+		RasterData = data;
+		RasterDataStorage = storage;
 	}
 	else if (extension == "flt")
 	{
@@ -209,6 +242,7 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 		header_filename = filename+dot+header_extension;
 
 		ifstream ifs(header_filename.c_str());
+		bool swap_bytes = false;
 		if( ifs.fail() )
 		{
 			cout << "\nFATAL ERROR: the header file \"" << header_filename
@@ -222,6 +256,7 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 				>> str >> XMinimum >> str >> YMinimum
 				>> str >> DataResolution
 				>> str >> NoDataValue;
+			swap_bytes = HeaderNeedsByteSwap(ifs);
 		}
 		ifs.close();
 
@@ -230,38 +265,84 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 		     << "Data Resolution: " << DataResolution << " and No Data Value: "
 		     << NoDataValue << endl;
 
-		// this is the array into which data is fed
-		Array2D<int> data(NRows,NCols,NoDataValue);
-
-		// now read the DEM, using the binary stream option
-		ifstream ifs_data(string_filename.c_str(), ios::in | ios::binary);
-		if( ifs_data.fail() )
+		// this is the array into which data is fed. TNT stores the rows of an
+		// Array2D in one contiguous block, so the file is read straight into it
+		LSDStorageHandle storage;
+		Array2D<int> data = allocate_raster_array<int>(NRows,NCols,storage);
+		long NCells = long(NRows)*long(NCols);
+		if (NCells > 0 && !ReadBinaryBlock(string_filename, data[0], NCells*long(sizeof(float))))
 		{
 			cout << "\nFATAL ERROR: the data file \"" << string_filename
-			     << "\" doesn't exist" << endl;
+			     << "\" doesn't exist or is smaller than its header states" << endl;
 			exit(EXIT_FAILURE);
 		}
-		else
+
+		// data written with the other byte order is swapped in one pass
+		if (swap_bytes && NCells > 0)
+		{
+			cout << "Swapping the byte order of " << string_filename << endl;
+			ByteSwapWords(sizeof(float), NCells, data[0]);
+		}
+
+		// the file holds 4 byte floats, the same width as the ints they
+		// were read into, so they are converted in place
+		if (NCells > 0)
 		{
+			int* cells = data[0];
 			float temp;
-			for (int i=0; i<NRows; ++i)
+			for (long k = 0; k<NCells; ++k)
 			{
-				for (int j=0; j<NCols; ++j)
-				{
-					ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-					data[i][j] = int(temp);
-				}
+				memcpy(&temp, &cells[k], sizeof(float));
+				cells[k] = int(temp);
 			}
 		}
-		ifs_data.close();
 
 		// now update the objects raster data
-		RasterData = data.copy();
+		RasterData = data;
+		RasterDataStorage = storage;
+	}
+	else if (extension == "lzt")
+	{
+		// a tiled, compressed raster. The header and tile index are in the
+		// same file as the data, see LSDRasterTiles
+		LSDTiledRasterInfo info;
+		string error = read_tiled_raster_info(string_filename, info);
+		if (!error.empty())
+		{
+			cout << "\nFATAL ERROR: " << error << endl;
+			exit(EXIT_FAILURE);
+		}
+		NRows = info.NRows;
+		NCols = info.NCols;
+		XMinimum = info.XMinimum;
+		YMinimum = info.YMinimum;
+		DataResolution = info.DataResolution;
+		NoDataValue = info.NoDataValue;
+
+		cout << "Loading lzt file; NCols: " << NCols << " NRows: " << NRows << endl
+			 << "X minimum: " << XMinimum << " YMinimum: " << YMinimum << endl
+		     << "Data Resolution: " << DataResolution << " and No Data Value: "
+		     << NoDataValue << endl;
+
+		LSDStorageHandle storage;
+		Array2D<int> data = allocate_raster_array<int>(NRows,NCols,storage);
+		if (NRows > 0 && NCols > 0)
+		{
+			error = read_tiled_raster_window(string_filename, info, 0, 0, NRows, NCols, data[0]);
+		}
+		if (!error.empty())
+		{
+			cout << "\nFATAL ERROR: " << error << endl;
+			exit(EXIT_FAILURE);
+		}
+
+		RasterData = data;
+		RasterDataStorage = storage;
 	}
 	else
 	{
 		cout << "You did not enter and approprate extension!" << endl
-				  << "You entered: " << extension << " options are .flt and .asc" << endl;
+				  << "You entered: " << extension << " options are .flt, .asc and .lzt" << endl;
 		exit(EXIT_FAILURE);
 	}
 
@@ -273,15 +354,54 @@ void LSDIndexRaster::read_raster(string filename, string extension)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // write_raster
 // this function writes a raster. One has to give the filename and extension
-// currently the options are for .asc and .flt files
+// currently the options are for .asc, .flt and .lzt files
 // SMM 2012
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDIndexRaster::write_raster(string filename, string extension)
+{
+	cout << "The filename is " << filename << "." << extension << endl;
+
+	string error = write_raster_file(filename, extension);
+	if (!error.empty())
+	{
+		cout << "\nFATAL ERROR: " << error << endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// write_raster_async
+// This queues a copy of the raster to be written by the background writer in
+// LSDRasterWriteQueue and returns straight away. The copy is made here, so the
+// raster can be changed or destroyed as soon as this returns. Errors are
+// reported by flush_raster_writes().
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDIndexRaster::write_raster_async(string filename, string extension)
+{
+	cout << "Queueing " << filename << "." << extension << " for writing" << endl;
+
+	shared_ptr<LSDIndexRaster> snapshot(new LSDIndexRaster(NRows,NCols,XMinimum,YMinimum,
+	                                         DataResolution,NoDataValue,RasterData));
+	queue_raster_write(filename+"."+extension,
+	                   [snapshot, filename, extension]()
+	                   { return snapshot->write_raster_file(filename, extension); });
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// write_raster_file
+// This does the writing for write_raster and write_raster_async. Rather than
+// exiting it returns a description of what went wrong, or an empty string if
+// the raster was written, since it may be running on the background writer.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string LSDIndexRaster::write_raster_file(string filename, string extension) const
 {
 	string string_filename;
 	string dot = ".";
 	string_filename = filename+dot+extension;
-	cout << "The filename is " << string_filename << endl;
 
 	// this first bit of logic is for the asc file.
 	if (extension == "asc")
@@ -291,8 +411,7 @@ void LSDIndexRaster::write_raster(string filename, string extension)
 
 		if( data_out.fail() )
 		{
-			cout << "\nFATAL ERROR: unable to write to " << string_filename << endl;
-			exit(EXIT_FAILURE);
+			return "unable to write to "+string_filename;
 		}
 
 		data_out <<  "ncols         " << NCols
@@ -302,16 +421,16 @@ void LSDIndexRaster::write_raster(string filename, string extension)
 				<< "\ncellsize      " << DataResolution
 				<< "\nNODATA_value  " << NoDataValue << endl;
 
-		for (int i=0; i<NRows; ++i)
+		// the rows are formatted in parallel, see WriteAsciiValues in LSDShapeTools
+		if (NRows > 0 && NCols > 0)
 		{
-			for (int j=0; j<NCols; ++j)
-			{
-				data_out << setprecision(6) << RasterData[i][j] << " ";
-			}
-			if (i != NRows-1) data_out << endl;
+			WriteAsciiValues(data_out, RasterData[0], NRows, NCols);
 		}
 		data_out.close();
-
+		if( data_out.fail() )
+		{
+			return "unable to write to "+string_filename;
+		}
 	}
 	else if (extension == "flt")
 	{
@@ -322,36 +441,59 @@ void LSDIndexRaster::write_raster(string filename, string extension)
 		header_filename = filename+dot+header_extension;
 
 		ofstream header_ofs(header_filename.c_str());
-		string str;
 		header_ofs <<  "ncols         " << NCols
 			<< "\nnrows         " << NRows
 			<< "\nxllcorner     " << setprecision(14) << XMinimum
 			<< "\nyllcorner     " << setprecision(14) << YMinimum
 			<< "\ncellsize      " << DataResolution
 			<< "\nNODATA_value  " << NoDataValue
-			<< "\nbyteorder     LSBFIRST" << endl;
+			<< "\nbyteorder     " << SystemByteOrder() << endl;
 		header_ofs.close();
+		if( header_ofs.fail() )
+		{
+			return "unable to write to "+header_filename;
+		}
 
-		// now do the main data
+		// now do the main data, converting to floats a row at a time
 		ofstream data_ofs(string_filename.c_str(), ios::out | ios::binary);
-		float temp;
+		vector<float> row_data(NCols);
 		for (int i=0; i<NRows; ++i)
 		{
 			for (int j=0; j<NCols; ++j)
 			{
-				temp = float(RasterData[i][j]);
-				data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
+				row_data[j] = float(RasterData[i][j]);
 			}
+			data_ofs.write(reinterpret_cast<const char *>(&row_data[0]),
+			               streamsize(NCols)*streamsize(sizeof(float)));
 		}
 		data_ofs.close();
+		if( data_ofs.fail() )
+		{
+			return "unable to write to "+string_filename;
+		}
+	}
+	else if (extension == "lzt")
+	{
+		// a tiled, compressed raster, see LSDRasterTiles. The values are
+		// stored as integers, so large indices survive the round trip
+		LSDTiledRasterInfo info;
+		info.NRows = NRows;
+		info.NCols = NCols;
+		info.XMinimum = XMinimum;
+		info.YMinimum = YMinimum;
+		info.DataResolution = DataResolution;
+		info.NoDataValue = NoDataValue;
+		info.TileSize = LSDDefaultTileSize;
+		return write_tiled_raster(string_filename, info,
+		                          (NRows > 0 && NCols > 0) ? RasterData[0] : NULL);
 	}
 	else
 	{
-		cout << "You did not enter and approprate extension!" << endl
-				  << "You entered: " << extension << " options are .flt and .asc" << endl;
-		exit(EXIT_FAILURE);
+		return "You did not enter and approprate extension!\nYou entered: "+extension
+		       +" options are .flt, .asc and .lzt";
 	}
 
+	return "";
 }
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -72,6 +72,7 @@
 #include <string>
 #include <vector>
 #include "TNT/tnt.h"
+#include "LSDRasterStorage.hpp"
 using namespace std;
 using namespace TNT;
 
@@ -126,8 +127,12 @@ class LSDIndexRaster
 	float get_DataResolution() const	{ return DataResolution; }
 	/// @return No Data Value as an integer.
 	int get_NoDataValue() const			{ return NoDataValue; }
-	/// @return Raster values as a 2D Array.
-	Array2D<int> get_RasterData() const { return RasterData; }
+	/// @return Raster values as a 2D Array. This is a copy, so that the array
+	/// cannot outlive the storage behind the raster.
+	Array2D<int> get_RasterData() const { return RasterData.copy(); }
+	/// @return A read only view of the raster values as one contiguous, cache line
+	/// aligned block, see LSDRasterStorage.hpp. It is valid while the raster is.
+	LSDRasterView<const int> get_RasterView() const { return make_raster_view(RasterData); }
 
 	/// Assignment operator.
 	LSDIndexRaster& operator=(const LSDIndexRaster& LSDIR);
@@ -147,6 +152,9 @@ class LSDIndexRaster
 	/// For float files both a data file and a header are read
 	/// the header file must have the same filename, before extention, of
 	/// the raster data, and the extension must be .hdr.
+	///
+	/// Rasters can also be read from the tiled, compressed .lzt format
+	/// described in LSDRasterTiles.hpp. Its header is part of the data file.
 	/// @author SMM
   /// @date 01/01/12
   void read_raster(string filename, string extension);
@@ -165,10 +173,27 @@ class LSDIndexRaster
 	/// For float files both a data file and a header are written
 	/// the header file must have the same filename, before extention, of
 	/// the raster data, and the extension must be .hdr.
+	///
+	/// With the extension lzt the raster is written as independently compressed
+	/// tiles of integers, see LSDRasterTiles.hpp. This is much smaller for
+	/// rasters that are mostly NoData, such as channel heads or stream orders.
 	/// @author SMM
   /// @date 01/01/12
   void write_raster(string filename, string extension);
 
+  /// @brief Write a raster to a file in the background.
+  ///
+  /// @details A copy of the raster is queued with the background writer (see
+  /// LSDRasterWriteQueue.hpp) and the function returns straight away, so the
+  /// raster may be changed or destroyed afterwards. The file formats are the
+  /// same as for write_raster. Errors are reported by flush_raster_writes(),
+  /// which should be called before the files are used.
+  ///
+  /// @param filename a string of the filename _without_ the extension.
+  /// @param extension a string of the extension _without_ the leading dot
+  /// @date 16/10/26
+  void write_raster_async(string filename, string extension);
+
   /// @brief Get the raster data at a specified location.
   /// @param row An integer, the X coordinate of the target cell.
   /// @param column An integer, the Y coordinate of the target cell.
@@ -231,7 +256,16 @@ class LSDIndexRaster
 	/// Raster data.
 	Array2D<int> RasterData;
 
+	/// @brief Keeps the scratch file behind RasterData mapped. Empty when
+	/// RasterData lives on the heap. See LSDRasterStorage.hpp.
+	LSDStorageHandle RasterDataStorage;
+
 	private:
+	/// @brief Writes the raster for write_raster and write_raster_async.
+	/// @return An empty string on success, otherwise a description of the error.
+	/// @date 16/10/26
+	string write_raster_file(string filename, string extension) const;
+
 	void create();
 	void create(string filename, string extension);
 	void create(int ncols, int nrows, float xmin, float ymin,
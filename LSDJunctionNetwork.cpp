@@ -140,6 +140,8 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 	int current_stream_order;
 	int junction_switch;
 	int donor_node, donor_row,donor_col;
+	int donors[9];
+	int n_donors;
 	int n_current_stream_order_donors;
 
 	// loop through sources.
@@ -152,9 +154,8 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 		baselevel_switch =0;			// 0 == not base level
 		junction_switch = 0;			// 0 == no junction so far
 		current_node = SourcesVector[src];
-		current_row = FlowInfo.RowIndex[current_node];
-		current_col = FlowInfo.ColIndex[current_node];
-		receiver_node = FlowInfo.ReceiverVector[current_node];
+		FlowInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
+		receiver_node = FlowInfo.retrieve_receiver_of_node(current_node);
 
 		current_stream_order = 1;
 
@@ -266,15 +267,15 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 							// this means that the current stream order is equal to or less than the streamorder
 							// currently at this node this means you need to check and see if the thing is incremented
 							n_current_stream_order_donors = 0;
-							for(int dnode = 0; dnode<FlowInfo.NDonorsVector[current_node]; dnode++)
+							n_donors = FlowInfo.retrieve_donors_of_node(current_node,donors);
+							for(int dnode = 0; dnode<n_donors; dnode++)
 							{
-								donor_node = FlowInfo.DonorStackVector[ FlowInfo.DeltaVector[current_node]+dnode];
+								donor_node = donors[dnode];
 
 								// ignore the base level donor
 								if (donor_node != current_node)
 								{
-									donor_row = FlowInfo.RowIndex[ donor_node ];
-									donor_col = FlowInfo.ColIndex[ donor_node ];
+									FlowInfo.retrieve_current_row_and_col(donor_node,donor_row,donor_col);
 
 									if (StreamOrderArray[donor_row][donor_col] == current_stream_order)
 									{
@@ -315,12 +316,11 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 
 
 			// get the next current node, which is this nodes receiver
-			current_node = FlowInfo.ReceiverVector[current_node];
+			current_node = FlowInfo.retrieve_receiver_of_node(current_node);
 
 			// get the next receiver node, which is the next node
-			receiver_node = FlowInfo.ReceiverVector[current_node];
-			current_row = FlowInfo.RowIndex[current_node];
-			current_col = FlowInfo.ColIndex[current_node];
+			receiver_node = FlowInfo.retrieve_receiver_of_node(current_node);
+			FlowInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
 
 			// if this is a baselevel node
 			if (current_node == receiver_node)
@@ -348,9 +348,8 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 		baselevel_switch =0;			// 0 == not base level
 		junction_switch = 0;			// 0 == no junction so far
 		current_node = SourcesVector[src];
-		current_row = FlowInfo.RowIndex[current_node];
-		current_col = FlowInfo.ColIndex[current_node];
-		receiver_node = FlowInfo.ReceiverVector[current_node];
+		FlowInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
+		receiver_node = FlowInfo.retrieve_receiver_of_node(current_node);
 
 		//cout << "LINE 257 ChNet, SOURCE: " << src <<  " n_src: " << n_sources << " current_node: " << current_node
 		//     << " and rnode: " << receiver_node << endl;
@@ -390,9 +389,8 @@ void LSDJunctionNetwork::create(vector<int> Sources, LSDFlowInfo& FlowInfo)
 			//cout << "Line 286, current node = " << current_node << " and rode: " << receiver_node << endl;
 			current_node = receiver_node;
 			//cout << "Line 288, current node = " << current_node << " and rode: " << receiver_node << endl;
-			current_row = FlowInfo.RowIndex[current_node];
-			current_col = FlowInfo.ColIndex[current_node];
-			receiver_node = FlowInfo.ReceiverVector[current_node];
+			FlowInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
+			receiver_node = FlowInfo.retrieve_receiver_of_node(current_node);
 
 			// first we need logic for if this is a baselevel node
 			if (current_node == receiver_node)
@@ -840,8 +838,7 @@ LSDIndexChannel LSDJunctionNetwork::generate_longest_index_channel_from_junction
 	{
 		current_junc = us_junctions[j];
 		current_node = JunctionVector[current_junc];
-		current_row = FInfo.RowIndex[current_node];
-		current_col = FInfo.ColIndex[current_node];
+		FInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
 		current_dist = dist_from_outlet.get_data_element(current_row,current_col);
 		if(current_dist > farthest_dist)
 		{
@@ -893,8 +890,7 @@ LSDIndexChannel LSDJunctionNetwork::generate_longest_index_channel_in_basin(int
 	{
 		current_junc = us_junctions[j];
 		current_node = JunctionVector[current_junc];
-		current_row = FInfo.RowIndex[current_node];
-		current_col = FInfo.ColIndex[current_node];
+		FInfo.retrieve_current_row_and_col(current_node,current_row,current_col);
 		current_dist = dist_from_outlet.get_data_element(current_row,current_col);
 		if(current_dist > farthest_dist)
 		{
@@ -1367,7 +1363,7 @@ LSDIndexRaster LSDJunctionNetwork::ExtractBasinsOrder(int BasinOrder, LSDFlowInf
           // gets crazy again here.
           basin_outlet = StreamLinkVector.get_node_in_channel(n_nodes_in_channel-2);
           // Get all contributing pixels and label with BasinID
-          vector<int> BasinNodeVector = FlowInfo.get_upslope_nodes(basin_outlet);
+          LSDNodeView BasinNodeVector = FlowInfo.get_upslope_node_view(basin_outlet);
           // Loop through basin to label basin pixels with basin ID
           for (int BasinIndex = 0; BasinIndex < int(BasinNodeVector.size()); ++BasinIndex)
           {
@@ -1517,6 +1513,30 @@ int LSDJunctionNetwork::GetChannelHeadsChiMethodFromJunction(int JunctionNumber,
   return channel_head_node;
 }      
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+// As above, with the hilltop node looked up in a table made by
+// LSDFlowInfo::calculate_farthest_upslope_nodes and chi looked up in a table
+// made by LSDFlowInfo::calculate_base_level_chi
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+int LSDJunctionNetwork::GetChannelHeadsChiMethodFromJunction(int JunctionNumber,
+                                      int MinSegLength, vector<double>& BaseLevelChi,
+											                LSDFlowInfo& FlowInfo, vector<int>& FarthestUpslopeNodes,
+											                LSDRaster& ElevationRaster)
+{
+	float downslope_chi = 0;
+
+	// get the node index of this junction and its hilltop node
+	int downstream_node_index = JunctionVector[JunctionNumber];
+	int hilltop_node = FarthestUpslopeNodes[downstream_node_index];
+
+	//perform chi segment fitting
+	LSDChannel new_channel(hilltop_node, downstream_node_index, downslope_chi, BaseLevelChi, FlowInfo,  ElevationRaster);
+  int channel_head_node = new_channel.calculate_channel_heads(MinSegLength, BaseLevelChi);
+
+  return channel_head_node;
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
 
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
@@ -1541,49 +1561,42 @@ vector<int> LSDJunctionNetwork::GetChannelHeadsChiMethodBasinOrder(int BasinOrde
   	vector<int> junction_list = extract_basins_order_outlet_junctions(BasinOrder, FlowInfo);
   	int max_junctions = junction_list.size();
   	cout << "No of junctions: " << max_junctions << endl;
-  	int junction_number = 0;
 
-	 //loop through junctions collecting channel heads
+  	// the hilltops and chi of all the junctions are found in one pass each
+  	vector<int> FarthestUpslopeNodes = FlowInfo.calculate_farthest_upslope_nodes(FlowDistance);
+  	vector<double> BaseLevelChi = FlowInfo.calculate_base_level_chi(m_over_n, A_0);
+
+	 //loop through junctions collecting channel heads. The junctions only read
+	 // the shared data so they are shared out between the OpenMP threads, and
+	 // each channel head goes in the slot of its junction so the list is in the
+	 // same order however many threads there are
+	  ChannelHeadNodes_temp.resize(max_junctions);
+	  int n_junctions_done = 0;
+	  int n_junctions_reported = 0;
+	  #pragma omp parallel for schedule(dynamic)
     for (int i = 0; i < max_junctions; i++)
   	{
-		  cout << "Junction " << i << " of " << max_junctions << endl;
-
-		  // get the junction number
-		  junction_number = junction_list[i];
-
 		  // get a local list of channel heads
-		  int channel_head_node = GetChannelHeadsChiMethodFromJunction(junction_number,
-                                      			MinSegLength, A_0, m_over_n, FlowInfo,
-                                       			FlowDistance, ElevationRaster);
-
-      // now append these channel heads to the master list
-		  //ChannelHeadNodes_temp.insert(ChannelHeadNodes_temp.end(), these_channel_heads.begin(), these_channel_heads.end());
-		  ChannelHeadNodes_temp.push_back(channel_head_node);
+		  ChannelHeadNodes_temp[i] = GetChannelHeadsChiMethodFromJunction(junction_list[i],
+                                      			MinSegLength, BaseLevelChi, FlowInfo,
+                                       			FarthestUpslopeNodes, ElevationRaster);
+
+		  int this_n_done;
+		  #pragma omp atomic capture
+		  this_n_done = ++n_junctions_done;
+		  if (this_n_done % 100 == 0 || this_n_done == max_junctions)
+		  {
+		    #pragma omp critical(junction_progress)
+		    if (this_n_done > n_junctions_reported)
+		    {
+		      n_junctions_reported = this_n_done;
+		      cout << "Junction " << this_n_done << " of " << max_junctions << endl;
+		    }
+		  }
 	  }
 	  
 	  // Removing any nodes that are not the furthest upstream
-    int upstream_test = 0;
-    vector<int>::iterator find_it;
-
-    for (unsigned int node =0; node < ChannelHeadNodes_temp.size(); node++)
-    {
-      vector<int> tests;
-      int current_node = ChannelHeadNodes_temp[node];
-      for (unsigned int i = 0; i < ChannelHeadNodes_temp.size(); i++)
-      {
-        if (ChannelHeadNodes_temp[i] != current_node)
-        {
-          int test_node = ChannelHeadNodes_temp[i];
-          upstream_test = FlowInfo.is_node_upstream(current_node, test_node);
-          tests.push_back(upstream_test);
-        }
-      }
-      find_it = find(tests.begin(), tests.end(), 1);
-      if (find_it == tests.end())
-      {
-        ChannelHeadNodes.push_back(current_node);
-      }
-    }
+    ChannelHeadNodes = FlowInfo.get_most_upstream_nodes(ChannelHeadNodes_temp);
     
     return ChannelHeadNodes;
 }                              
@@ -1621,81 +1634,53 @@ vector<int> LSDJunctionNetwork::GetChannelHeadsChiMethodFromValleys(Array2D<int>
   
   int max_junctions = junction_list.size();
   cout << "No of junctions: " << max_junctions << endl;
-  int junction_number = 0;
+
+  // the hilltops and chi of all the junctions are found in one pass each
+  vector<int> FarthestUpslopeNodes = FlowInfo.calculate_farthest_upslope_nodes(FlowDistance);
+  vector<double> BaseLevelChi = FlowInfo.calculate_base_level_chi(m_over_n, A_0);
   
-  //loop through junctions collecting channel heads
+  //loop through junctions collecting channel heads, in parallel as in
+  // GetChannelHeadsChiMethodBasinOrder
+  ChannelHeadNodes_temp.resize(max_junctions);
+  int n_junctions_done = 0;
+  int n_junctions_reported = 0;
+  #pragma omp parallel for schedule(dynamic)
   for (int i = 0; i < max_junctions; i++)
   {
-	  cout << flush << "Junction = " << i+1 << " of " << max_junctions << "\r";
-
-    // get the junction number
-	  junction_number = junction_list[i];
-  
     // get a local list of channel heads
-	  int channel_head_node = GetChannelHeadsChiMethodFromJunction(junction_number,
-                                      			MinSegLength, A_0, m_over_n, FlowInfo,
-                                       			FlowDistance, ElevationRaster);
-
-     // now append these channel heads to the master list
-	  //ChannelHeadNodes_temp.insert(ChannelHeadNodes_temp.end(), these_channel_heads.begin(), these_channel_heads.end());
-	  ChannelHeadNodes_temp.push_back(channel_head_node);
+	  ChannelHeadNodes_temp[i] = GetChannelHeadsChiMethodFromJunction(junction_list[i],
+                                      			MinSegLength, BaseLevelChi, FlowInfo,
+                                       			FarthestUpslopeNodes, ElevationRaster);
+
+	  int this_n_done;
+	  #pragma omp atomic capture
+	  this_n_done = ++n_junctions_done;
+	  if (this_n_done % 100 == 0 || this_n_done == max_junctions)
+	  {
+	    #pragma omp critical(junction_progress)
+	    if (this_n_done > n_junctions_reported)
+	    {
+	      n_junctions_reported = this_n_done;
+	      cout << flush << "Junction = " << this_n_done << " of " << max_junctions << "\r";
+	    }
+	  }
 	}
 	  
 	cout << "Removing downstream channel heads" << endl;
-  // Removing any nodes that are not the furthest upstream
-  Array2D<int> binary_map(NRows,NCols,NoDataValue);
-  vector<float> possible_sources_elev;
-  for (unsigned int node =0; node < ChannelHeadNodes_temp.size(); node++)
+  // Removing any nodes that are not the furthest upstream. Each channel head is
+  // listed once, in node order, which is the order of the rows and columns, and
+  // nodes that drain to themselves are not channel heads
+  sort(ChannelHeadNodes_temp.begin(), ChannelHeadNodes_temp.end());
+  ChannelHeadNodes_temp.erase(unique(ChannelHeadNodes_temp.begin(), ChannelHeadNodes_temp.end()),
+                              ChannelHeadNodes_temp.end());
+  vector<int> MostUpstreamNodes = FlowInfo.get_most_upstream_nodes(ChannelHeadNodes_temp);
+  for (unsigned int i = 0; i < MostUpstreamNodes.size(); i++)
   {
-    int row, col;
-    FlowInfo.retrieve_current_row_and_col(ChannelHeadNodes_temp[node], row, col);
-    float elev = ElevationRaster.get_data_element(row,col);
-    possible_sources_elev.push_back(elev);
-    binary_map[row][col] = 1;
-  }
-
-  //sort potential source nodes by highest elevation
-  vector<size_t> index_map;
-
-  matlab_float_sort_descending(possible_sources_elev, possible_sources_elev, index_map);
-  matlab_int_reorder(ChannelHeadNodes_temp, index_map, ChannelHeadNodes_temp);
-  
-  Array2D<int> NodesVisitedBefore(NRows,NCols,0);
-  for (unsigned int i = 0; i < ChannelHeadNodes_temp.size(); i++)
-  {
-    cout << flush << "Node " << i+1 << " of " << ChannelHeadNodes_temp.size() << "\r";
-    int CurrentNode = ChannelHeadNodes_temp[i];
-    int CurrentRow,CurrentCol,ReceiverNode,ReceiverRow,ReceiverCol; 
-    bool EndOfReach = false;
-    while (EndOfReach == false)
-    {
-      FlowInfo.retrieve_current_row_and_col(CurrentNode,CurrentRow,CurrentCol);
-      FlowInfo.retrieve_receiver_information(CurrentNode, ReceiverNode, ReceiverRow, ReceiverCol);
-      NodesVisitedBefore[CurrentRow][CurrentCol] = 1;
-      if (binary_map[ReceiverRow][ReceiverCol] == 1)
-      {
-        binary_map[ReceiverRow][ReceiverCol] = 0;
-        CurrentNode = ReceiverNode;
-      }
-      else
-      {
-        CurrentNode = ReceiverNode;
-      }
-      bool ReceiverVisitedBefore = false;
-      if(NodesVisitedBefore[ReceiverRow][ReceiverCol]==1) ReceiverVisitedBefore = true;
-      if(ReceiverVisitedBefore ==true) EndOfReach = true;
-    }
-  }
-  
-  for (int row = 0; row < NRows; row++)
-  {
-    for (int col = 0; col < NCols; col++)
+    int ReceiverNode,ReceiverRow,ReceiverCol;
+    FlowInfo.retrieve_receiver_information(MostUpstreamNodes[i], ReceiverNode, ReceiverRow, ReceiverCol);
+    if (ReceiverNode != MostUpstreamNodes[i])
     {
-      if (binary_map[row][col] == 1)
-      {
-        int SourceNode = FlowInfo.retrieve_node_from_row_and_column(row,col);
-        ChannelHeadNodes.push_back(SourceNode);
-      }
+      ChannelHeadNodes.push_back(MostUpstreamNodes[i]);
     }
   }
   
@@ -1725,6 +1710,34 @@ vector<int> LSDJunctionNetwork::GetChannelHeadsChiMethodFromValleys(Array2D<int>
 Array2D<int> LSDJunctionNetwork::GetChannelHeadsChiMethodAllPixels(int JunctionNumber,
                                       float A_0, float m_over_n, float bin_width, LSDFlowInfo& FlowInfo,
                                       LSDRaster& ElevationRaster)
+{
+  vector<float> upslope_chi = FlowInfo.get_upslope_chi(JunctionVector[JunctionNumber], m_over_n, A_0);
+  return ChannelPixelsFromUpslopeChi(JunctionNumber, upslope_chi, bin_width, FlowInfo, ElevationRaster);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+// As above, with chi taken from a table made by
+// LSDFlowInfo::calculate_base_level_chi
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+Array2D<int> LSDJunctionNetwork::GetChannelHeadsChiMethodAllPixels(int JunctionNumber,
+                                      vector<double>& BaseLevelChi, float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster)
+{
+  vector<float> upslope_chi = FlowInfo.get_upslope_chi(JunctionVector[JunctionNumber], BaseLevelChi);
+  return ChannelPixelsFromUpslopeChi(JunctionNumber, upslope_chi, bin_width, FlowInfo, ElevationRaster);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+// The binning and fitting of GetChannelHeadsChiMethodAllPixels, given the chi of the nodes
+// upslope of the junction
+//
+// FC 01/10/13
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+Array2D<int> LSDJunctionNetwork::ChannelPixelsFromUpslopeChi(int JunctionNumber, vector<float>& upslope_chi,
+                                      float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster)
 {
   Array2D<int> channel_pixels(NRows,NCols,NoDataValue);
   // get the node index of this junction
@@ -1734,8 +1747,7 @@ Array2D<int> LSDJunctionNetwork::GetChannelHeadsChiMethodAllPixels(int JunctionN
 	jn_name = uscore+jn_name;
 
   //get the chi and elevation values of each upslope node
-  vector<int> upslope_nodes = FlowInfo.get_upslope_nodes(starting_node);
-  vector<float> upslope_chi = FlowInfo.get_upslope_chi(starting_node, m_over_n, A_0);
+  LSDNodeView upslope_nodes = FlowInfo.get_upslope_node_view(starting_node);
   vector<float> elevation;
   int row,col;
 
@@ -1912,6 +1924,34 @@ Array2D<int> LSDJunctionNetwork::GetChannelHeadsChiMethodAllPixels(int JunctionN
 vector<int> LSDJunctionNetwork::GetSourceNodesChiMethodAllPixels(int JunctionNumber,
                                       float A_0, float m_over_n, float bin_width, LSDFlowInfo& FlowInfo,
                                       LSDRaster& ElevationRaster)
+{
+  vector<float> upslope_chi = FlowInfo.get_upslope_chi(JunctionVector[JunctionNumber], m_over_n, A_0);
+  return SourceNodesFromUpslopeChi(JunctionNumber, upslope_chi, bin_width, FlowInfo, ElevationRaster);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+// As above, with chi taken from a table made by
+// LSDFlowInfo::calculate_base_level_chi
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+vector<int> LSDJunctionNetwork::GetSourceNodesChiMethodAllPixels(int JunctionNumber,
+                                      vector<double>& BaseLevelChi, float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster)
+{
+  vector<float> upslope_chi = FlowInfo.get_upslope_chi(JunctionVector[JunctionNumber], BaseLevelChi);
+  return SourceNodesFromUpslopeChi(JunctionNumber, upslope_chi, bin_width, FlowInfo, ElevationRaster);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+// The binning and fitting of GetSourceNodesChiMethodAllPixels, given the chi of the nodes
+// upslope of the junction
+//
+// FC 01/10/13
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=--=-=-=-=-=-=-=-=-=-=-=-==-=-=-=-=-=-
+vector<int> LSDJunctionNetwork::SourceNodesFromUpslopeChi(int JunctionNumber, vector<float>& upslope_chi,
+                                      float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster)
 {
   // get the node index of this junction
 	int starting_node = JunctionVector[JunctionNumber];
@@ -1920,8 +1960,7 @@ vector<int> LSDJunctionNetwork::GetSourceNodesChiMethodAllPixels(int JunctionNum
 	jn_name = uscore+jn_name;
 
   //get the chi and elevation values of each upslope node
-  vector<int> upslope_nodes = FlowInfo.get_upslope_nodes(starting_node);
-  vector<float> upslope_chi = FlowInfo.get_upslope_chi(starting_node, m_over_n, A_0);
+  LSDNodeView upslope_nodes = FlowInfo.get_upslope_node_view(starting_node);
   vector<float> elevation;
   int row,col;
 
@@ -2042,29 +2081,7 @@ vector<int> LSDJunctionNetwork::GetSourceNodesChiMethodAllPixels(int JunctionNum
 
   // find the furthest upslope nodes classified as being part of the channel network (use as sources for next
   // step of chi method)
-
-  int upstream_test = 0;
-  vector<int>::iterator find_it;
-
-  for (unsigned int node =0; node < channel_nodes.size(); node++)
-  {
-     vector<int> tests;
-     int current_node = channel_nodes[node];
-     for (unsigned int i = 0; i < channel_nodes.size(); i++)
-     {
-      if (channel_nodes[i] != current_node)
-      {
-        int test_node = channel_nodes[i];
-        upstream_test = FlowInfo.is_node_upstream(current_node, test_node);
-        tests.push_back(upstream_test);
-      }
-     }
-     find_it = find(tests.begin(), tests.end(), 1);
-     if (find_it == tests.end())
-     {
-      source_nodes.push_back(current_node);
-     }
-  }
+  source_nodes = FlowInfo.get_most_upstream_nodes(channel_nodes);
   cout << "No of channel nodes: " << channel_nodes.size() << endl;
   cout << "No of source nodes: " << source_nodes.size() << endl;
   return source_nodes;
@@ -2152,31 +2169,9 @@ vector<int> LSDJunctionNetwork::calculate_pelletier_channel_heads(float tan_curv
   cout << "Got channel nodes" << endl;  
   // STEP 3: Finding the furthest upstream channel node
   
-  int upstream_test = 0;
-  vector<int>::iterator find_it;
-  vector<int> source_nodes;
-
   // identify whether there are any further upstream channel nodes, if not then
   // the node is a channel head
-  for (unsigned int node =0; node < channel_nodes.size(); node++)
-  {
-     vector<int> tests;
-     int current_node = channel_nodes[node];
-     for (unsigned int i = 0; i < channel_nodes.size(); i++)
-     {
-      if (channel_nodes[i] != current_node)
-      {
-        int test_node = channel_nodes[i];
-        upstream_test = FlowInfo.is_node_upstream(current_node, test_node);
-        tests.push_back(upstream_test);
-      }
-     }
-     find_it = find(tests.begin(), tests.end(), 1);
-     if (find_it == tests.end())
-     {
-      source_nodes.push_back(current_node);
-     }
-  }
+  vector<int> source_nodes = FlowInfo.get_most_upstream_nodes(channel_nodes);
   cout << "Got source nodes" << endl;
   cout << "No of channel nodes: " << channel_nodes.size() << " No of source nodes: " << source_nodes.size() << endl;
   return source_nodes;
@@ -3119,7 +3114,7 @@ LSDIndexRaster LSDJunctionNetwork::extract_basin_from_junction(int basin_junctio
      int node,row,col;
 
     basin_outlet = StreamLinkVector.get_node_in_channel(n_nodes_in_channel-2);
-    vector<int> BasinNodeVector = FlowInfo.get_upslope_nodes(basin_outlet);
+    LSDNodeView BasinNodeVector = FlowInfo.get_upslope_node_view(basin_outlet);
     // Loop through basin to label basin pixels with basin ID
     for (int BasinIndex = 0; BasinIndex < int(BasinNodeVector.size()); ++BasinIndex)
     {
@@ -3187,7 +3182,7 @@ LSDIndexRaster LSDJunctionNetwork::extract_hollow(int CH_junction, LSDFlowInfo&
                                                            receiver_junc, JunctionVector[receiver_junc], FlowInfo);
                                                            
   hollow_outlet = StreamLinkVector.get_node_in_channel(0); //get the tip of the channel
-  vector<int> HollowNodeVector = FlowInfo.get_upslope_nodes(hollow_outlet);
+  LSDNodeView HollowNodeVector = FlowInfo.get_upslope_node_view(hollow_outlet);
   
   // Loop through basin to label basin pixels with basin ID
   for (int HollowIndex = 0; HollowIndex < int(HollowNodeVector.size()); ++HollowIndex){
@@ -3241,7 +3236,7 @@ LSDIndexRaster LSDJunctionNetwork::extract_hollow(vector<int> CH_junctions, LSDF
                                                              receiver_junc, JunctionVector[receiver_junc], FlowInfo);
   
     hollow_outlet = StreamLinkVector.get_node_in_channel(0); //get the tip of the channel
-    vector<int> HollowNodeVector = FlowInfo.get_upslope_nodes(hollow_outlet);
+    LSDNodeView HollowNodeVector = FlowInfo.get_upslope_node_view(hollow_outlet);
     
     // Loop through basin to label basin pixels with basin ID
     for (int HollowIndex = 0; HollowIndex < int(HollowNodeVector.size()); ++HollowIndex){
@@ -3301,7 +3296,7 @@ LSDIndexRaster LSDJunctionNetwork::extract_basins_from_junction_vector(vector<in
       int node,row,col;
 
       basin_outlet = StreamLinkVector.get_node_in_channel(n_nodes_in_channel-2);
-      vector<int> BasinNodeVector = FlowInfo.get_upslope_nodes(basin_outlet);
+      LSDNodeView BasinNodeVector = FlowInfo.get_upslope_node_view(basin_outlet);
       // Loop through basin to label basin pixels with basin ID
       for (int BasinIndex = 0; BasinIndex < int(BasinNodeVector.size()); ++BasinIndex)
       {
@@ -3403,6 +3398,41 @@ LSDIndexRaster LSDJunctionNetwork::StreamOrderArray_to_BinaryNetwork_LSDIndexRas
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this sends the StreamOrderArray to a raster of one byte cells. Stream orders
+// never come close to 255, which is left for NoData
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDByteRaster LSDJunctionNetwork::StreamOrderArray_to_LSDByteRaster()
+{
+	LSDIndexRaster IR(NRows,NCols, XMinimum, YMinimum, DataResolution, NoDataValue, StreamOrderArray);
+	return LSDByteRaster(IR);
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this turns the StreamOrderArray into a one bit per cell mask of the channels
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDMaskRaster LSDJunctionNetwork::StreamOrderArray_to_BinaryNetwork_LSDMaskRaster()
+{
+	LSDMaskRaster Mask(NRows,NCols, XMinimum, YMinimum, DataResolution, NoDataValue);
+	for(int row = 0; row<NRows; row++)
+	{
+		for (int col = 0; col<NCols; col++)
+		{
+			if(StreamOrderArray[row][col] != NoDataValue && StreamOrderArray[row][col] >= 1)
+			{
+				Mask.set_data_element(row,col,true);
+			}
+		}
+	}
+	return Mask;
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // this prints the junction information
@@ -3577,10 +3607,10 @@ bool LSDJunctionNetwork::node_tester(LSDFlowInfo& FlowInfo, int input_junction)
   basin_outlet = StreamLinkVector.get_node_in_channel(n_nodes_in_channel-2);     
 
   //Get all cells upslope of a junction - eg every cell of the drainage basin of interest
-  vector<int> upslope_nodes = FlowInfo.get_upslope_nodes(basin_outlet);
+  LSDNodeView upslope_nodes = FlowInfo.get_upslope_node_view(basin_outlet);
 
   //loop over each cell in the basin and test for No Data values
-  for(vector<int>::iterator it = upslope_nodes.begin(); it != upslope_nodes.end(); ++it){
+  for(const int* it = upslope_nodes.begin(); it != upslope_nodes.end(); ++it){
 
     int i;
     int j;
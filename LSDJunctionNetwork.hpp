@@ -79,6 +79,7 @@ contains a number of analysis tools built around drainage networks.
 #include "LSDIndexChannel.hpp"
 #include "LSDChannel.hpp"
 #include "LSDStatsTools.hpp"
+#include "LSDTypedRaster.hpp"
 using namespace std;
 using namespace TNT;
 
@@ -161,6 +162,16 @@ class LSDJunctionNetwork
   /// @author SMM
   /// @date 01/09/12
 	LSDIndexRaster StreamOrderArray_to_BinaryNetwork_LSDIndexRaster();
+	/// @brief This sends the StreamOrderArray to a one byte per cell raster,
+	/// a quarter of the size of StreamOrderArray_to_LSDIndexRaster.
+  /// @return LSDByteRaster of StreamOrderArray.
+  /// @date 16/10/26
+	LSDByteRaster StreamOrderArray_to_LSDByteRaster();
+	/// @brief Turns the StreamOrderArray into a one bit per cell mask of the
+	/// channel network, where true is channel.
+  /// @return LSDMaskRaster of the channel network.
+  /// @date 16/10/26
+	LSDMaskRaster StreamOrderArray_to_BinaryNetwork_LSDMaskRaster();
 
 	// this gets the largest donor junction to the baselevel nodes so that you can
 	// automate basin selection (e.g. for use with chi analysis)
@@ -438,6 +449,19 @@ class LSDJunctionNetwork
                               int MinSegLength, float A_0, float m_over_n,
 											        LSDFlowInfo& FlowInfo, LSDRaster& FlowDistance, LSDRaster& ElevationRaster);
 
+  /// @brief As GetChannelHeadsChiMethodFromJunction, but takes the hilltop from a
+  /// table of farthest upslope nodes and chi from a table of chi, so that
+  /// neither is worked out again for each junction.
+  /// @param BaseLevelChi The table from LSDFlowInfo::calculate_base_level_chi,
+  /// which fixes A_0 and m over n.
+  /// @param FarthestUpslopeNodes The table from
+  /// LSDFlowInfo::calculate_farthest_upslope_nodes.
+  /// @date 16/10/26
+  int GetChannelHeadsChiMethodFromJunction(int JunctionNumber,
+                              int MinSegLength, vector<double>& BaseLevelChi,
+											        LSDFlowInfo& FlowInfo, vector<int>& FarthestUpslopeNodes,
+											        LSDRaster& ElevationRaster);
+
 
 
 	/// @brief This function returns all potential channel heads in a DEM. It looks for
@@ -445,6 +469,9 @@ class LSDJunctionNetwork
 	/// The basin order just determines how far downstream the algorithm looks for the 'fluvial'
 	/// section.
 	/// It returns a vector<int> of nodeindices where the channel heads are
+	///
+	/// The junctions are processed in parallel by OpenMP threads, whose number
+	/// is set with OMP_NUM_THREADS. The result is the same for any number of threads.
 	/// @return vector<int> a vector of node_indices of potential channel heads
   /// @author SMM
   /// @date 26/09/2013
@@ -456,6 +483,9 @@ class LSDJunctionNetwork
 	/// @brief This function returns all potential channel heads in a DEM. It looks for
   /// channel heads based on the outlet junctions of the valleys (which are identified by looking 
   /// for portions of the landscape with 10 or more nodes with a high curvature that are linked)
+  ///
+  /// The junctions are processed in parallel by OpenMP threads, whose number
+  /// is set with OMP_NUM_THREADS. The result is the same for any number of threads.
 	/// @param ValleyJunctions
 	/// @param MinSegLength
 	/// @param A_0
@@ -491,6 +521,15 @@ class LSDJunctionNetwork
                                       float A_0, float m_over_n, float bin_width, LSDFlowInfo& FlowInfo,
                                       LSDRaster& ElevationRaster);
 
+  /// @brief As above, with chi taken from a table made by
+  /// LSDFlowInfo::calculate_base_level_chi, which is quicker when many
+  /// junctions are analysed with the same A_0 and m over n.
+  /// @param BaseLevelChi The table of chi.
+  /// @date 16/10/26
+  Array2D<int> GetChannelHeadsChiMethodAllPixels(int JunctionNumber,
+                                      vector<double>& BaseLevelChi, float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster);
+
 
   /// @brief This function returns an integer vector with the node indexes of the furthest upstream
   /// pixels identified as being part of the channel using chi profiles.  It calculates the chi and
@@ -510,6 +549,15 @@ class LSDJunctionNetwork
   vector<int> GetSourceNodesChiMethodAllPixels(int JunctionNumber,
                                       float A_0, float m_over_n, float bin_width, LSDFlowInfo& FlowInfo,
                                       LSDRaster& ElevationRaster);
+
+  /// @brief As above, with chi taken from a table made by
+  /// LSDFlowInfo::calculate_base_level_chi, which is quicker when many
+  /// junctions are analysed with the same A_0 and m over n.
+  /// @param BaseLevelChi The table of chi.
+  /// @date 16/10/26
+  vector<int> GetSourceNodesChiMethodAllPixels(int JunctionNumber,
+                                      vector<double>& BaseLevelChi, float bin_width, LSDFlowInfo& FlowInfo,
+                                      LSDRaster& ElevationRaster);
                                       
   // channel head identification
 	/// @brief This function is used to predict channel head locations based on the method proposed by Pelletier (2013).
@@ -866,6 +914,17 @@ class LSDJunctionNetwork
 
 	private:
 	void create(vector<int> Sources, LSDFlowInfo& FlowInfo);
+
+	/// The binning and fitting of GetChannelHeadsChiMethodAllPixels, given the
+	/// chi of the nodes upslope of the junction.
+	Array2D<int> ChannelPixelsFromUpslopeChi(int JunctionNumber, vector<float>& upslope_chi,
+	                                    float bin_width, LSDFlowInfo& FlowInfo,
+	                                    LSDRaster& ElevationRaster);
+	/// The binning and fitting of GetSourceNodesChiMethodAllPixels, given the
+	/// chi of the nodes upslope of the junction.
+	vector<int> SourceNodesFromUpslopeChi(int JunctionNumber, vector<float>& upslope_chi,
+	                                    float bin_width, LSDFlowInfo& FlowInfo,
+	                                    LSDRaster& ElevationRaster);
 };
 
 #endif
@@ -85,9 +85,11 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <memory>
 #include <queue>
 #include <algorithm>
 #include <map>
+#include <limits>
 #include <math.h>
 #include <string.h>
 #include "TNT/tnt.h"
@@ -97,6 +99,8 @@
 #include "LSDStatsTools.hpp"
 #include "LSDIndexRaster.hpp"
 #include "LSDShapeTools.hpp"
+#include "LSDRasterWriteQueue.hpp"
+#include "LSDRasterTiles.hpp"
 using namespace std;
 using namespace TNT;
 using namespace JAMA;
@@ -137,6 +141,16 @@ void LSDRaster::create(string filename, string extension)
 	read_raster(filename,extension);
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a raster from a window of an infile
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::create(string filename, string extension, int first_row, int first_col,
+                       int window_rows, int window_cols)
+{
+	read_raster_window(filename,extension,first_row,first_col,window_rows,window_cols);
+}
+
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // this creates a raster filled with no data values
 // SMM 2012
@@ -151,19 +165,48 @@ void LSDRaster::create(int nrows, int ncols, float xmin, float ymin,
 	DataResolution = cellsize;
 	NoDataValue = ndv;
 
-	RasterData = data.copy();
-
-	if (RasterData.dim1() != NRows)
+	if (data.dim1() != NRows)
 	{
 		cout << "LSDRaster line 89 dimension of data is not the same as stated in NRows!" << endl;
 		exit(EXIT_FAILURE);
 	}
-	if (RasterData.dim2() != NCols)
+	if (data.dim2() != NCols)
 	{
 		cout << "LSDRaster line 94 dimension of data is not the same as stated in NRows!" << endl;
 		exit(EXIT_FAILURE);
 	}
 
+	// copy the data into storage of our own, which is in a scratch file
+	// if one has been set up in LSDRasterStorage
+	LSDStorageHandle storage;
+	Array2D<float> own_data = allocate_raster_array<float>(NRows,NCols,storage);
+	own_data.inject(data);
+	RasterData = own_data;
+	RasterDataStorage = storage;
+
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This returns a checksum of the raster. Two rasters with the same dimensions,
+// georeferencing, no data value and cells (bit for bit) have the same checksum,
+// so it can be used to tell whether results computed from a raster are stale.
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+unsigned long long LSDRaster::checksum() const
+{
+	unsigned long long Checksum = checksum_bytes(&NRows,sizeof(NRows));
+	Checksum = checksum_bytes(&NCols,sizeof(NCols),Checksum);
+	Checksum = checksum_bytes(&XMinimum,sizeof(XMinimum),Checksum);
+	Checksum = checksum_bytes(&YMinimum,sizeof(YMinimum),Checksum);
+	Checksum = checksum_bytes(&DataResolution,sizeof(DataResolution),Checksum);
+	Checksum = checksum_bytes(&NoDataValue,sizeof(NoDataValue),Checksum);
+
+	LSDRasterView<const float> zeta = get_RasterView();
+	for (int row = 0; row<NRows; row++)
+	{
+		Checksum = checksum_words(zeta.row(row),sizeof(float)*NCols,Checksum);
+	}
+	return Checksum;
 }
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -203,6 +246,8 @@ void LSDRaster::read_raster(string filename, string extension)
 			    >> str >> XMinimum >> str >> YMinimum
 		   		>> str >> DataResolution
 			    >> str >> NoDataValue;
+		long header_length = long(data_in.tellg());
+		data_in.close();
 
 		cout << "Loading asc file; NCols: " << NCols << " NRows: " << NRows << endl
 		     << "X minimum: " << XMinimum << " YMinimum: " << YMinimum << endl
@@ -210,20 +255,39 @@ void LSDRaster::read_raster(string filename, string extension)
 		     << NoDataValue << endl;
 
 		// this is the array into which data is fed
-		Array2D<float> data(NRows,NCols,NoDataValue);
-
-		// read the data
-		for (int i=0; i<NRows; ++i)
+		LSDStorageHandle storage;
+		Array2D<float> data = allocate_raster_array<float>(NRows,NCols,storage);
+		data = float(NoDataValue);
+
+		// read the data. The whole file is read in one go and the values are
+		// then parsed in parallel, see ParseAsciiValues in LSDShapeTools
+		vector<char> text;
+		if (header_length < 0 || !ReadTextFile(string_filename, text))
 		{
-			for (int j=0; j<NCols; ++j)
-			{
-				data_in >> data[i][j];
-			}
+			cout << "\nFATAL ERROR: unable to read " << string_filename << endl;
+			exit(EXIT_FAILURE);
+		}
+		long NCells = long(NRows)*long(NCols);
+		long NValuesRead = 0;
+		if (NCells > 0)
+		{
+			NValuesRead = ParseAsciiValues(&text[0]+header_length, &text[0]+text.size(),
+			                               data[0], NCells);
+		}
+		if (NValuesRead < 0)
+		{
+			cout << "\nFATAL ERROR: " << string_filename << " contains a value that is not a number" << endl;
+			exit(EXIT_FAILURE);
+		}
+		else if (NValuesRead < NCells)
+		{
+			cout << "WARNING: " << string_filename << " only holds " << NValuesRead << " of "
+			     << NCells << " values, the rest are set to NoData" << endl;
 		}
-		data_in.close();
 
 		// now update the objects raster data
-		RasterData = data.copy();
+		RasterData = data;
+		RasterDataStorage = storage;
 	}
 	else if (extension == "flt")
 	{
@@ -234,6 +298,7 @@ void LSDRaster::read_raster(string filename, string extension)
 		header_filename = filename+dot+header_extension;
 
 		ifstream ifs(header_filename.c_str());
+		bool swap_bytes = false;
 		if( ifs.fail() )
 		{
 			cout << "\nFATAL ERROR: the header file \"" << header_filename
@@ -247,6 +312,7 @@ void LSDRaster::read_raster(string filename, string extension)
 				>> str >> XMinimum >> str >> YMinimum
 				>> str >> DataResolution
 				>> str >> NoDataValue;
+			swap_bytes = HeaderNeedsByteSwap(ifs);
 		}
 		ifs.close();
 
@@ -255,42 +321,309 @@ void LSDRaster::read_raster(string filename, string extension)
 		     << "Data Resolution: " << DataResolution << " and No Data Value: "
 		     << NoDataValue << endl;
 
-		// this is the array into which data is fed
-		Array2D<float> data(NRows,NCols,NoDataValue);
-
-		// now read the DEM, using the binary stream option
-		ifstream ifs_data(string_filename.c_str(), ios::in | ios::binary);
-		if( ifs_data.fail() )
+		// this is the array into which data is fed. TNT stores the rows of an
+		// Array2D in one contiguous block, so the file is read straight into it
+		LSDStorageHandle storage;
+		Array2D<float> data = allocate_raster_array<float>(NRows,NCols,storage);
+		long NBytes = long(NRows)*long(NCols)*long(sizeof(float));
+		if (NBytes > 0 && !ReadBinaryBlock(string_filename, data[0], NBytes))
 		{
 			cout << "\nFATAL ERROR: the data file \"" << string_filename
-			     << "\" doesn't exist" << endl;
+			     << "\" doesn't exist or is smaller than its header states" << endl;
 			exit(EXIT_FAILURE);
 		}
-		else
+
+		// data written with the other byte order is swapped in one pass
+		if (swap_bytes && NBytes > 0)
+		{
+			cout << "Swapping the byte order of " << string_filename << endl;
+			ByteSwapWords(sizeof(float), long(NRows)*long(NCols), data[0]);
+		}
+
+		// now update the objects raster data. data is not used again so
+		// it is handed over rather than copied
+		RasterData = data;
+		RasterDataStorage = storage;
+	}
+	else if (extension == "lzt")
+	{
+		// a tiled, compressed raster. The header and tile index are in the
+		// same file as the data, see LSDRasterTiles
+		read_raster_header(filename, extension);
+
+		cout << "Loading lzt file; NCols: " << NCols << " NRows: " << NRows << endl
+			 << "X minimum: " << XMinimum << " YMinimum: " << YMinimum << endl
+		     << "Data Resolution: " << DataResolution << " and No Data Value: "
+		     << NoDataValue << endl;
+
+		LSDStorageHandle storage;
+		Array2D<float> data = allocate_raster_array<float>(NRows,NCols,storage);
+		if (NRows > 0 && NCols > 0)
+		{
+			read_tiled_window(string_filename, 0, 0, NRows, NCols, data[0]);
+		}
+
+		RasterData = data;
+		RasterDataStorage = storage;
+	}
+	else
+	{
+		cout << "You did not enter and approprate extension!" << endl
+				  << "You entered: " << extension << " options are .flt, .asc and .lzt" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+
+}
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This skips n_values whitespace separated values in an ascii stream without
+// parsing them. It works on the stream buffer directly since extracting and
+// converting every skipped value would cost as much as reading the whole file.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void skip_ascii_values(istream& data_in, long n_values)
+{
+	streambuf* buf = data_in.rdbuf();
+	bool in_value = false;
+	while (n_values > 0)
+	{
+		int c = buf->sbumpc();
+		if (c == EOF)
+		{
+			data_in.setstate(ios::eofbit);
+			return;
+		}
+		if (isspace(c))
 		{
-			float temp;
-			for (int i=0; i<NRows; ++i)
+			if (in_value)
 			{
-				for (int j=0; j<NCols; ++j)
-				{
-					ifs_data.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-					data[i][j] = float(temp);
-				}
+				in_value = false;
+				--n_values;
 			}
 		}
-		ifs_data.close();
+		else
+		{
+			in_value = true;
+		}
+	}
+}
 
-		// now update the objects raster data
-		RasterData = data.copy();
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_raster_header
+// This reads the dimensions and georeferencing of a raster without its data.
+// It returns true if the data of a .flt file are in the other byte order.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool LSDRaster::read_raster_header(string filename, string extension)
+{
+	string header_filename;
+	string dot = ".";
+	if (extension == "asc")
+	{
+		header_filename = filename+dot+extension;
+	}
+	else if (extension == "flt")
+	{
+		header_filename = filename+dot+"hdr";
+	}
+	else if (extension == "lzt")
+	{
+		// the header of a tiled raster is at the start of the data file
+		LSDTiledRasterInfo info;
+		string error = read_tiled_raster_info(filename+dot+extension, info);
+		if (!error.empty())
+		{
+			cout << "\nFATAL ERROR: " << error << endl;
+			exit(EXIT_FAILURE);
+		}
+		NRows = info.NRows;
+		NCols = info.NCols;
+		XMinimum = info.XMinimum;
+		YMinimum = info.YMinimum;
+		DataResolution = info.DataResolution;
+		NoDataValue = info.NoDataValue;
+		return false;
 	}
 	else
 	{
 		cout << "You did not enter and approprate extension!" << endl
-				  << "You entered: " << extension << " options are .flt and .asc" << endl;
+				  << "You entered: " << extension << " options are .flt, .asc and .lzt" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	ifstream ifs(header_filename.c_str());
+	if( ifs.fail() )
+	{
+		cout << "\nFATAL ERROR: the header file \"" << header_filename
+			 << "\" doesn't exist" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	string str;
+	ifs >> str >> NCols >> str >> NRows
+		>> str >> XMinimum >> str >> YMinimum
+		>> str >> DataResolution
+		>> str >> NoDataValue;
+	bool swap_bytes = (extension == "flt") && HeaderNeedsByteSwap(ifs);
+	ifs.close();
+	return swap_bytes;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_tiled_window
+// This reads a window out of a tiled raster (.lzt) file into Buffer, which
+// has window_cols values per row. Only the tiles that overlap the window are
+// read and decompressed, see LSDRasterTiles.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::read_tiled_window(string string_filename, int first_row, int first_col,
+                                  int window_rows, int window_cols, float* Buffer)
+{
+	LSDTiledRasterInfo info;
+	string error = read_tiled_raster_info(string_filename, info);
+	if (error.empty())
+	{
+		error = read_tiled_raster_window(string_filename, info, first_row, first_col,
+		                                 window_rows, window_cols, Buffer);
+	}
+	if (!error.empty())
+	{
+		cout << "\nFATAL ERROR: " << error << endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_raster_window
+// This reads window_rows by window_cols cells, starting at first_row and
+// first_col, out of a raster file. Row 0 is the northern edge of the raster.
+// Only the window is read: a .flt file is read one window row at a time with
+// a seek in between, in an .asc file everything before the first row of
+// the window is skipped rather than parsed, and reading stops at its last row,
+// and in an .lzt file only the tiles that overlap the window are decompressed.
+//
+// The georeferencing is shifted so the window sits where it did in the file.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::read_raster_window(string filename, string extension, int first_row,
+                                   int first_col, int window_rows, int window_cols)
+{
+	string string_filename;
+	string dot = ".";
+	string_filename = filename+dot+extension;
+	cout << "The filename is " << string_filename << endl;
+
+	bool swap_bytes = read_raster_header(filename, extension);
+	int file_rows = NRows;
+	int file_cols = NCols;
+
+	if (first_row < 0 || first_col < 0 || window_rows < 1 || window_cols < 1 ||
+	    first_row+window_rows > file_rows || first_col+window_cols > file_cols)
+	{
+		cout << "\nFATAL ERROR: the window of " << window_rows << " rows and " << window_cols
+		     << " columns starting at row " << first_row << " and column " << first_col
+		     << " does not fit in " << string_filename << ", which has " << file_rows
+		     << " rows and " << file_cols << " columns" << endl;
 		exit(EXIT_FAILURE);
 	}
 
+	cout << "Loading window of " << window_rows << " rows and " << window_cols
+	     << " columns, starting at row " << first_row << " and column " << first_col << endl;
+
+	// this is the array into which data is fed
+	LSDStorageHandle storage;
+	Array2D<float> data = allocate_raster_array<float>(window_rows,window_cols,storage);
+
+	if (extension == "asc")
+	{
+		ifstream data_in(string_filename.c_str());
+		data = float(NoDataValue);
+
+		// skip the 6 header lines, each a name and a value, then the
+		// rows above the window
+		skip_ascii_values(data_in, 12);
+		skip_ascii_values(data_in, long(first_row)*long(file_cols));
+		for (int i=0; i<window_rows; ++i)
+		{
+			skip_ascii_values(data_in, first_col);
+			for (int j=0; j<window_cols; ++j)
+			{
+				data_in >> data[i][j];
+			}
+			skip_ascii_values(data_in, file_cols-first_col-window_cols);
+		}
+		data_in.close();
+	}
+	else if (extension == "lzt")
+	{
+		read_tiled_window(string_filename, first_row, first_col,
+		                  window_rows, window_cols, data[0]);
+	}
+	else
+	{
+		if (!ReadBinaryWindow(string_filename, data[0], first_row, first_col,
+		                      window_rows, window_cols, file_cols, sizeof(float)))
+		{
+			cout << "\nFATAL ERROR: the data file \"" << string_filename
+			     << "\" doesn't exist or is smaller than its header states" << endl;
+			exit(EXIT_FAILURE);
+		}
+		if (swap_bytes)
+		{
+			ByteSwapWords(sizeof(float), long(window_rows)*long(window_cols), data[0]);
+		}
+	}
+
+	// the rows below the window move the southern edge up
+	NRows = window_rows;
+	NCols = window_cols;
+	XMinimum += first_col*DataResolution;
+	YMinimum += (file_rows-first_row-window_rows)*DataResolution;
 
+	RasterData = data;
+	RasterDataStorage = storage;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_raster_bounding_box
+// This reads the cells of a raster file whose centres fall in a bounding box
+// given in map coordinates. The coordinates are turned into rows and columns
+// the same way as in LSDFlowInfo::get_node_index_of_coordinate_point, the
+// box is clipped to the raster, and the window is read with read_raster_window.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::read_raster_bounding_box(string filename, string extension, float X_min,
+                                         float Y_min, float X_max, float Y_max)
+{
+	read_raster_header(filename, extension);
+
+	int first_col = int(round((X_min-XMinimum)/DataResolution));
+	int last_col = int(round((X_max-XMinimum)/DataResolution));
+	int first_row = (NRows-1) - int(round((Y_max-YMinimum)/DataResolution));
+	int last_row = (NRows-1) - int(round((Y_min-YMinimum)/DataResolution));
+
+	if (first_col < 0) first_col = 0;
+	if (first_row < 0) first_row = 0;
+	if (last_col > NCols-1) last_col = NCols-1;
+	if (last_row > NRows-1) last_row = NRows-1;
+
+	if (last_col < first_col || last_row < first_row)
+	{
+		cout << "\nFATAL ERROR: the bounding box " << X_min << " " << Y_min << " "
+		     << X_max << " " << Y_max << " does not overlap " << filename << "."
+		     << extension << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	read_raster_window(filename, extension, first_row, first_col,
+	                   last_row-first_row+1, last_col-first_col+1);
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -298,17 +631,56 @@ void LSDRaster::read_raster(string filename, string extension)
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // write_raster
 // this function writes a raster. One has to give the filename and extension
-// currently the options are for .asc and .flt files
+// currently the options are for .asc, .flt and .lzt files
 //
 // SMM 2012
 //
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void LSDRaster::write_raster(string filename, string extension)
+{
+	cout << "The filename is " << filename << "." << extension << endl;
+
+	string error = write_raster_file(filename, extension);
+	if (!error.empty())
+	{
+		cout << "\nFATAL ERROR: " << error << endl;
+		exit(EXIT_FAILURE);
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// write_raster_async
+// This queues a copy of the raster to be written by the background writer in
+// LSDRasterWriteQueue and returns straight away. The copy is made here, so the
+// raster can be changed or destroyed as soon as this returns. Errors are
+// reported by flush_raster_writes().
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::write_raster_async(string filename, string extension)
+{
+	cout << "Queueing " << filename << "." << extension << " for writing" << endl;
+
+	shared_ptr<LSDRaster> snapshot(new LSDRaster(NRows,NCols,XMinimum,YMinimum,
+	                                         DataResolution,NoDataValue,RasterData));
+	queue_raster_write(filename+"."+extension,
+	                   [snapshot, filename, extension]()
+	                   { return snapshot->write_raster_file(filename, extension); });
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// write_raster_file
+// This does the writing for write_raster and write_raster_async. Rather than
+// exiting it returns a description of what went wrong, or an empty string if
+// the raster was written, since it may be running on the background writer.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string LSDRaster::write_raster_file(string filename, string extension) const
 {
 	string string_filename;
 	string dot = ".";
 	string_filename = filename+dot+extension;
-	cout << "The filename is " << string_filename << endl;
 
 	// this first bit of logic is for the asc file.
 	if (extension == "asc")
@@ -318,8 +690,7 @@ void LSDRaster::write_raster(string filename, string extension)
 
 		if( data_out.fail() )
 		{
-			cout << "\nFATAL ERROR: unable to write to " << string_filename << endl;
-			exit(EXIT_FAILURE);
+			return "unable to write to "+string_filename;
 		}
 
 		data_out <<  "ncols         " << NCols
@@ -329,17 +700,16 @@ void LSDRaster::write_raster(string filename, string extension)
 				<< "\ncellsize      " << DataResolution
 				<< "\nNODATA_value  " << NoDataValue << endl;
 
-
-		for (int i=0; i<NRows; ++i)
+		// the rows are formatted in parallel, see WriteAsciiValues in LSDShapeTools
+		if (NRows > 0 && NCols > 0)
 		{
-			for (int j=0; j<NCols; ++j)
-			{
-				data_out << setprecision(6) << RasterData[i][j] << " ";
-			}
-			if (i != NRows-1) data_out << endl;
+			WriteAsciiValues(data_out, RasterData[0], NRows, NCols);
 		}
 		data_out.close();
-
+		if( data_out.fail() )
+		{
+			return "unable to write to "+string_filename;
+		}
 	}
 	else if (extension == "flt")
 	{
@@ -350,37 +720,54 @@ void LSDRaster::write_raster(string filename, string extension)
 		header_filename = filename+dot+header_extension;
 
 		ofstream header_ofs(header_filename.c_str());
-		string str;
 		header_ofs <<  "ncols         " << NCols
 			<< "\nnrows         " << NRows
 			<< "\nxllcorner     " << setprecision(14) << XMinimum
 			<< "\nyllcorner     " << setprecision(14) << YMinimum
 			<< "\ncellsize      " << DataResolution
 			<< "\nNODATA_value  " << NoDataValue
-			<< "\nbyteorder     LSBFIRST" << endl;
+			<< "\nbyteorder     " << SystemByteOrder() << endl;
 		header_ofs.close();
+		if( header_ofs.fail() )
+		{
+			return "unable to write to "+header_filename;
+		}
 
-		// now do the main data
+		// now do the main data. The rows of an Array2D are contiguous so
+		// the whole raster goes out in a single write
 		ofstream data_ofs(string_filename.c_str(), ios::out | ios::binary);
-		float temp;
-		for (int i=0; i<NRows; ++i)
+		if (NRows > 0 && NCols > 0)
 		{
-			for (int j=0; j<NCols; ++j)
-			{
-				temp = float(RasterData[i][j]);
-				data_ofs.write(reinterpret_cast<char *>(&temp),sizeof(temp));
-			}
+			data_ofs.write(reinterpret_cast<const char *>(RasterData[0]),
+			               streamsize(NRows)*streamsize(NCols)*streamsize(sizeof(float)));
 		}
 		data_ofs.close();
+		if( data_ofs.fail() )
+		{
+			return "unable to write to "+string_filename;
+		}
+	}
+	else if (extension == "lzt")
+	{
+		// a tiled, compressed raster, see LSDRasterTiles
+		LSDTiledRasterInfo info;
+		info.NRows = NRows;
+		info.NCols = NCols;
+		info.XMinimum = XMinimum;
+		info.YMinimum = YMinimum;
+		info.DataResolution = DataResolution;
+		info.NoDataValue = NoDataValue;
+		info.TileSize = LSDDefaultTileSize;
+		return write_tiled_raster(string_filename, info,
+		                          (NRows > 0 && NCols > 0) ? RasterData[0] : NULL);
 	}
 	else
 	{
-		cout << "You did not enter and approprate extension!" << endl
-				  << "You entered: " << extension << " options are .flt and .asc" << endl;
-		exit(EXIT_FAILURE);
+		return "You did not enter and approprate extension!\nYou entered: "+extension
+		       +" options are .flt, .asc and .lzt";
 	}
 
-
+	return "";
 }
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -755,39 +1142,42 @@ LSDRaster LSDRaster::hillshade(float altitude, float azimuth, float z_factor)
     if (azimuth_math >= 360.0) azimuth_math = azimuth_math - 360;
     float azimuth_rad = azimuth_math * PI /180.0;
 
+    //The shade is 255 * (cos(zenith)*cos(slope) +
+    //sin(zenith)*sin(slope)*cos(azimuth - aspect)), with
+    //slope = atan(z_factor*|grad z|) and aspect = atan2(dzdy, -dzdx). Writing
+    //the cosines and sines of slope and aspect in terms of dzdx and dzdy
+    //gives the same shade without any trig in the loop (the cases with dzdx
+    //zero come out of the same expression), so the loop vectorises
+    float cos_zenith = cos(zenith_rad);
+    float sin_zenith_x_zf = sin(zenith_rad) * z_factor;
+    float cos_azimuth = cos(azimuth_rad);
+    float sin_azimuth = sin(azimuth_rad);
+    float zf_squared = z_factor * z_factor;
+    float one_over_8dx = 1.0 / (8 * DataResolution);
+    float ndv = NoDataValue;
+
+    //the rows are read through views of the contiguous raster blocks, with the
+    //rows above and below the current one held in their own pointers
+    LSDRasterView<const float> zeta = make_raster_view(RasterData);
+    LSDRasterView<float> shade = make_raster_view(hillshade);
+
     //calculate hillshade value for every non nodata value in the input raster
     for (int i = 1; i < NRows-1; ++i){
+        const float* above = zeta.row(i-1);
+        const float* centre = zeta.row(i);
+        const float* below = zeta.row(i+1);
+        float* shade_row = shade.row(i);
         for (int j = 1; j < NCols-1; ++j){
-            float slope_rad = 0;
-            float aspect_rad = 0;
-            float dzdx = 0;
-            float dzdy = 0;
-
-            if (RasterData[i][j] != NoDataValue){
-                dzdx = ((RasterData[i][j+1] + 2*RasterData[i+1][j] + RasterData[i+1][j+1]) -
-                       (RasterData[i-1][j-1] + 2*RasterData[i-1][j] + RasterData[i-1][j+1]))
-                        / (8 * DataResolution);
-                dzdy = ((RasterData[i-1][j+1] + 2*RasterData[i][j+1] + RasterData[i+1][j+1]) -
-                       (RasterData[i-1][j-1] + 2*RasterData[i][j-1] + RasterData[i+1][j-1]))
-                       / (8 * DataResolution);
-
-                slope_rad = atan(z_factor * sqrt((dzdx*dzdx) + (dzdy*dzdy)));
-
-                if (dzdx != 0){
-                    aspect_rad = atan2(dzdy, (dzdx*-1));
-                    if (aspect_rad < 0) aspect_rad = 2*PI + aspect_rad;
-                }
-                else{
-                    if (dzdy > 0) aspect_rad = PI/2;
-                    else if (dzdy < 0) aspect_rad = 2 * PI - PI/2;
-                    else aspect_rad = aspect_rad;
-                }
-                hillshade[i][j] = 255.0 * ((cos(zenith_rad) * cos(slope_rad)) +
-                                  (sin(zenith_rad) * sin(slope_rad) *
-                                  cos(azimuth_rad - aspect_rad)));
-
-                if (hillshade[i][j] < 0) hillshade[i][j] = 0;
-            }
+            float dzdx = ((centre[j+1] + 2*below[j] + below[j+1]) -
+                          (above[j-1] + 2*above[j] + above[j+1])) * one_over_8dx;
+            float dzdy = ((above[j+1] + 2*centre[j+1] + below[j+1]) -
+                          (above[j-1] + 2*centre[j-1] + below[j-1])) * one_over_8dx;
+
+            float value = 255.0f * (cos_zenith + sin_zenith_x_zf *
+                                    (dzdy*sin_azimuth - dzdx*cos_azimuth)) /
+                          sqrt(1.0f + zf_squared * (dzdx*dzdx + dzdy*dzdy));
+            value = (value < 0) ? 0 : value;
+            shade_row[j] = (centre[j] != ndv) ? value : ndv;
         }
     }
     //create LSDRaster hillshade object
@@ -1032,7 +1422,6 @@ vector<LSDRaster> LSDRaster::calculate_polyfit_surface_metrics(float window_radi
 	int kr = int(ceil(window_radius/DataResolution));  // Set radius of kernel
 	int kw=2*kr+1;                    						     // width of kernel
 
-	Array2D<float> data_kernel(kw,kw,NoDataValue);
 	Array2D<float> x_kernel(kw,kw,NoDataValue);
 	Array2D<float> y_kernel(kw,kw,NoDataValue);
 	Array2D<int> mask(kw,kw,0);
@@ -1056,7 +1445,7 @@ vector<LSDRaster> LSDRaster::calculate_polyfit_surface_metrics(float window_radi
   
 	// scale kernel window to resolution of DEM, and translate coordinates to be
 	// centred on cell of interest (the centre cell)
-	float x,y,zeta,radial_dist;
+	float x,y,radial_dist;
 	for(int i=0;i<kw;++i)
 	{
 	  for(int j=0;j<kw;++j)
@@ -1133,19 +1522,104 @@ vector<LSDRaster> LSDRaster::calculate_polyfit_surface_metrics(float window_radi
 		}
 	}
 
+	// A does not change from cell to cell, so it is decomposed once, and the
+	// factors are taken out so that each cell is solved exactly as
+	// LU::solve would, without any allocation
+	LU<float> sol_A(A);  // Create LU object
+	Array2D<float> L_A = sol_A.getL();
+	Array2D<float> U_A = sol_A.getU();
+	Array1D<int> piv_A = sol_A.getPivot();
+
+	// The cells under the mask, as offsets from the centre cell in the
+	// contiguous raster block, with their coordinates in the kernel. They are
+	// listed in the same order as the kernel is scanned so the sums below are
+	// added up in the same order as when the kernel was copied out cell by cell
+	LSDRasterView<const float> zeta_view = make_raster_view(RasterData);
+	vector<long> mask_offsets;
+	vector<float> mask_x, mask_y;
+	for (int krow=0; krow<kw; ++krow)
+	{
+		for (int kcol=0; kcol<kw; ++kcol)
+		{
+			if (mask[krow][kcol] == 1)
+			{
+				mask_offsets.push_back(long(krow-kr)*zeta_view.Stride + (kcol-kr));
+				mask_x.push_back(x_kernel[krow][kcol]);
+				mask_y.push_back(y_kernel[krow][kcol]);
+			}
+		}
+	}
+	int n_mask = int(mask_offsets.size());
+
+	// The number of nodata values above and to the left of each cell, so that
+	// the nodata values in a window are counted without going over it
+	int NCols1 = NCols+1;
+	vector<int> ndv_count(size_t(NRows+1)*size_t(NCols1),0);
+	for(int i=0;i<NRows;++i)
+	{
+		const float* zeta_row = zeta_view.row(i);
+		for(int j=0;j<NCols;++j)
+		{
+			ndv_count[size_t(i+1)*NCols1+j+1] = ndv_count[size_t(i)*NCols1+j+1]
+			                                  + ndv_count[size_t(i+1)*NCols1+j]
+			                                  - ndv_count[size_t(i)*NCols1+j]
+			                                  + ((zeta_row[j]==NoDataValue) ? 1 : 0);
+		}
+	}
+
+	// The vector bb of every cell in a row, added up one kernel cell at a time
+	// along the whole row
+	vector<float> bb_row(6*size_t(NCols),0.0);
+	float* bb0 = &bb_row[0];
+	float* bb1 = bb0+NCols;
+	float* bb2 = bb1+NCols;
+	float* bb3 = bb2+NCols;
+	float* bb4 = bb3+NCols;
+	float* bb5 = bb4+NCols;
+
 	// Move window over DEM, fitting 2nd order polynomial surface to the
 	// elevations within the window.
 	cout << "\n\tRunning 2nd order polynomial fitting" << endl;
 	cout << "\t\tDEM size = " << NRows << " x " << NCols << endl;
-	int ndv_present = 0;
 
 	for(int i=0;i<NRows;++i)
 	{
 		cout << "\tRow = " << i+1 << " / " << NRows << "    \r";
+		if ((i-kr >= 0) && (i+kr+1 <= NRows))
+		{
+			for (int j=kr; j<NCols-kr; ++j)
+			{
+				bb0[j] = bb1[j] = bb2[j] = bb3[j] = bb4[j] = bb5[j] = 0.0;
+			}
+			int j_end = NCols-kr;
+			for (int k=0; k<n_mask; ++k)
+			{
+				const float* window = zeta_view.row(i)+mask_offsets[k];
+				const float kx = mask_x[k];
+				const float ky = mask_y[k];
+				// Generate vector bb, three sums at a time so that the
+				// compiler can check the rows for overlap and vectorise
+				for (int j=kr; j<j_end; ++j)
+				{
+					float z = window[j];
+					bb0[j] += z*kx*kx;
+					bb1[j] += z*ky*ky;
+					bb2[j] += z*kx*ky;
+				}
+				for (int j=kr; j<j_end; ++j)
+				{
+					float z = window[j];
+					bb3[j] += z*kx;
+					bb4[j] += z*ky;
+					bb5[j] += z;
+				}
+			}
+		}
+
 		for(int j=0;j<NCols;++j)
 		{
 			// Avoid edges
-			if((i-kr < 0) || (i+kr+1 > NRows) || (j-kr < 0) || (j+kr+1 > NCols) || RasterData[i][j]==NoDataValue)
+			if((i-kr < 0) || (i+kr+1 > NRows) || (j-kr < 0) || (j+kr+1 > NCols) || zeta_view(i,j)==NoDataValue)
 			{
         if(raster_selection[0]==1)  elevation_raster[i][j] = NoDataValue;
         if(raster_selection[1]==1)  slope_raster[i][j] = NoDataValue;
@@ -1158,50 +1632,38 @@ vector<LSDRaster> LSDRaster::calculate_polyfit_surface_metrics(float window_radi
 			}
 			else
 			{
-				// clip DEM
-				//zeta_sampler=zeta.copy();
-				for(int i_kernel=0;i_kernel<kw;++i_kernel)
+				// check for nodata values anywhere in the window
+				int ndv_present = ndv_count[size_t(i+kr+1)*NCols1+j+kr+1]
+				                - ndv_count[size_t(i-kr)*NCols1+j+kr+1]
+				                - ndv_count[size_t(i+kr+1)*NCols1+j-kr]
+				                + ndv_count[size_t(i-kr)*NCols1+j-kr];
+				// Fit polynomial surface, avoiding nodata values          ==================> Could change this, as can fit polynomial surface as long as there are 6 data points.
+				if(ndv_present == 0)  // test for nodata values within the selection
 				{
-			  	for(int j_kernel=0;j_kernel<kw;++j_kernel)
-			  	{
-						data_kernel[i_kernel][j_kernel] =
-									RasterData[i-kr+i_kernel][j-kr+j_kernel];
-						// check for nodata values nearby
-						if(data_kernel[i_kernel][j_kernel]==NoDataValue)
+					float bb[6] = {bb0[j], bb1[j], bb2[j], bb3[j], bb4[j], bb5[j]};
+					float coeffs[6];
+					// Solve matrix equations using the LU decomposition of A from the
+					// TNT JAMA package:
+          // A.coefs = b, where coefs is the coefficients vector.
+					for (int r=0; r<6; ++r)
+					{
+						coeffs[r] = bb[piv_A[r]];
+					}
+					for (int r=0; r<6; ++r)
+					{
+						for (int r2=r+1; r2<6; ++r2)
 						{
-							ndv_present=1;
+							coeffs[r2] -= coeffs[r]*L_A[r2][r];
 						}
-			  	}
-				}
-				// Fit polynomial surface, avoiding nodata values          ==================> Could change this, as can fit polynomial surface as long as there are 6 data points.
-				if(ndv_present == 0)  // test for nodata values within the selection
-				{
-					Array1D<float> bb(6,0.0);
-					Array1D<float> coeffs(6);
-					for (int krow=0; krow<kw; ++krow)
+					}
+					for (int r=5; r>=0; --r)
 					{
-						for (int kcol=0; kcol<kw; ++kcol)
+						coeffs[r] /= U_A[r][r];
+						for (int r2=0; r2<r; ++r2)
 						{
-							if (mask[krow][kcol] == 1)
-              {
-                x = x_kernel[krow][kcol];
-					      y = y_kernel[krow][kcol];
-					      zeta = data_kernel[krow][kcol];
-					      // Generate vector bb
-					      bb[0] += zeta*x*x;
-					      bb[1] += zeta*y*y;
-					      bb[2] += zeta*x*y;
-					      bb[3] += zeta*x;
-					      bb[4] += zeta*y;
-					      bb[5] += zeta;
-					    }		// end mask
-            }			// end kernal column
-					}				// end kernal row
-					// Solve matrix equations using LU decomposition using the TNT JAMA
-					// package:
-          // A.coefs = b, where coefs is the coefficients vector.
-					LU<float> sol_A(A);  // Create LU object
-					coeffs = sol_A.solve(bb);
+							coeffs[r2] -= coeffs[r]*U_A[r2][r];
+						}
+					}
 
 			  	float a=coeffs[0];
 			  	float b=coeffs[1];
@@ -1275,7 +1737,6 @@ vector<LSDRaster> LSDRaster::calculate_polyfit_surface_metrics(float window_radi
             }
           }	
 				}					// end if statement for no data value
-				ndv_present = 0;
 			}
 		}
 	}
@@ -3055,8 +3516,7 @@ void LSDRaster::calculate_roughness_rasters(float window_radius, float roughness
 //---------------------------------------------------------------------------------
 //
 //This function fills pits/sinks in a DEM by incrementing elevations for cells with
-//no downslope neighbour. The process is repeated adnausium until no cells require
-//incrementing.
+//no downslope neighbour, until no cells require incrementing.
 //
 //Inputs required are a DEM file in ascii raster format as created by ARCMap
 //and a file name to create a filled DEM grid.
@@ -3092,39 +3552,22 @@ void LSDRaster::calculate_roughness_rasters(float window_radius, float roughness
 // Martin Hurst, June 2010
 //
 //---------------------------------------------------------------------------------
+//
+// v2.0 the recursive fill_iterator overflowed the stack on big flat pits and
+// visited cells over and over. The cells are now raised by the Priority-Flood
+// engine behind fill(MinSlope): each raised cell ends up one fill increment (1mm)
+// above the neighbour it drains to, and every cell is visited once.
+//
+// 16/10/26
+//
+//---------------------------------------------------------------------------------
 LSDRaster LSDRaster::fill()
 {
+	float fill_increment = 0.001;
 
 	Array2D<float> FilledRasterData;
 	FilledRasterData = RasterData.copy();
-	cout << "N_rows is: " << NRows << " " << NCols << endl;
-	cout << "Data rows: " << RasterData.dim1() << " cols: " << RasterData.dim2() << endl;
-	for (int i=1; i<NRows-1; i++)
-	{
-		cout << "\rRow = " << i+1 << " / " << NRows << "    ";
-		for (int j=1; j<NCols-1; j++)
-		{
-			//cout << "R: " << i << " C: " << j;
-			//cout << " FDR: " << FilledRasterData[i][j];
-			if (FilledRasterData[i][j] == NoDataValue || FilledRasterData[i-1][j-1] == NoDataValue
-			         || FilledRasterData[i-1][j] == NoDataValue || FilledRasterData[i-1][j+1] == NoDataValue
-			         || FilledRasterData[i][j+1] == NoDataValue || FilledRasterData[i+1][j+1] == NoDataValue
-			         || FilledRasterData[i+1][j] == NoDataValue || FilledRasterData[i+1][j-1] == NoDataValue
-			         || FilledRasterData[i][j-1] == NoDataValue)
-			{ }
-			else fill_iterator(FilledRasterData,i,j);
-
-			//if (RasterData[i][j] == NoDataValue || RasterData[i-1][j-1] == NoDataValue
-			//         || RasterData[i-1][j] == NoDataValue || RasterData[i-1][j+1] == NoDataValue
-			//         || RasterData[i][j+1] == NoDataValue || RasterData[i+1][j+1] == NoDataValue
-			//         || RasterData[i+1][j] == NoDataValue || RasterData[i+1][j-1] == NoDataValue
-			//         || RasterData[i][j-1] == NoDataValue)
-			//{ }
-			//else fill_iterator(RasterData,i,j);
-			//cout << " itercomplete" << endl;
-		}
-	}
-	cout << endl;
+	priority_flood(FilledRasterData,fill_increment,fill_increment);
 
 	LSDRaster FilledDEM(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FilledRasterData);
 	return FilledDEM;
@@ -3135,62 +3578,197 @@ LSDRaster LSDRaster::fill()
 
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Turns an elevation into an unsigned key in the same order, and back.
+//
+// 16/10/26
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-// this is a recursive algorithm that is called by the fill function
+static inline unsigned int fill_key(float Zeta)
+{
+	unsigned int bits;
+	memcpy(&bits,&Zeta,sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+static inline float fill_zeta(unsigned int Key)
+{
+	unsigned int bits = (Key & 0x80000000u) ? (Key & 0x7fffffffu) : ~Key;
+	float Zeta;
+	memcpy(&Zeta,&bits,sizeof(Zeta));
+	return Zeta;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The queues of a Priority-Flood.
+//
+// A Priority-Flood never queues a cell below the cell it has just taken off,
+// and that lets the priority queue be a radix heap. The elevations are queued
+// as keys in the same order (fill_key), and bucket b of the heap holds the
+// keys whose highest bit that differs from the last key taken off is bit b-1;
+// bucket 0 holds the keys equal to it. A push is a push_back onto a bucket,
+// and a bucket is only sorted out, by moving its keys down to lower buckets,
+// once the lowest key is in it or a key taken off a pit queue shares its bits.
+//
+// Cells raised inside a depression do not need the heap. They wait in plain
+// queues, one for each rise (or one if the rises are equal): cells come off
+// in order of elevation and each of these queues adds the same rise to them,
+// so they are in order of elevation too. The lowest cell is at the front of
+// one of the pit queues or of the heap; raised cells are taken first on a tie.
+//
+// The cells are queued by their flat index, so the raster can have at most
+// 2^32 cells.
 //
-// MDH, 2012
+// Radix heap of Ahuja et al. (1990), Journal of the ACM 37(2), 213-223.
 //
+// 16/10/26
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-void LSDRaster::fill_iterator(Array2D<float>& fill_data, int i, int j)
+class FillQueue
 {
-	int a=i;
-	int b=j;
-	float fill_increment = 0.001;
-	float min_zeta;
-	float centre_zeta = fill_data[a][b];
-
-	if (a==0 || b==0 || a == NRows-1 || b==NCols-1)
-	{ }
-	else if (fill_data[a][b] == NoDataValue || fill_data[a-1][b-1] == NoDataValue
-			 || fill_data[a-1][b] == NoDataValue
-	         || fill_data[a-1][b+1] == NoDataValue || fill_data[a][b+1] == NoDataValue
-			 || fill_data[a+1][b+1] == NoDataValue || fill_data[a+1][b] == NoDataValue
-			 || fill_data[a+1][b-1] == NoDataValue || fill_data[a][b-1] == NoDataValue)
-	{}
-	else
+  public:
+	/// @param NCells The number of cells in the raster.
+	/// @param NPitQueues 1 if cells are raised by the same rise from every
+	/// neighbour, 2 if the cardinal and diagonal rises differ.
+	FillQueue(long NCells, int NPitQueues)
+	{
+		if (NCells > 0xffffffffL)
+		{
+			cout << "FillQueue: a raster with " << NCells << " cells is too big to fill" << endl;
+			exit(EXIT_FAILURE);
+		}
+		NPits = NPitQueues;
+		PitHead[0] = PitHead[1] = 0;
+		Last = 0;
+		HeapSize = 0;
+		Filled = 0;
+		for (int b = 0; b<33; ++b)
+		{
+			BucketMin[b] = 0xffffffffu;
+		}
+	}
+
+	bool empty() const
+	{
+		return (HeapSize == 0 && PitHead[0] == Pits[0].size() && PitHead[1] == Pits[1].size());
+	}
+
+	/// @brief Queues a cell that keeps its elevation.
+	void push(float Zeta, long Node)
+	{
+		FillEntry Entry = {fill_key(Zeta), (unsigned int)(Node)};
+		add(Entry);
+		++HeapSize;
+	}
+
+	/// @brief Queues a raised cell on pit queue 0 or 1.
+	void push_pit(float Zeta, long Node, int PitQueue)
+	{
+		FillEntry Entry = {fill_key(Zeta), (unsigned int)(Node)};
+		Pits[PitQueue].push_back(Entry);
+	}
+
+	/// @brief Takes the lowest cell off the queues.
+	/// @return true if it came off a pit queue.
+	bool pop(float& Zeta, long& Node)
 	{
-		min_zeta = centre_zeta + 10;
-		if (fill_data[a-1][b-1] < min_zeta) min_zeta = fill_data[a-1][b-1];
-		if (fill_data[a-1][b] < min_zeta) min_zeta = fill_data[a-1][b];
-		if (fill_data[a-1][b+1] < min_zeta) min_zeta = fill_data[a-1][b+1];
-		if (fill_data[a][b+1] < min_zeta) min_zeta = fill_data[a][b+1];
-		if (fill_data[a+1][b+1] < min_zeta) min_zeta = fill_data[a+1][b+1];
-		if (fill_data[a+1][b] < min_zeta) min_zeta = fill_data[a+1][b];
-		if (fill_data[a+1][b-1] < min_zeta) min_zeta = fill_data[a+1][b-1];
-		if (fill_data[a][b-1] < min_zeta) min_zeta = fill_data[a][b-1];
-
-		//increase elevation of centre cell if it is lower than or
-		//equal in elevation compared to all adjacent cells
-		if (centre_zeta <= min_zeta)
+		int p = (NPits == 2 && PitHead[1] < Pits[1].size() &&
+		         (PitHead[0] == Pits[0].size() ||
+		          Pits[1][PitHead[1]].Key < Pits[0][PitHead[0]].Key)) ? 1 : 0;
+		bool pit = (PitHead[p] < Pits[p].size());
+		unsigned int heap_key = (HeapSize > 0) ? lowest_heap_key() : 0;
+		if (HeapSize > 0 && (!pit || heap_key < Pits[p][PitHead[p]].Key))
 		{
+			advance(heap_key);
+			FillEntry Entry = Buckets[0].back();
+			Buckets[0].pop_back();
+			if (Buckets[0].empty())
+			{
+				Filled &= ~1ULL;
+			}
+			--HeapSize;
+			Zeta = fill_zeta(Entry.Key);
+			Node = Entry.Node;
+			return false;
+		}
 
-      		// efficiency improvement by Dave Milodowski
-      		float zeta_diff = min_zeta - centre_zeta;
-      		fill_data[a][b] = fill_data[a][b] + zeta_diff + fill_increment;
-			//fill adjacent pixels too
-			fill_iterator(fill_data,a-1,b-1);
-			fill_iterator(fill_data,a-1,b);
-			fill_iterator(fill_data,a-1,b+1);
-			fill_iterator(fill_data,a,b+1);
-			fill_iterator(fill_data,a+1,b+1);
-			fill_iterator(fill_data,a+1,b);
-			fill_iterator(fill_data,a+1,b-1);
-			fill_iterator(fill_data,a,b-1);
+		FillEntry Entry = Pits[p][PitHead[p]++];
+		if (PitHead[p] == Pits[p].size())
+		{
+			Pits[p].clear();
+			PitHead[p] = 0;
 		}
+		else if (PitHead[p] >= 65536 && 2*PitHead[p] >= Pits[p].size())
+		{
+			//let go of the front of a long queue
+			Pits[p].erase(Pits[p].begin(),Pits[p].begin()+PitHead[p]);
+			PitHead[p] = 0;
+		}
+		advance(Entry.Key);
+		Zeta = fill_zeta(Entry.Key);
+		Node = Entry.Node;
+		return true;
 	}
-}
-//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+  private:
+	struct FillEntry
+	{
+		unsigned int Key;
+		unsigned int Node;
+	};
+
+	int bucket(unsigned int Key) const
+	{
+		return (Key == Last) ? 0 : 32-__builtin_clz(Key ^ Last);
+	}
+
+	void add(const FillEntry& Entry)
+	{
+		int b = bucket(Entry.Key);
+		Buckets[b].push_back(Entry);
+		BucketMin[b] = min(BucketMin[b],Entry.Key);
+		Filled |= 1ULL << b;
+	}
+
+	unsigned int lowest_heap_key() const
+	{
+		int b = __builtin_ctzll(Filled);
+		return (b == 0) ? Last : BucketMin[b];
+	}
+
+	/// @brief Makes Key, which is no higher than any key in the heap, the last
+	/// key taken off. Only the bucket that shares its highest differing bit
+	/// with Key has keys that move, and they all move down.
+	void advance(unsigned int Key)
+	{
+		if (Key == Last)
+		{
+			return;
+		}
+		int b = bucket(Key);
+		Last = Key;
+		if (Buckets[b].empty())
+		{
+			return;
+		}
+		Moving.swap(Buckets[b]);
+		BucketMin[b] = 0xffffffffu;
+		Filled &= ~(1ULL << b);
+		for (size_t i = 0; i<Moving.size(); ++i)
+		{
+			add(Moving[i]);
+		}
+		Moving.clear();
+	}
+
+	vector<FillEntry> Buckets[33];
+	unsigned int BucketMin[33];
+	/// bit b is set if bucket b is not empty
+	unsigned long long Filled;
+	vector<FillEntry> Moving;
+	vector<FillEntry> Pits[2];
+	size_t PitHead[2];
+	int NPits;
+	unsigned int Last;
+	size_t HeapSize;
+};
 
 
 //---------------------------------------------------------------------------------------
@@ -3211,33 +3789,19 @@ void LSDRaster::fill_iterator(Array2D<float>& fill_data, int i, int j)
 //
 //	Martin Hurst, 12/3/13 */
 //
-//	Declare the node structure
-///@brief Used in pit filling to store elevation data and row and colum indexes.
-//	Method taken from Wang and Liu (2006), Int. J. of GIS. 20(2), 193-213
-//	Method taken from Wang and Liu (2006), Int. J. of GIS. 20(2), 193-213
-struct FillNode
-{
-  /// @brief Elevation data.
-	float Zeta;
-	/// @brief Row index value.
-  int RowIndex;
-	/// @brief Column index value.
-  int ColIndex;
-};
-
-//Overload the less than and greater than operators to consider Zeta data only
-//N.B. Fill only needs greater than but less than useful for mdflow routing
-//(I've coded this but not yet added to LSDRaster, it's only faster than presorting
-//when applied to pretty large datasets).
-bool operator>( const FillNode& lhs, const FillNode& rhs )
-{
-	return lhs.Zeta > rhs.Zeta;
-}
-bool operator<( const FillNode& lhs, const FillNode& rhs )
-{
-	return lhs.Zeta < rhs.Zeta;
-}
-
+//	Cells that have to be raised are in a depression, and they are routed
+//	through plain FIFO queues, one for each of the two rises. Only cells that
+//	are higher than the cell they were reached from go through the priority
+//	queue, which is a radix heap (see FillQueue). As before, every raised cell
+//	ends up MinSlope (times the distance) above a neighbour it drains to, now
+//	always the one that gives it the lowest elevation, so the filled DEM does
+//	not depend on the order of cells of equal elevation.
+//	Improved Priority-Flood of Barnes et al. (2014), Computers & Geosciences
+//	62, 117-127.
+//
+//	16/10/26
+//
+//---------------------------------------------------------------------------------------
 LSDRaster LSDRaster::fill(float& MinSlope)
 {
 	//cout << "Inside NewFill" << endl;
@@ -3245,165 +3809,987 @@ LSDRaster LSDRaster::fill(float& MinSlope)
 	//declare 1/root(2)
 	float one_over_root2 = 0.707106781;
 
-	//Declare the priority Queue with greater than comparison
-	priority_queue< FillNode, vector<FillNode>, greater<FillNode> > PriorityQueue;
-	//Declare a temporary FillNode structure which we populate before adding to the PQ
-	//Declare a central node or node of interest
-	FillNode TempFillNode, CentreFillNode;
-
-	//declare vectors for slopes and row and col indices
-	vector<float> slopes(8,NoDataValue);
-	vector<int> row_kernal(8);
-	vector<int> col_kernal(8);
-
-	//Get Dimensions
-	//int NRows = Zeta.dim1();
-	//int NCols = Zeta.dim2();
-
-	//Index array to track whether nodes are in queue or have been processed
-	//-9999 = no_data, 0 = data but not processed or in queue,
-	//1 = in queue but not processed, 2 = fully processed and removed from queue
-	Array2D<int> FillIndex(NRows,NCols,NoDataValue);
+	//the rise to a cardinal and to a diagonal neighbour that is filled
+	float cardinal_rise = 0;
+	float diagonal_rise = 0;
+	if (MinSlope > 0)
+	{
+		cardinal_rise = MinSlope*DataResolution;
+		diagonal_rise = MinSlope*DataResolution*one_over_root2;
+	}
+
 	Array2D<float> FilledZeta;
 	FilledZeta = RasterData.copy();
+	priority_flood(FilledZeta,cardinal_rise,diagonal_rise);
+
+	LSDRaster FilledDEM(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FilledZeta);
+	return FilledDEM;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The Priority-Flood engine behind both fill functions. FilledZeta starts as a
+// copy of the raster data and is filled in place.
+//
+// A cell reached from a neighbour that is at least as high is raised to
+// cardinal_rise or diagonal_rise above that neighbour; a cell reached from a
+// lower neighbour keeps its elevation. The cells come off the queues in order
+// of elevation (see FillQueue), and a raised cell that is reached again while
+// it is still queued is lowered if that gives it a lower elevation, so each
+// cell ends up at the lowest elevation it can be given from any of its
+// neighbours. The filled DEM is then the lowest surface on which every cell
+// drains, whatever order cells of equal elevation are visited in, which is
+// what lets fill_tiled give exactly the same DEM. With both rises zero the
+// filled areas are flat.
+//
+// Only a raised cell can be lowered, since a cell in the heap is at its raw
+// elevation, and only if the two rises differ; so only then do the cells
+// taken off the pit queues have to be checked against their elevation.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::priority_flood(Array2D<float>& FilledZeta, float cardinal_rise, float diagonal_rise)
+{
+	//a cell reached with equal rises is queued at its lowest elevation, and
+	//the raised cells then all wait in the same pit queue
+	bool equal_rises = (cardinal_rise == diagonal_rise);
+	FillQueue Queue(long(NRows)*long(NCols), (equal_rises) ? 1 : 2);
+
+	//Index array to track whether nodes have been reached
+	//0 = data but not yet reached, 1 = reached (in a queue or processed),
+	//2 = no_data, 3 = raised and still in a pit queue, which is only used if
+	//the rises differ; EdgeCell is added for the cells on the edge of the array
+	const char EdgeCell = 4;
+	Array2D<char> FillIndex(NRows,NCols,char(0));
+
+	//All the arrays are worked on through flat indices into their contiguous
+	//blocks. The neighbours, in the order N, NE, E, SE, S, SW, W, NW, are a
+	//fixed distance from a cell; the even ones are the cardinal neighbours
+	LSDRasterView<float> zeta = make_raster_view(FilledZeta);
+	LSDRasterView<const float> raw = get_RasterView();
+	LSDRasterView<char> fill_index = make_raster_view(FillIndex);
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+	long neighbour_offsets[8];
+	for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+	{
+		neighbour_offsets[Neighbour] = row_offsets[Neighbour]*zeta.Stride + col_offsets[Neighbour];
+	}
 
 	//Collect boundary cells
 	for (int i=0; i<NRows; ++i)
 	{
 		for (int j=0; j<NCols; ++j)
 		{
-			if (FilledZeta[i][j] != NoDataValue)
+			long node = zeta.index(i,j);
+			bool on_edge = (i==0 || j==0 || i==NRows-1 || j==NCols-1);
+			if (on_edge)
+			{
+				fill_index[node] = EdgeCell;
+			}
+			if (zeta[node] == NoDataValue)
 			{
-				//If there is data the cell needs to be filled so
-				//set fill index to zero (i.e. yet to be filled)
-				FillIndex[i][j] = 0;
-
-				//If we're at the edge or next to an NoDataValue then
-				//put the cell into the priority queue
-				if (i==0 || j==0 || i==NRows-1 || j==NCols-1 ||
-					FilledZeta[i-1][j-1]==NoDataValue || FilledZeta[i-1][j]==NoDataValue ||
-					FilledZeta[i-1][j+1]==NoDataValue || FilledZeta[i][j-1]==NoDataValue ||
-					FilledZeta[i][j+1]==NoDataValue || FilledZeta[i+1][j-1]==NoDataValue ||
-					FilledZeta[i+1][j]==NoDataValue || FilledZeta[i+1][j+1]==NoDataValue)
+				fill_index[node] += 2;
+				continue;
+			}
+
+			//If we're at the edge or next to an NoDataValue then
+			//put the cell into the priority queue
+			bool on_boundary = on_edge;
+			for (int Neighbour = 0; Neighbour<8 && !on_boundary; ++Neighbour)
+			{
+				if (zeta[node+neighbour_offsets[Neighbour]] == NoDataValue)
 				{
-					TempFillNode.Zeta = FilledZeta[i][j];
-					TempFillNode.RowIndex = i;
-					TempFillNode.ColIndex = j;
-					PriorityQueue.push(TempFillNode);
-					FillIndex[i][j] = 1;
+					on_boundary = true;
 				}
 			}
+			if (on_boundary)
+			{
+				Queue.push(zeta[node],node);
+				fill_index[node] += 1;
+			}
 		}
 	}
 
-	//Loop through the priority queue from lowest to highest elevations
-	//filling as we go and adding unassessed neighbours to the priority queue
-	while (!PriorityQueue.empty())
+	//Loop through the queues from lowest to highest elevations
+	//filling as we go and adding neighbours that can be lowered to the queues
+	float centre_zeta;
+	long node;
+	while (!Queue.empty())
 	{
-		//first get the highest priority node and assign it before
-		//removing it from the queue and declaring it processed
-		CentreFillNode = PriorityQueue.top();
-		int row=CentreFillNode.RowIndex, col=CentreFillNode.ColIndex;
-		//cout << "Pop from Queue: Zeta = " << CentreFillNode.Zeta << endl;
-
-		PriorityQueue.pop();
-		FillIndex[row][col] = 2;
-
-		//get neighbour indices
-		//rows
-		row_kernal[0] = row-1;
-		row_kernal[1] = row-1;
-		row_kernal[2] = row;
-		row_kernal[3] = row+1;
-		row_kernal[4] = row+1;
-		row_kernal[5] = row+1;
-		row_kernal[6] = row;
-		row_kernal[7] = row-1;
-		//cols
-		col_kernal[0] = col;
-		col_kernal[1] = col+1;
-		col_kernal[2] = col+1;
-		col_kernal[3] = col+1;
-		col_kernal[4] = col;
-		col_kernal[5] = col-1;
-		col_kernal[6] = col-1;
-		col_kernal[7] = col-1;
-
-		//check if on array boundary and set kernal to NoDataValues to avoid
-		//segmentation fault
-		if (row == 0)
+		//first get the next node and remove it from its queue. A raised node
+		//that has been lowered since it was queued is queued again
+		bool pit = Queue.pop(centre_zeta,node);
+		if (pit && !equal_rises)
 		{
-			row_kernal[0] = NoDataValue;
-			row_kernal[1] = NoDataValue;
-			row_kernal[7] = NoDataValue;
+			if (centre_zeta != zeta[node])
+			{
+				continue;
+			}
+			fill_index[node] &= ~2;
 		}
-		else if (row==NRows-1)
+
+		//only the neighbours of cells on the array edge can fall off it
+		bool on_edge = ((fill_index[node] & EdgeCell) != 0);
+		int row = 1, col = 1;
+		if (on_edge)
 		{
-			row_kernal[3] = NoDataValue;
-			row_kernal[4] = NoDataValue;
-			row_kernal[5] = NoDataValue;
+			row = int(node/zeta.Stride);
+			col = int(node-row*zeta.Stride);
 		}
-		if (col == 0)
+
+		//loop through neighbours
+		for (int Neighbour = 0; Neighbour<8; ++Neighbour)
 		{
-			col_kernal[5] = NoDataValue;
-			col_kernal[6] = NoDataValue;
-			col_kernal[7] = NoDataValue;
+			if (on_edge && (row+row_offsets[Neighbour] < 0 || row+row_offsets[Neighbour] >= NRows ||
+			                col+col_offsets[Neighbour] < 0 || col+col_offsets[Neighbour] >= NCols))
+			{
+				continue;
+			}
+
+			//a neighbour that has been raised and is still queued is lowered
+			//if it can be; nothing else that has been reached can be lowered
+			long neighbour = node+neighbour_offsets[Neighbour];
+			int neighbour_index = fill_index[neighbour] & 3;
+			if (neighbour_index != 0 &&
+			    (neighbour_index != 3 || zeta[neighbour] <= centre_zeta))
+			{
+				continue;
+			}
+
+			//check if neighbour is equal/lower and therefore needs filling. A
+			//neighbour that has not been reached still holds its raw elevation
+			float neighbour_raw = (neighbour_index == 0) ? zeta[neighbour] : raw[neighbour];
+			bool raised = (neighbour_raw <= centre_zeta);
+			bool cardinal = (Neighbour%2 == 0);
+			float filled = (raised) ? centre_zeta + ((cardinal) ? cardinal_rise : diagonal_rise)
+			                        : neighbour_raw;
+
+			//If the neighbour has not been reached, or can be made lower
+			if (neighbour_index == 0 || filled < zeta[neighbour])
+			{
+				fill_index[neighbour] = (fill_index[neighbour] & EdgeCell) |
+				                        ((raised && !equal_rises) ? 3 : 1);
+				zeta[neighbour] = filled;
+
+				//a raised neighbour is in the depression and goes to a pit
+				//queue; a higher neighbour is added to the priority queue
+				if (!raised)
+				{
+					Queue.push(filled,neighbour);
+				}
+				else
+				{
+					Queue.push_pit(filled,neighbour,(cardinal || equal_rises) ? 0 : 1);
+				}
+			}
 		}
-		else if (col == NCols-1)
+	}
+}
+
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Fills one tile for fill_tiled.
+//
+// The tile is rows r0 to r1-1 and columns c0 to c1-1. It is filled as if it were a
+// DEM on its own whose outlets are all the cells on the tile perimeter, together
+// with the real outlets inside the tile (cells on the DEM edge or next to a
+// NoDataValue). Every cell gets the label of the outlet it was flooded from: 0 for
+// a real outlet, and a new label from 1 upwards for each tile perimeter cell.
+//
+// Where two cells with different labels meet, water in one label could spill
+// into the other at the higher of the two filled elevations. The lowest of these
+// spill elevations for each pair of labels is recorded in Spills.
+//
+// Other tiles are being filled at the same time, so zeta is only touched inside
+// this tile; the NoDataValues next to the tile are looked up in the raw DEM.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void fill_tile(LSDRasterView<const float> raw, LSDRasterView<float> zeta,
+                      LSDRasterView<int> labels, int NoDataValue,
+                      int r0, int r1, int c0, int c1,
+                      int& NLabels, map< pair<int,int>, float >& Spills)
+{
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+
+	FillQueue Queue(long(zeta.NRows)*long(zeta.NCols),1);
+
+	//Collect the outlets of the tile
+	NLabels = 0;
+	for (int i=r0; i<r1; ++i)
+	{
+		for (int j=c0; j<c1; ++j)
 		{
-			col_kernal[1] = NoDataValue;
-			col_kernal[2] = NoDataValue;
-			col_kernal[3] = NoDataValue;
+			long node = zeta.index(i,j);
+			if (zeta[node] == NoDataValue)
+			{
+				continue;
+			}
+
+			bool on_boundary = (i==0 || j==0 || i==zeta.NRows-1 || j==zeta.NCols-1);
+			for (int Neighbour = 0; Neighbour<8 && !on_boundary; ++Neighbour)
+			{
+				if (raw(i+row_offsets[Neighbour],j+col_offsets[Neighbour]) == NoDataValue)
+				{
+					on_boundary = true;
+				}
+			}
+			bool on_tile_edge = (i==r0 || j==c0 || i==r1-1 || j==c1-1);
+			if (on_boundary || on_tile_edge)
+			{
+				labels[node] = (on_boundary) ? 0 : ++NLabels;
+				Queue.push(zeta[node],node);
+			}
 		}
+	}
+
+	//Flood the tile from its outlets, exactly as fill does with a MinSlope of zero
+	float centre_zeta;
+	long node;
+	while (!Queue.empty())
+	{
+		Queue.pop(centre_zeta,node);
+		int row = int(node/zeta.Stride);
+		int col = int(node-row*zeta.Stride);
+		int label = labels[node];
 
-		//loop through neighbours
 		for (int Neighbour = 0; Neighbour<8; ++Neighbour)
 		{
-			//If the neighbour has data and is not already in the priority queue and has not been processed
-			if (	row_kernal[Neighbour] == NoDataValue || col_kernal[Neighbour] == NoDataValue ||
-					FillIndex[row_kernal[Neighbour]][col_kernal[Neighbour]] == 1 ||
-					FillIndex[row_kernal[Neighbour]][col_kernal[Neighbour]] == 2 ||
-					FillIndex[row_kernal[Neighbour]][col_kernal[Neighbour]] == NoDataValue ) {}
+			int neighbour_row = row+row_offsets[Neighbour];
+			int neighbour_col = col+col_offsets[Neighbour];
+			if (neighbour_row < r0 || neighbour_row >= r1 ||
+			    neighbour_col < c0 || neighbour_col >= c1)
+			{
+				continue;
+			}
+			long neighbour = zeta.index(neighbour_row,neighbour_col);
+			if (zeta[neighbour] == NoDataValue)
+			{
+				continue;
+			}
+
+			if (labels[neighbour] < 0)
+			{
+				//the neighbour is reached for the first time and takes this label
+				labels[neighbour] = label;
+				if (zeta[neighbour] <= centre_zeta)
+				{
+					zeta[neighbour] = centre_zeta;
+					Queue.push_pit(centre_zeta,neighbour,0);
+				}
+				else
+				{
+					Queue.push(zeta[neighbour],neighbour);
+				}
+			}
+			else if (labels[neighbour] != label)
+			{
+				//the neighbour already has its final elevation in this tile
+				pair<int,int> key(min(label,labels[neighbour]), max(label,labels[neighbour]));
+				float spill = max(centre_zeta, zeta[neighbour]);
+				map< pair<int,int>, float >::iterator it = Spills.find(key);
+				if (it == Spills.end())
+				{
+					Spills[key] = spill;
+				}
+				else if (spill < it->second)
+				{
+					it->second = spill;
+				}
+			}
+		}
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The flood of the epsilon fill of fill_tiled, inside rows r0 to r1-1 and
+// columns c0 to c1-1. Queue holds the cells to start from. Every cell taken off
+// it lowers its neighbours in the block as priority_flood does, and a cell is
+// queued again whenever it is lowered, so a cell in the queue that has been
+// lowered since it was queued is skipped. EdgeLowered is set if a cell on the
+// edge of the block is lowered.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void epsilon_flood(LSDRasterView<const float> raw, LSDRasterView<float> zeta,
+                          int NoDataValue, int r0, int r1, int c0, int c1,
+                          float cardinal_rise, float diagonal_rise,
+                          FillQueue& Queue, bool& EdgeLowered)
+{
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+	long neighbour_offsets[8];
+	for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+	{
+		neighbour_offsets[Neighbour] = row_offsets[Neighbour]*zeta.Stride + col_offsets[Neighbour];
+	}
+	bool equal_rises = (cardinal_rise == diagonal_rise);
+
+	float centre_zeta;
+	long node;
+	while (!Queue.empty())
+	{
+		Queue.pop(centre_zeta,node);
+		if (centre_zeta != zeta[node])
+		{
+			continue;
+		}
+
+		//only the neighbours of cells on the edge of the block can fall off it
+		//or be on its edge themselves
+		int row = int(node/zeta.Stride);
+		int col = int(node-row*zeta.Stride);
+		bool near_edge = (row <= r0+1 || row >= r1-2 || col <= c0+1 || col >= c1-2);
+
+		for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+		{
+			int neighbour_row = row+row_offsets[Neighbour];
+			int neighbour_col = col+col_offsets[Neighbour];
+			if (near_edge && (neighbour_row < r0 || neighbour_row >= r1 ||
+			                  neighbour_col < c0 || neighbour_col >= c1))
+			{
+				continue;
+			}
+			long neighbour = node+neighbour_offsets[Neighbour];
+			if (zeta[neighbour] <= centre_zeta || raw[neighbour] == NoDataValue)
+			{
+				continue;
+			}
+
+			bool raised = (raw[neighbour] <= centre_zeta);
+			float filled = (raised) ? centre_zeta
+			                          + ((Neighbour%2 == 0) ? cardinal_rise : diagonal_rise)
+			                        : raw[neighbour];
+			if (filled < zeta[neighbour])
+			{
+				zeta[neighbour] = filled;
+				if (!raised)
+				{
+					Queue.push(filled,neighbour);
+				}
+				else
+				{
+					Queue.push_pit(filled,neighbour,(Neighbour%2 == 0 || equal_rises) ? 0 : 1);
+				}
+				if (near_edge && (neighbour_row == r0 || neighbour_row == r1-1 ||
+				                  neighbour_col == c0 || neighbour_col == c1-1))
+				{
+					EdgeLowered = true;
+				}
+			}
+		}
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Floods one tile for the epsilon fill of fill_tiled.
+//
+// The tile is rows r0 to r1-1 and columns c0 to c1-1. Cells that have not been
+// reached yet hold numeric_limits<float>::max(). The tile is flooded as in
+// priority_flood, from every reached cell in the tile on its first pass
+// (FirstPass), and otherwise from the tile cells that can be lowered from the
+// cells just outside the tile. Cells are only written inside the tile, so
+// tiles that do not touch can be flooded at the same time. EdgeLowered is set
+// if a cell on the tile edge was lowered, in which case the neighbouring tiles
+// have to be flooded again.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void epsilon_fill_tile(LSDRasterView<const float> raw, LSDRasterView<float> zeta,
+                              int NoDataValue, int r0, int r1, int c0, int c1,
+                              float cardinal_rise, float diagonal_rise,
+                              bool FirstPass, bool& EdgeLowered)
+{
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+	const float unreached = numeric_limits<float>::max();
+	bool equal_rises = (cardinal_rise == diagonal_rise);
+
+	FillQueue Queue(long(zeta.NRows)*long(zeta.NCols), (equal_rises) ? 1 : 2);
+	EdgeLowered = false;
+
+	for (int i=r0; i<r1; ++i)
+	{
+		bool on_tile_row = (i==r0 || i==r1-1);
+		for (int j=c0; j<c1; ++j)
+		{
+			long node = zeta.index(i,j);
+			if (raw[node] == NoDataValue)
+			{
+				continue;
+			}
+
+			//on the first pass the reached cells are the outlets of the DEM
+			if (FirstPass && zeta[node] != unreached)
+			{
+				Queue.push(zeta[node],node);
+			}
+
+			//the cells on the tile edge are lowered from the cells outside
+			if (!on_tile_row && j != c0 && j != c1-1)
+			{
+				continue;
+			}
+			for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+			{
+				int ni = i+row_offsets[Neighbour];
+				int nj = j+col_offsets[Neighbour];
+				if (ni < 0 || ni >= zeta.NRows || nj < 0 || nj >= zeta.NCols ||
+				    (ni >= r0 && ni < r1 && nj >= c0 && nj < c1))
+				{
+					continue;
+				}
+				float outside = zeta(ni,nj);
+				if (raw(ni,nj) == NoDataValue || outside == unreached)
+				{
+					continue;
+				}
+				float filled = (raw[node] <= outside) ? outside
+				                          + ((Neighbour%2 == 0) ? cardinal_rise : diagonal_rise)
+				                        : raw[node];
+				if (filled < zeta[node])
+				{
+					//the cells on the edge are started from in order of
+					//elevation, like the outlets of priority_flood
+					zeta[node] = filled;
+					Queue.push(filled,node);
+					EdgeLowered = true;
+				}
+			}
+		}
+	}
+
+	//Flood the tile as priority_flood does. The cells on the tile edge are
+	//queued at raised elevations too, so any cell can have been lowered
+	epsilon_flood(raw, zeta, NoDataValue, r0, r1, c0, c1, cardinal_rise, diagonal_rise,
+	              Queue, EdgeLowered);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Refills a region of an already filled DEM in place, after the raw DEM has been
+// edited.
+//
+// The cells in Rows and Cols are reset to their elevations in RawDEM and filled
+// again by Priority-Flood. Every other cell keeps its filled elevation and acts as
+// an outlet for the region, as do the region cells on the DEM edge or next to a
+// NoDataValue. For the result to match a fill of the whole edited DEM, the region
+// has to hold every cell whose filled elevation can change; see
+// LSDFlowInfo::update_for_edited_region, which works out that region.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDRaster::refill_region(LSDRaster& RawDEM, float& MinSlope,
+                              vector<int>& Rows, vector<int>& Cols)
+{
+	if (RawDEM.NRows != NRows || RawDEM.NCols != NCols || Rows.size() != Cols.size())
+	{
+		cout << "LSDRaster::refill_region: the raw DEM must have the same dimensions "
+		     << "as the filled DEM and there must be a column for every row" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	float one_over_root2 = 0.707106781;
+	float cardinal_rise = 0;
+	float diagonal_rise = 0;
+	if (MinSlope > 0)
+	{
+		cardinal_rise = MinSlope*DataResolution;
+		diagonal_rise = MinSlope*DataResolution*one_over_root2;
+	}
+
+	LSDRasterView<float> zeta = make_raster_view(RasterData);
+	LSDRasterView<const float> raw = RawDEM.get_RasterView();
+	const int row_offsets[8] = {-1,-1, 0, 1, 1, 1, 0,-1};
+	const int col_offsets[8] = { 0, 1, 1, 1, 0,-1,-1,-1};
+
+	//0 = outside the region, 1 = in the region and not yet reached,
+	//2 = in the region and reached, or an outlet on the edge of the DEM,
+	//3 = outside the region and an outlet of it
+	vector<char> CellState(size_t(NRows)*size_t(NCols),0);
+
+	bool equal_rises = (cardinal_rise == diagonal_rise);
+	FillQueue Queue(long(NRows)*long(NCols), (equal_rises) ? 1 : 2);
+
+	//put the raw elevations back into the region
+	int NRegion = int(Rows.size());
+	for (int k = 0; k<NRegion; ++k)
+	{
+		long node = zeta.index(Rows[k],Cols[k]);
+		if (zeta[node] != NoDataValue && raw[node] != NoDataValue)
+		{
+			zeta[node] = raw[node];
+			CellState[node] = 1;
+		}
+	}
+
+	//collect the outlets of the region
+	for (int k = 0; k<NRegion; ++k)
+	{
+		int i = Rows[k], j = Cols[k];
+		long node = zeta.index(i,j);
+		if (CellState[node] != 1)
+		{
+			continue;
+		}
+
+		bool on_boundary = (i==0 || j==0 || i==NRows-1 || j==NCols-1);
+		for (int Neighbour = 0; Neighbour<8 && !on_boundary; ++Neighbour)
+		{
+			if (zeta(i+row_offsets[Neighbour],j+col_offsets[Neighbour]) == NoDataValue)
+			{
+				on_boundary = true;
+			}
+		}
+		if (on_boundary)
+		{
+			Queue.push(zeta[node],node);
+			CellState[node] = 2;
+			continue;
+		}
+
+		//neighbours outside the region keep their filled elevations
+		for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+		{
+			int ni = i+row_offsets[Neighbour];
+			int nj = j+col_offsets[Neighbour];
+			long neighbour = zeta.index(ni,nj);
+			if (CellState[neighbour] == 0 && zeta[neighbour] != NoDataValue)
+			{
+				Queue.push(zeta[neighbour],neighbour);
+				CellState[neighbour] = 3;
+			}
+		}
+	}
+
+	//flood the region, lowering cells that are reached again from lower down,
+	//as in priority_flood
+	float centre_zeta;
+	long node;
+	while (!Queue.empty())
+	{
+		bool pit = Queue.pop(centre_zeta,node);
+		if (pit && !equal_rises && centre_zeta != zeta[node])
+		{
+			continue;
+		}
+		int row = int(node/zeta.Stride);
+		int col = int(node-row*zeta.Stride);
+
+		for (int Neighbour = 0; Neighbour<8; ++Neighbour)
+		{
+			int neighbour_row = row+row_offsets[Neighbour];
+			int neighbour_col = col+col_offsets[Neighbour];
+			if (neighbour_row < 0 || neighbour_row >= NRows ||
+			    neighbour_col < 0 || neighbour_col >= NCols)
+			{
+				continue;
+			}
+			long neighbour = zeta.index(neighbour_row,neighbour_col);
+			if (CellState[neighbour] != 1 &&
+			    (CellState[neighbour] != 2 || zeta[neighbour] <= centre_zeta))
+			{
+				continue;
+			}
+
+			bool raised = (raw[neighbour] <= centre_zeta);
+			float filled = (raised) ? centre_zeta
+			                          + ((Neighbour%2 == 0) ? cardinal_rise : diagonal_rise)
+			                        : raw[neighbour];
+			if (CellState[neighbour] == 2 && filled >= zeta[neighbour])
+			{
+				continue;
+			}
+
+			CellState[neighbour] = 2;
+			zeta[neighbour] = filled;
+			if (!raised)
+			{
+				Queue.push(filled,neighbour);
+			}
 			else
 			{
-				//check if neighbour is equal/lower and therefore needs filling
-				if (FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]] <= CentreFillNode.Zeta)
+				Queue.push_pit(filled,neighbour,(Neighbour%2 == 0 || equal_rises) ? 0 : 1);
+			}
+		}
+	}
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The number of threads a parallel loop of fill_tiled runs on; 1 without OpenMP.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static int fill_threads()
+{
+	int NThreads = 0;
+	#pragma omp parallel reduction(+:NThreads)
+	{
+		NThreads += 1;
+	}
+	return NThreads;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Tiled, parallel version of fill.
+//
+// The DEM is cut into tiles of TileSize by TileSize cells, which are filled
+// independently and in parallel (see fill_tile). The labels of all tiles then form
+// a graph whose edges are the spill elevations between labels, both inside a tile
+// and across the edges between tiles. Flooding that graph from the real outlets
+// gives, for every label, the lowest elevation at which water can leave the DEM
+// from it. Finally each cell is raised to the spill elevation of its label, again
+// tile by tile in parallel.
+//
+// A fill with flats is unique, so this gives exactly the same DEM as the serial
+// fill. A MinSlope above zero raises cells above the flats, and those rises do
+// not fit in a graph of labels, so that case is handed to fill_tiled_epsilon.
+// The tiles only pay off when they are spread over several threads; on one
+// thread the work of the tiles is all extra, so fill is called instead.
+//
+// Parallel Priority-Flood of Barnes (2016), Computers & Geosciences 96, 56-68.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDRaster LSDRaster::fill_tiled(float& MinSlope, int TileSize)
+{
+	if (TileSize < 2)
+	{
+		cout << "LSDRaster::fill_tiled: the tile size must be at least 2, it is "
+		     << TileSize << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	int NTileRows = (NRows+TileSize-1)/TileSize;
+	int NTileCols = (NCols+TileSize-1)/TileSize;
+	int NTiles = NTileRows*NTileCols;
+	if (NTiles == 1 || fill_threads() == 1)
+	{
+		return fill(MinSlope);
+	}
+	if (MinSlope > 0)
+	{
+		return fill_tiled_epsilon(MinSlope, TileSize);
+	}
+
+	Array2D<float> FilledZeta;
+	FilledZeta = RasterData.copy();
+	Array2D<int> Labels(NRows,NCols,-1);
+	LSDRasterView<float> zeta = make_raster_view(FilledZeta);
+	LSDRasterView<int> labels = make_raster_view(Labels);
+	LSDRasterView<const float> raw = get_RasterView();
+
+	//fill the tiles
+	vector<int> NLabels(NTiles,0);
+	vector< map< pair<int,int>, float > > TileSpills(NTiles);
+	#pragma omp parallel for schedule(dynamic)
+	for (int tile = 0; tile<NTiles; ++tile)
+	{
+		int r0 = (tile/NTileCols)*TileSize;
+		int c0 = (tile%NTileCols)*TileSize;
+		fill_tile(raw, zeta, labels, NoDataValue, r0, min(r0+TileSize,NRows),
+		          c0, min(c0+TileSize,NCols), NLabels[tile], TileSpills[tile]);
+	}
+
+	//number the labels of all tiles; label 0 is the outside of the DEM
+	vector<int> LabelOffset(NTiles,0);
+	int NGraphNodes = 1;
+	for (int tile = 0; tile<NTiles; ++tile)
+	{
+		LabelOffset[tile] = NGraphNodes-1;
+		NGraphNodes += NLabels[tile];
+	}
+
+	//the spill graph, starting with the spills inside the tiles
+	vector< vector< pair<int,float> > > SpillGraph(NGraphNodes);
+	for (int tile = 0; tile<NTiles; ++tile)
+	{
+		for (map< pair<int,int>, float >::iterator it = TileSpills[tile].begin();
+		     it != TileSpills[tile].end(); ++it)
+		{
+			int a = (it->first.first == 0) ? 0 : LabelOffset[tile]+it->first.first;
+			int b = (it->first.second == 0) ? 0 : LabelOffset[tile]+it->first.second;
+			SpillGraph[a].push_back(make_pair(b,it->second));
+			SpillGraph[b].push_back(make_pair(a,it->second));
+		}
+		TileSpills[tile].clear();
+	}
+
+	//then the spills between neighbouring cells in different tiles. Only the
+	//cells either side of a tile edge need to be checked
+	for (int i=0; i<NRows; ++i)
+	{
+		//in the last row of a tile every cell is checked, otherwise only
+		//the last column of each tile
+		bool last_row_of_tile = (i%TileSize == TileSize-1 && i < NRows-1);
+		int first_col = (last_row_of_tile) ? 0 : TileSize-1;
+		int col_step = (last_row_of_tile) ? 1 : TileSize;
+		for (int j=first_col; j<NCols; j += col_step)
+		{
+			if (zeta(i,j) == NoDataValue)
+			{
+				continue;
+			}
+			int tile = (i/TileSize)*NTileCols + j/TileSize;
+			int a = (labels(i,j) == 0) ? 0 : LabelOffset[tile]+labels(i,j);
+
+			//the neighbours to the NE, E, SE, S and SW pick up every pair
+			const int row_offsets[5] = {-1, 0, 1, 1, 1};
+			const int col_offsets[5] = { 1, 1, 1, 0,-1};
+			for (int Neighbour = 0; Neighbour<5; ++Neighbour)
+			{
+				int ni = i+row_offsets[Neighbour];
+				int nj = j+col_offsets[Neighbour];
+				if (ni < 0 || ni >= NRows || nj < 0 || nj >= NCols || zeta(ni,nj) == NoDataValue)
+				{
+					continue;
+				}
+				int neighbour_tile = (ni/TileSize)*NTileCols + nj/TileSize;
+				if (neighbour_tile == tile)
+				{
+					continue;
+				}
+				int b = (labels(ni,nj) == 0) ? 0 : LabelOffset[neighbour_tile]+labels(ni,nj);
+				if (a != b)
+				{
+					float spill = max(zeta(i,j),zeta(ni,nj));
+					SpillGraph[a].push_back(make_pair(b,spill));
+					SpillGraph[b].push_back(make_pair(a,spill));
+				}
+			}
+		}
+	}
+
+	//flood the graph from the outside of the DEM. The level of a label is the
+	//lowest, over all paths to the outside, of the highest spill on the path
+	vector<float> Level(NGraphNodes,numeric_limits<float>::max());
+	vector<bool> Done(NGraphNodes,false);
+	priority_queue< pair<float,int>, vector< pair<float,int> >, greater< pair<float,int> > > GraphQueue;
+	Level[0] = -numeric_limits<float>::max();
+	GraphQueue.push(make_pair(Level[0],0));
+	while (!GraphQueue.empty())
+	{
+		int node = GraphQueue.top().second;
+		GraphQueue.pop();
+		if (Done[node])
+		{
+			continue;
+		}
+		Done[node] = true;
+		for (size_t e = 0; e<SpillGraph[node].size(); ++e)
+		{
+			int other = SpillGraph[node][e].first;
+			float level = max(Level[node],SpillGraph[node][e].second);
+			if (!Done[other] && level < Level[other])
+			{
+				Level[other] = level;
+				GraphQueue.push(make_pair(level,other));
+			}
+		}
+	}
+
+	//raise every cell to the level of its label
+	#pragma omp parallel for schedule(dynamic)
+	for (int tile = 0; tile<NTiles; ++tile)
+	{
+		int r0 = (tile/NTileCols)*TileSize;
+		int c0 = (tile%NTileCols)*TileSize;
+		for (int i = r0; i<min(r0+TileSize,NRows); ++i)
+		{
+			for (int j = c0; j<min(c0+TileSize,NCols); ++j)
+			{
+				long node = zeta.index(i,j);
+				if (zeta[node] == NoDataValue || labels[node] <= 0)
+				{
+					continue;
+				}
+				int label = LabelOffset[tile]+labels[node];
+				if (Done[label] && Level[label] > zeta[node])
 				{
-					//Modify neighbour's elevation
-					if(Neighbour%2 == 0)
+					zeta[node] = Level[label];
+				}
+			}
+		}
+	}
+
+	LSDRaster FilledDEM(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FilledZeta);
+	return FilledDEM;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The epsilon fill of fill_tiled, for a MinSlope above zero.
+//
+// fill gives every cell the lowest elevation from which it drains (see
+// priority_flood), and that elevation does not depend on the order in which
+// the cells are visited. Here every tile is flooded on its own from the outlets
+// of the DEM inside it and from the cells just outside it (see
+// epsilon_fill_tile). Whenever a cell on the edge of a tile is lowered, the
+// neighbouring tiles are flooded again from their edges, until no tile edge
+// changes. The rises are carried across the tile edges exactly as priority_flood
+// carries them between neighbouring cells, so the result is identical to fill.
+//
+// The tiles are taken in four rounds, by the parity of their row and column,
+// so that the tiles flooded at the same time never touch and each one reads
+// the cells just outside it while they are not being written.
+//
+// A lowering can cross a tile edge on every round, so a DEM that drains
+// through long flats (at worst one that drains to a single corner) would take
+// a number of rounds that grows with the number of tiles, each flooding whole
+// tiles again. The rounds are therefore cut off after MaxSweeps sweeps, and
+// whatever has not settled is finished by one serial flood over the DEM from
+// the cells around the tiles still pending. That flood only visits the cells
+// it lowers, and since every cell is at or above its final elevation at any
+// point, it ends at the same DEM as fill.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDRaster LSDRaster::fill_tiled_epsilon(float& MinSlope, int TileSize)
+{
+	float one_over_root2 = 0.707106781;
+	float cardinal_rise = MinSlope*DataResolution;
+	float diagonal_rise = MinSlope*DataResolution*one_over_root2;
+
+	int NTileRows = (NRows+TileSize-1)/TileSize;
+	int NTileCols = (NCols+TileSize-1)/TileSize;
+	int NTiles = NTileRows*NTileCols;
+
+	//the outlets keep their elevations and every other cell is unreached
+	Array2D<float> FilledZeta(NRows,NCols);
+	LSDRasterView<float> zeta = make_raster_view(FilledZeta);
+	LSDRasterView<const float> raw = get_RasterView();
+	const float unreached = numeric_limits<float>::max();
+	#pragma omp parallel for schedule(static)
+	for (int i=0; i<NRows; ++i)
+	{
+		for (int j=0; j<NCols; ++j)
+		{
+			long node = zeta.index(i,j);
+			zeta[node] = raw[node];
+			if (raw[node] == NoDataValue || i==0 || j==0 || i==NRows-1 || j==NCols-1)
+			{
+				continue;
+			}
+			bool on_boundary = false;
+			for (int di = -1; di<=1 && !on_boundary; ++di)
+			{
+				for (int dj = -1; dj<=1; ++dj)
+				{
+					if (raw(i+di,j+dj) == NoDataValue)
 					{
-						if (MinSlope > 0)
-						{
-							FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]] = CentreFillNode.Zeta + MinSlope*DataResolution;
-						}
-						else
-						{
-							FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]] = CentreFillNode.Zeta;
-						}
+						on_boundary = true;
+						break;
 					}
-					else
+				}
+			}
+			if (!on_boundary)
+			{
+				zeta[node] = unreached;
+			}
+		}
+	}
+
+	//flood the tiles until none of their edges change, for at most MaxSweeps
+	//sweeps of the four rounds
+	const int MaxSweeps = 2;
+	vector<char> Flooded(NTiles,0);
+	vector<char> Pending(NTiles,1);
+	vector<int> Batch;
+	bool any_pending = true;
+	for (int sweep = 0; sweep<MaxSweeps && any_pending; ++sweep)
+	{
+		for (int parity = 0; parity<4; ++parity)
+		{
+			Batch.clear();
+			for (int tile = 0; tile<NTiles; ++tile)
+			{
+				int tile_row = tile/NTileCols, tile_col = tile%NTileCols;
+				if (Pending[tile] && (tile_row%2)*2+tile_col%2 == parity)
+				{
+					Batch.push_back(tile);
+				}
+			}
+			int NBatch = int(Batch.size());
+			vector<char> EdgeLowered(NBatch,0);
+			#pragma omp parallel for schedule(dynamic)
+			for (int b = 0; b<NBatch; ++b)
+			{
+				int tile = Batch[b];
+				int r0 = (tile/NTileCols)*TileSize;
+				int c0 = (tile%NTileCols)*TileSize;
+				bool edge_lowered;
+				epsilon_fill_tile(raw, zeta, NoDataValue, r0, min(r0+TileSize,NRows),
+				                  c0, min(c0+TileSize,NCols), cardinal_rise, diagonal_rise,
+				                  !Flooded[tile], edge_lowered);
+				EdgeLowered[b] = edge_lowered;
+			}
+
+			//a tile whose edge was lowered has to flood its neighbours again
+			for (int b = 0; b<NBatch; ++b)
+			{
+				int tile = Batch[b];
+				Flooded[tile] = 1;
+				Pending[tile] = 0;
+			}
+			for (int b = 0; b<NBatch; ++b)
+			{
+				if (!EdgeLowered[b])
+				{
+					continue;
+				}
+				int tile_row = Batch[b]/NTileCols, tile_col = Batch[b]%NTileCols;
+				for (int tr = max(tile_row-1,0); tr<=min(tile_row+1,NTileRows-1); ++tr)
+				{
+					for (int tc = max(tile_col-1,0); tc<=min(tile_col+1,NTileCols-1); ++tc)
 					{
-						if (MinSlope > 0)
+						if (tr != tile_row || tc != tile_col)
 						{
-							FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]] = CentreFillNode.Zeta
-							                                     + MinSlope*DataResolution*one_over_root2;
-						}
-						else
-						{
-							FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]] = CentreFillNode.Zeta;
+							Pending[tr*NTileCols+tc] = 1;
 						}
 					}
 				}
-				//New neighbour needs to be added to the priority queue
-				TempFillNode.Zeta = FilledZeta[row_kernal[Neighbour]][col_kernal[Neighbour]];
-				TempFillNode.RowIndex = row_kernal[Neighbour];
-				TempFillNode.ColIndex = col_kernal[Neighbour];
-				PriorityQueue.push(TempFillNode);
-				FillIndex[row_kernal[Neighbour]][col_kernal[Neighbour]] = 1;
-				FillIndex[row][col] = 2;
 			}
 		}
+		any_pending = (find(Pending.begin(),Pending.end(),1) != Pending.end());
 	}
+
+	//the tiles still pending are finished by one flood over the whole DEM,
+	//started from the cells just outside them, which are the only cells that
+	//can still lower a cell in another tile
+	if (any_pending)
+	{
+		FillQueue Queue(long(NRows)*long(NCols), (cardinal_rise == diagonal_rise) ? 1 : 2);
+		for (int tile = 0; tile<NTiles; ++tile)
+		{
+			if (!Pending[tile])
+			{
+				continue;
+			}
+			int r0 = (tile/NTileCols)*TileSize;
+			int c0 = (tile%NTileCols)*TileSize;
+			int r1 = min(r0+TileSize,NRows);
+			int c1 = min(c0+TileSize,NCols);
+			for (int i = max(r0-1,0); i<=min(r1,NRows-1); ++i)
+			{
+				bool ring_row = (i == r0-1 || i == r1);
+				for (int j = max(c0-1,0); j<=min(c1,NCols-1); ++j)
+				{
+					if (!ring_row && j != c0-1 && j != c1)
+					{
+						continue;
+					}
+					long node = zeta.index(i,j);
+					if (raw[node] != NoDataValue && zeta[node] != unreached)
+					{
+						Queue.push(zeta[node],node);
+					}
+				}
+			}
+		}
+		bool edge_lowered;
+		epsilon_flood(raw, zeta, NoDataValue, 0, NRows, 0, NCols, cardinal_rise, diagonal_rise,
+		              Queue, edge_lowered);
+	}
+
 	LSDRaster FilledDEM(NRows,NCols,XMinimum,YMinimum,DataResolution,NoDataValue,FilledZeta);
 	return FilledDEM;
 }
@@ -101,6 +101,7 @@ Tools are included to:
 #include <vector>
 #include "TNT/tnt.h"
 #include "LSDIndexRaster.hpp"
+#include "LSDRasterStorage.hpp"
 using namespace std;
 using namespace TNT;
 
@@ -127,6 +128,19 @@ class LSDRaster
   /// @param extension A String, the file extension to be loaded.
   LSDRaster(string filename, string extension)	{ create(filename, extension); }
 
+  /// @brief Create an LSDRaster from a window of a file.
+  /// See read_raster_window for details.
+  /// @return LSDRaster
+  /// @param filename A String, the file to be loaded.
+  /// @param extension A String, the file extension to be loaded.
+  /// @param first_row The first row of the window; row 0 is the northern edge.
+  /// @param first_col The first column of the window.
+  /// @param window_rows The number of rows in the window.
+  /// @param window_cols The number of columns in the window.
+  LSDRaster(string filename, string extension, int first_row, int first_col,
+            int window_rows, int window_cols)
+    { create(filename, extension, first_row, first_col, window_rows, window_cols); }
+
   /// @brief Create an LSDRaster from memory.
   /// @return LSDRaster
   /// @param nrows An integer of the number of rows.
@@ -157,6 +171,16 @@ class LSDRaster
   int get_NoDataValue() const			{ return NoDataValue; }
   /// @return Raster values as a 2D Array.
   Array2D<float> get_RasterData() const { return RasterData.copy(); }
+  /// @return A read only view of the raster values as one contiguous, cache line
+  /// aligned block, see LSDRasterStorage.hpp. It is valid while the raster is.
+  LSDRasterView<const float> get_RasterView() const { return make_raster_view(RasterData); }
+
+  /// @brief A checksum of the raster: its dimensions, georeferencing, no data
+  /// value and cells. See checksum_bytes and checksum_words in
+  /// LSDRasterStorage.hpp.
+  /// @return The checksum.
+  /// @date 16/10/26
+  unsigned long long checksum() const;
 
   /// Assignment operator.
   LSDRaster& operator=(const LSDRaster& LSDR);
@@ -175,7 +199,11 @@ class LSDRaster
   ///
   /// For float files both a data file and a header are read
   /// the header file must have the same filename, before extention, of
-  /// the raster data, and the extension must be .hdr.
+  /// the raster data, and the extension must be .hdr. If the byteorder field
+  /// of the header differs from the system's byte order the data are swapped.
+  ///
+  /// Rasters can also be read from the tiled, compressed .lzt format
+  /// described in LSDRasterTiles.hpp. Its header is part of the data file.
   ///
   /// @author SMM
   /// @date 01/01/12
@@ -194,7 +222,12 @@ class LSDRaster
   ///
   /// For float files both a data file and a header are written
   /// the header file must have the same filename, before extention, of
-  /// the raster data, and the extension must be .hdr.
+  /// the raster data, and the extension must be .hdr. The data are written in
+  /// the system's byte order, which is recorded in the byteorder field.
+  ///
+  /// With the extension lzt the raster is written as independently compressed
+  /// tiles, see LSDRasterTiles.hpp. This is much smaller for rasters that are
+  /// mostly NoData.
   ///
   /// @param filename a string of the filename _without_ the extension.
   /// @param extension a string of the extension _without_ the leading dot
@@ -202,6 +235,55 @@ class LSDRaster
   /// @date 01/01/12
   void write_raster(string filename, string extension);
 
+  /// @brief Write a raster to a file in the background.
+  ///
+  /// @details A copy of the raster is queued with the background writer (see
+  /// LSDRasterWriteQueue.hpp) and the function returns straight away, so the
+  /// raster may be changed or destroyed afterwards. The file formats are the
+  /// same as for write_raster. Errors are reported by flush_raster_writes(),
+  /// which should be called before the files are used.
+  ///
+  /// @param filename a string of the filename _without_ the extension.
+  /// @param extension a string of the extension _without_ the leading dot
+  /// @date 16/10/26
+  void write_raster_async(string filename, string extension);
+
+  /// @brief Read a rectangular window of a raster file into memory.
+  ///
+  /// @details Only the window is read: for .flt files each row of the window
+  /// is read after a seek, for .asc files everything before the first row
+  /// of the window is skipped without being parsed, and for .lzt files only
+  /// the tiles that overlap the window are decompressed. XMinimum and YMinimum are
+  /// shifted so that the resulting raster is georeferenced correctly.
+  /// The window must lie inside the raster.
+  ///
+  /// @param filename a string of the filename _without_ the extension.
+  /// @param extension a string of the extension _without_ the leading dot
+  /// @param first_row The first row of the window; row 0 is the northern edge.
+  /// @param first_col The first column of the window.
+  /// @param window_rows The number of rows in the window.
+  /// @param window_cols The number of columns in the window.
+  /// @date 16/10/26
+  void read_raster_window(string filename, string extension, int first_row, int first_col,
+                          int window_rows, int window_cols);
+
+  /// @brief Read the part of a raster file that covers a bounding box in map
+  /// coordinates.
+  ///
+  /// @details Coordinates are converted to rows and columns in the same way as
+  /// LSDFlowInfo::get_node_index_of_coordinate_point, and every cell whose
+  /// centre falls in the box is read. The box is clipped to the raster.
+  ///
+  /// @param filename a string of the filename _without_ the extension.
+  /// @param extension a string of the extension _without_ the leading dot
+  /// @param X_min Western edge of the box.
+  /// @param Y_min Southern edge of the box.
+  /// @param X_max Eastern edge of the box.
+  /// @param Y_max Northern edge of the box.
+  /// @date 16/10/26
+  void read_raster_bounding_box(string filename, string extension, float X_min, float Y_min,
+                                float X_max, float Y_max);
+
   /// @brief rewrite all the data array values with random numbers (with a 
   /// uniform distribution). 
   /// @param range is the range of values.
@@ -785,17 +867,18 @@ class LSDRaster
   /// v1.0 is slow as it requires many iterations through the dem
   ///
   /// Martin Hurst, June 2010
+  ///
+  ///---------------------------------------------------------------------------------
+  ///
+  /// v2.0 runs on the Priority-Flood engine of fill(MinSlope) instead of the
+  /// recursive fill_iterator, so big flat pits no longer overflow the stack.
+  /// Each raised cell ends up 1mm above the neighbour it drains to.
+  ///
+  /// 16/10/26
   /// @return Filled LSDRaster.
   /// @author MDH
   /// @date 01/06/10
   LSDRaster fill();
-	/// @brief This is a recursive algorithm that is called by the fill function.
-  /// @param fill_data
-  /// @param i
-  /// @param j
-  /// @author MDH
-  /// @date 01/06/10
-	void fill_iterator(Array2D<float>& fill_data, int i, int j);
 
 
   /// @brief This function fills pits/sinks in a DEM by checking for pits from
@@ -807,6 +890,11 @@ class LSDRaster
   /// that are yet to be visited must be higher in a hydrologically correct DEM.
   /// This method is substantially faster on datasets with pits consisting of
   /// multiple cells since each cell only needs to be visited once.
+  /// Cells raised inside a depression go through plain FIFO queues rather
+  /// than the priority queue (Barnes et al., 2014), and the priority queue is
+  /// a radix heap on the elevations. Each cell ends up at the
+  /// lowest elevation from which it drains, so the result does not depend on
+  /// the order in which cells of equal elevation are visited.
   ///
   /// Method taken from Wang and Liu (2006), Int. J. of GIS. 20(2), 193-213
   /// @param MinSlope The minimum slope between two Nodes once filled. If set
@@ -815,6 +903,40 @@ class LSDRaster
   /// @author Martin Hurst
   /// @date 12/3/13
   LSDRaster fill(float& MinSlope);
+
+  /// @brief Tiled, parallel version of fill(MinSlope).
+  ///
+  /// @details The DEM is cut into tiles that are filled independently and in
+  /// parallel. With a MinSlope of zero the spill elevations between the tiles
+  /// are then resolved in a graph of the tile edges, and the tiles are finished
+  /// in parallel. With a MinSlope above zero the tiles are flooded again from
+  /// their edges, with the rises carried across the edges, for a couple of
+  /// sweeps, and what is left is finished by one serial flood from the edges
+  /// of the unsettled tiles. Either way the result is identical to
+  /// fill(MinSlope). On a single thread this just calls fill(MinSlope), since
+  /// the tiles only add work there.
+  ///
+  /// Parallel Priority-Flood of Barnes (2016), Computers & Geosciences 96, 56-68.
+  /// @param MinSlope The minimum slope between two Nodes once filled. If set
+  /// to zero will create flats.
+  /// @param TileSize The number of rows and columns in a tile.
+  /// @return Filled LSDRaster object.
+  /// @date 16/10/26
+  LSDRaster fill_tiled(float& MinSlope, int TileSize = 512);
+
+  /// @brief Refills a region of this filled DEM in place after the raw DEM has
+  /// been edited.
+  ///
+  /// @details The cells of the region are reset to their raw elevations and
+  /// filled again, with every cell outside the region held at its filled
+  /// elevation. The region must hold every cell whose filled elevation can
+  /// change, see LSDFlowInfo::update_for_edited_region.
+  /// @param RawDEM The edited, unfilled DEM.
+  /// @param MinSlope The minimum slope used to fill this DEM.
+  /// @param Rows Rows of the cells in the region.
+  /// @param Cols Columns of the cells in the region.
+  /// @date 16/10/26
+  void refill_region(LSDRaster& RawDEM, float& MinSlope, vector<int>& Rows, vector<int>& Cols);
     
 	// multidirection flow routing
 	/// @brief Generate a flow area raster using a multi direction algorithm.
@@ -1281,12 +1403,56 @@ class LSDRaster
 	/// Raster data.
 	Array2D<float> RasterData;
 
+	/// @brief Keeps the scratch file behind RasterData mapped. Empty when
+	/// RasterData lives on the heap. See LSDRasterStorage.hpp.
+	LSDStorageHandle RasterDataStorage;
+
 	private:
 	void create();
 	void create(string filename, string extension);
+	void create(string filename, string extension, int first_row, int first_col,
+	            int window_rows, int window_cols);
 	void create(int ncols, int nrows, float xmin, float ymin,
 	            float cellsize, float ndv, Array2D<float> data);
 
+	/// @brief Writes the raster for write_raster and write_raster_async.
+	/// @return An empty string on success, otherwise a description of the error.
+	/// @date 16/10/26
+	string write_raster_file(string filename, string extension) const;
+
+	/// @brief Reads the dimensions and georeferencing of a raster file without
+	/// reading its data. For .asc and .lzt files this is the top of the data
+	/// file, for .flt files it is the .hdr file.
+	/// @return true if the data of a .flt file are in the other byte order to
+	/// this system's, as given by the byteorder field of its header.
+	/// @date 16/10/26
+	bool read_raster_header(string filename, string extension);
+
+	/// @brief Reads a window of an .lzt file into Buffer, exiting on an error.
+	/// @date 16/10/26
+	void read_tiled_window(string string_filename, int first_row, int first_col,
+	                       int window_rows, int window_cols, float* Buffer);
+
+	/// @brief The Priority-Flood engine behind fill() and fill(MinSlope).
+	/// @details Fills FilledZeta in place, starting from the DEM edge and the
+	/// cells next to NoData. A raised cell ends up cardinal_rise or diagonal_rise
+	/// above the lowest neighbour it can be reached from.
+	/// @param FilledZeta A copy of the raster data, filled on return.
+	/// @param cardinal_rise The rise to a filled cardinal neighbour.
+	/// @param diagonal_rise The rise to a filled diagonal neighbour.
+	/// @date 16/10/26
+	void priority_flood(Array2D<float>& FilledZeta, float cardinal_rise, float diagonal_rise);
+
+	/// @brief fill_tiled for a MinSlope above zero.
+	/// @details The tiles are flooded from their edges for at most a few
+	/// sweeps, and then the tiles whose edges still change are finished by one
+	/// flood over the DEM, so the result is identical to fill(MinSlope).
+	/// @param MinSlope The minimum slope between two Nodes once filled.
+	/// @param TileSize The number of rows and columns in a tile.
+	/// @return Filled LSDRaster object.
+	/// @date 16/10/26
+	LSDRaster fill_tiled_epsilon(float& MinSlope, int TileSize);
+
 };
 
 #endif
@@ -0,0 +1,267 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterStorage
+// Land Surface Dynamics Raster Storage
+//
+// A collection of routines for allocating the full grid arrays used by the
+// Edinburgh Land Surface Dynamics group topographic toolbox. Arrays live on the
+// heap by default, but can be placed in memory mapped scratch files so that
+// rasters bigger than the available RAM can be paged by the operating system.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "LSDRasterStorage.hpp"
+using namespace std;
+
+#ifndef LSDRasterStorage_CPP
+#define LSDRasterStorage_CPP
+
+// the scratch directory shared by all allocations; empty means heap storage
+static string RasterScratchDirectory;
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Unmaps a scratch block when the last handle on it goes away.
+// The backing file was unlinked when it was mapped, so unmapping it is enough
+// for the operating system to reclaim the disk space.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+struct ScratchBlockUnmapper
+{
+  size_t NBytes;
+  explicit ScratchBlockUnmapper(size_t n) : NBytes(n) {}
+  void operator()(void* block) const
+  {
+    if (block != NULL)
+    {
+      munmap(block, NBytes);
+    }
+  }
+};
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Frees an aligned heap block when the last handle on it goes away.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+struct AlignedBlockDeleter
+{
+  void operator()(void* block) const
+  {
+    ::operator delete[](block, std::align_val_t(LSDRasterAlignment));
+  }
+};
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Sets and gets the scratch directory
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void set_raster_scratch_directory(string directory)
+{
+  if (!directory.empty() && directory[directory.size()-1] != '/')
+  {
+    directory += "/";
+  }
+  RasterScratchDirectory = directory;
+}
+
+string get_raster_scratch_directory()
+{
+  return RasterScratchDirectory;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This maps a block of NBytes in a fresh scratch file.
+// The file is created with mkstemp, sized, mapped shared so that the
+// operating system writes dirty pages back to it rather than to swap, and then
+// unlinked straight away.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void* map_scratch_block(size_t NBytes, LSDStorageHandle& Handle)
+{
+  string name_template = RasterScratchDirectory+"LSDscratch_XXXXXX";
+  vector<char> name(name_template.begin(), name_template.end());
+  name.push_back('\0');
+
+  int fd = mkstemp(&name[0]);
+  if (fd == -1)
+  {
+    cout << "\nFATAL ERROR: unable to create a scratch file in "
+         << RasterScratchDirectory << ": " << strerror(errno) << endl;
+    exit(EXIT_FAILURE);
+  }
+  unlink(&name[0]);
+
+  if (ftruncate(fd, off_t(NBytes)) != 0)
+  {
+    cout << "\nFATAL ERROR: unable to size a " << NBytes << " byte scratch file in "
+         << RasterScratchDirectory << ": " << strerror(errno) << endl;
+    close(fd);
+    exit(EXIT_FAILURE);
+  }
+
+  void* block = mmap(NULL, NBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED)
+  {
+    cout << "\nFATAL ERROR: unable to map a " << NBytes << " byte scratch file: "
+         << strerror(errno) << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  Handle = LSDStorageHandle(block, ScratchBlockUnmapper(NBytes));
+  return block;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This allocates a heap block of NBytes starting on a cache line.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void* allocate_aligned_block(size_t NBytes, LSDStorageHandle& Handle)
+{
+  void* block = ::operator new[](NBytes, std::align_val_t(LSDRasterAlignment));
+  Handle = LSDStorageHandle(block, AlignedBlockDeleter());
+  return block;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This maps a whole file, privately so that writes to the mapping are copy on
+// write and never reach the file. A missing or empty file is not an error;
+// the caller decides what to do without it.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void* map_file(string filename, size_t& NBytes, LSDStorageHandle& Handle)
+{
+  Handle.reset();
+  NBytes = 0;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    return NULL;
+  }
+  struct stat file_status;
+  if (fstat(fd, &file_status) != 0 || file_status.st_size <= 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  size_t file_bytes = size_t(file_status.st_size);
+  void* block = mmap(NULL, file_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (block == MAP_FAILED)
+  {
+    return NULL;
+  }
+
+  NBytes = file_bytes;
+  Handle = LSDStorageHandle(block, ScratchBlockUnmapper(file_bytes));
+  return block;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// 64 bit FNV-1a: each byte is xored in and the result multiplied by the FNV
+// prime.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+unsigned long long checksum_bytes(const void* Data, size_t NBytes,
+                                  unsigned long long Checksum)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(Data);
+  for (size_t i = 0; i < NBytes; ++i)
+  {
+    Checksum ^= bytes[i];
+    Checksum *= 1099511628211ULL;
+  }
+  return Checksum;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Four independent chains, each xoring in every fourth 8 byte word and
+// multiplying by the FNV prime. Both steps can be undone, so a changed word
+// always gives a changed chain. The chains and the bytes after the last whole
+// 32 byte block are then run through checksum_bytes.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+unsigned long long checksum_words(const void* Data, size_t NBytes,
+                                  unsigned long long Checksum)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(Data);
+  const unsigned long long prime = 1099511628211ULL;
+  unsigned long long chains[4] = { Checksum, Checksum+1, Checksum+2, Checksum+3 };
+  size_t n_blocks = NBytes/32;
+  for (size_t block = 0; block < n_blocks; ++block)
+  {
+    unsigned long long words[4];
+    memcpy(words, bytes+32*block, 32);
+    for (int chain = 0; chain < 4; ++chain)
+    {
+      chains[chain] = (chains[chain]^words[chain])*prime;
+    }
+  }
+  Checksum = checksum_bytes(chains, sizeof(chains), Checksum);
+  return checksum_bytes(bytes+32*n_blocks, NBytes-32*n_blocks, Checksum);
+}
+
+#endif
@@ -0,0 +1,248 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterStorage
+// Land Surface Dynamics Raster Storage
+//
+// A collection of routines for allocating the full grid arrays used by the
+// Edinburgh Land Surface Dynamics group topographic toolbox. Arrays live on the
+// heap by default, but can be placed in memory mapped scratch files so that
+// rasters bigger than the available RAM can be paged by the operating system.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+/** @file LSDRasterStorage.hpp
+@brief Heap or memory mapped scratch file storage for full grid arrays.
+@details By default every array is allocated on the heap.
+Once a scratch directory has been set with set_raster_scratch_directory(), the
+arrays of LSDRaster, LSDIndexRaster and the full grid arrays of LSDFlowInfo are
+placed in memory mapped files in that directory instead. The files are unlinked
+as soon as they are mapped, so nothing is left behind if a program crashes.
+
+Either way the cells of an array are one contiguous, row major block that
+starts on a cache line (heap blocks are aligned to LSDRasterAlignment bytes and
+mapped blocks start on a page). Hot loops should work on that block through an
+LSDRasterView rather than through the row pointers of the Array2D.
+
+@date 16/10/26
+*/
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <string>
+#include <memory>
+#include <cstddef>
+#include "TNT/tnt.h"
+using namespace std;
+using namespace TNT;
+
+#ifndef LSDRasterStorage_H
+#define LSDRasterStorage_H
+
+/// @brief Handle on the storage behind an array. Copies of the handle share the
+/// storage, which is released when the last copy is destroyed. An empty handle
+/// means the array is owned by TNT in the usual way.
+typedef shared_ptr<void> LSDStorageHandle;
+
+/// The alignment, in bytes, of the heap blocks behind raster arrays: one cache
+/// line, so that rows of a view start where vector loads want them to.
+const size_t LSDRasterAlignment = 64;
+
+/// @brief Sets the directory in which scratch files for raster data are created.
+/// @details Only arrays allocated after this call are affected. Passing an empty
+/// string switches back to heap storage, which is the default.
+/// @param directory The scratch directory, with or without a trailing slash.
+/// @date 16/10/26
+void set_raster_scratch_directory(string directory);
+
+/// @return The current scratch directory; empty if arrays live on the heap.
+/// @date 16/10/26
+string get_raster_scratch_directory();
+
+/// @brief Maps a block of NBytes in a new scratch file in the scratch directory.
+/// @param NBytes The size of the block in bytes.
+/// @param Handle Overwritten with the handle that keeps the mapping alive.
+/// @return Pointer to the start of the mapped block.
+/// @date 16/10/26
+void* map_scratch_block(size_t NBytes, LSDStorageHandle& Handle);
+
+/// @brief Allocates a block of NBytes on the heap, aligned to LSDRasterAlignment.
+/// @param NBytes The size of the block in bytes.
+/// @param Handle Overwritten with the handle that frees the block.
+/// @return Pointer to the start of the block.
+/// @date 16/10/26
+void* allocate_aligned_block(size_t NBytes, LSDStorageHandle& Handle);
+
+/// @brief Maps a whole file into memory, copy on write.
+/// @details The pages are read from the file as they are touched. Changes made
+/// through the mapping stay in memory and never reach the file, so arrays can
+/// be viewed in place and still be modified.
+/// @param filename The file to map.
+/// @param NBytes Set to the size of the file in bytes.
+/// @param Handle Overwritten with the handle that keeps the mapping alive.
+/// @return Pointer to the start of the file; NULL, with an empty handle, if the
+/// file cannot be opened or mapped or is empty.
+/// @date 16/10/26
+void* map_file(string filename, size_t& NBytes, LSDStorageHandle& Handle);
+
+/// @brief The 64 bit FNV-1a checksum of a block of bytes.
+/// @details Checksums of several blocks are chained by passing the checksum of
+/// one block as the starting value for the next. This is for telling data
+/// apart, not for security.
+/// @param Data The first byte of the block.
+/// @param NBytes The size of the block in bytes.
+/// @param Checksum The starting value: the FNV offset basis, or the checksum
+/// of the blocks before this one.
+/// @return The checksum.
+/// @date 16/10/26
+unsigned long long checksum_bytes(const void* Data, size_t NBytes,
+                                  unsigned long long Checksum = 14695981039346656037ULL);
+
+/// @brief A checksum of a block of bytes that is taken eight bytes at a time.
+/// @details FNV-1a goes one byte at a time, each step waiting on the multiply
+/// of the last, which makes it far slower than reading the block. This runs
+/// four FNV style chains over interleaved 8 byte words, so the multiplies
+/// overlap and the checksum keeps up with memory. A change to any one word
+/// always changes the result. Chained like checksum_bytes; the two give
+/// different checksums of the same block.
+/// @param Data The first byte of the block.
+/// @param NBytes The size of the block in bytes.
+/// @param Checksum The starting value, as for checksum_bytes.
+/// @return The checksum.
+/// @date 16/10/26
+unsigned long long checksum_words(const void* Data, size_t NBytes,
+                                  unsigned long long Checksum = 14695981039346656037ULL);
+
+/// @brief Allocates an NRows by NCols array, either on the heap or in a scratch
+/// file depending on the current scratch directory. The contents are
+/// uninitialised.
+///
+/// @details The array is a non owning TNT view of an aligned heap block or of a
+/// scratch file, so Handle must be kept alongside the array for as long as the
+/// array (or any shallow copy of it) is in use. T must be a plain arithmetic
+/// type, since no constructors are run on the cells.
+/// @param NRows Number of rows.
+/// @param NCols Number of columns.
+/// @param Handle Overwritten with the handle of the new storage.
+/// @return The allocated array.
+/// @date 16/10/26
+template <class T>
+Array2D<T> allocate_raster_array(int NRows, int NCols, LSDStorageHandle& Handle)
+{
+  Handle.reset();
+  if (NRows <= 0 || NCols <= 0)
+  {
+    return Array2D<T>(NRows, NCols);
+  }
+
+  size_t NBytes = size_t(NRows)*size_t(NCols)*sizeof(T);
+  void* block = (get_raster_scratch_directory().empty()
+                   ? allocate_aligned_block(NBytes, Handle)
+                   : map_scratch_block(NBytes, Handle));
+  return Array2D<T>(NRows, NCols, static_cast<T*>(block));
+}
+
+/// @brief A view of the cells of a raster as one block with a row stride.
+/// @details The view does not own the cells, so it must not outlive the array
+/// it was made from. Cell (row, col) is Data[row*Stride+col], and a cell and
+/// its neighbours are a fixed number of elements apart, which lets kernels
+/// step through the raster with flat indices and precomputed offsets and lets
+/// the compiler vectorise loops along a row.
+/// @date 16/10/26
+template <class T>
+struct LSDRasterView
+{
+  /// The first cell of the first row.
+  T* Data;
+  /// Number of rows.
+  int NRows;
+  /// Number of columns.
+  int NCols;
+  /// Number of elements from the start of one row to the start of the next.
+  long Stride;
+
+  LSDRasterView() : Data(NULL), NRows(0), NCols(0), Stride(0) {}
+  LSDRasterView(T* data, int nrows, int ncols, long stride)
+      : Data(data), NRows(nrows), NCols(ncols), Stride(stride) {}
+  /// A view of T converts to a read only view of T.
+  template <class U>
+  LSDRasterView(const LSDRasterView<U>& other)
+      : Data(other.Data), NRows(other.NRows), NCols(other.NCols), Stride(other.Stride) {}
+
+  /// @return The flat index of cell (row, col).
+  long index(int row, int col) const       { return long(row)*Stride+col; }
+  /// @return A pointer to the first cell of a row.
+  T* row(int row) const                    { return Data+long(row)*Stride; }
+  /// @return The cell (row, col).
+  T& operator()(int row, int col) const    { return Data[long(row)*Stride+col]; }
+  /// @return The cell at a flat index.
+  T& operator[](long i) const              { return Data[i]; }
+};
+
+/// @brief Makes a view of all the cells of an array.
+/// @param A The array. TNT keeps the rows of an Array2D in one block.
+/// @return The view; empty if the array is.
+/// @date 16/10/26
+template <class T>
+LSDRasterView<T> make_raster_view(Array2D<T>& A)
+{
+  if (A.dim1() <= 0 || A.dim2() <= 0)
+  {
+    return LSDRasterView<T>();
+  }
+  return LSDRasterView<T>(A[0], A.dim1(), A.dim2(), A.dim2());
+}
+
+/// @brief Makes a read only view of all the cells of an array.
+/// @date 16/10/26
+template <class T>
+LSDRasterView<const T> make_raster_view(const Array2D<T>& A)
+{
+  if (A.dim1() <= 0 || A.dim2() <= 0)
+  {
+    return LSDRasterView<const T>();
+  }
+  return LSDRasterView<const T>(A[0], A.dim1(), A.dim2(), A.dim2());
+}
+
+#endif
@@ -0,0 +1,513 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterTiles
+// Land Surface Dynamics Tiled Rasters
+//
+// A collection of routines for reading and writing rasters in a tiled, zlib
+// compressed format used by the Edinburgh Land Surface Dynamics group
+// topographic toolbox. Each tile is compressed on its own so that any part of
+// a raster can be read without decompressing the rest of it.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <zlib.h>
+#include "LSDShapeTools.hpp"
+#include "LSDRasterTiles.hpp"
+using namespace std;
+
+#ifndef LSDRasterTiles_CPP
+#define LSDRasterTiles_CPP
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Gets the first row and column of a tile and its size. Tiles on the southern
+// and eastern edges are cut short to fit the raster.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void get_tile_extent(const LSDTiledRasterInfo& Info, int TileRow, int TileCol,
+                            int& FirstRow, int& FirstCol, int& TileRows, int& TileCols)
+{
+  FirstRow = TileRow*Info.TileSize;
+  FirstCol = TileCol*Info.TileSize;
+  TileRows = min(Info.TileSize, Info.NRows-FirstRow);
+  TileCols = min(Info.TileSize, Info.NCols-FirstCol);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_tiled_raster_info
+// This reads the text header of an .lzt file and the tile index that follows it
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string read_tiled_raster_info(string Filename, LSDTiledRasterInfo& Info)
+{
+  ifstream ifs(Filename.c_str(), ios::in | ios::binary);
+  if (ifs.fail())
+  {
+    return "the file \""+Filename+"\" doesn't exist";
+  }
+
+  string key;
+  int version = 0;
+  ifs >> key >> version;
+  if (key != "LSDTILED" || version != 1)
+  {
+    return Filename+" is not a version 1 tiled raster";
+  }
+
+  Info.NRows = -1;
+  Info.NCols = -1;
+  Info.XMinimum = 0;
+  Info.YMinimum = 0;
+  Info.DataResolution = 0;
+  Info.NoDataValue = -9999;
+  Info.TileSize = 0;
+  Info.IntegerData = false;
+  Info.ByteSwapped = false;
+  string byteorder = SystemByteOrder();
+  string datatype = "float32";
+  long NTiles = -1;
+
+  // the fields are read by name; any this version does not know are skipped
+  string value;
+  while (ifs >> key && key != "end_header")
+  {
+    if (key == "ncols")             ifs >> Info.NCols;
+    else if (key == "nrows")        ifs >> Info.NRows;
+    else if (key == "xllcorner")    ifs >> Info.XMinimum;
+    else if (key == "yllcorner")    ifs >> Info.YMinimum;
+    else if (key == "cellsize")     ifs >> Info.DataResolution;
+    else if (key == "NODATA_value") ifs >> Info.NoDataValue;
+    else if (key == "tilesize")     ifs >> Info.TileSize;
+    else if (key == "datatype")     ifs >> datatype;
+    else if (key == "byteorder")    ifs >> byteorder;
+    else if (key == "ntiles")       ifs >> NTiles;
+    else                            ifs >> value;
+  }
+  // the tile index starts straight after the newline that ends the header
+  ifs.get();
+  if (!ifs || key != "end_header")
+  {
+    return "the header of "+Filename+" is incomplete";
+  }
+
+  if (datatype == "int32")
+  {
+    Info.IntegerData = true;
+  }
+  else if (datatype != "float32")
+  {
+    return Filename+" holds "+datatype+" data; only float32 and int32 can be read";
+  }
+  if (byteorder != "LSBFIRST" && byteorder != "MSBFIRST")
+  {
+    return Filename+" has an unknown byteorder, "+byteorder;
+  }
+  Info.ByteSwapped = (byteorder != SystemByteOrder());
+  if (Info.NRows < 0 || Info.NCols < 0 || Info.TileSize < 1 ||
+      NTiles != long(Info.NTileRows())*long(Info.NTileCols()))
+  {
+    return "the header of "+Filename+" does not describe a valid tiled raster";
+  }
+
+  vector<uint64_t> index(2*NTiles);
+  if (NTiles > 0)
+  {
+    ifs.read(reinterpret_cast<char*>(&index[0]), streamsize(index.size()*sizeof(uint64_t)));
+  }
+  if (!ifs)
+  {
+    return "the tile index of "+Filename+" is incomplete";
+  }
+  if (Info.ByteSwapped && NTiles > 0)
+  {
+    ByteSwapWords(sizeof(uint64_t), long(index.size()), &index[0]);
+  }
+
+  Info.TileOffsets.resize(NTiles);
+  Info.TileBytes.resize(NTiles);
+  for (long tile = 0; tile < NTiles; ++tile)
+  {
+    Info.TileOffsets[tile] = index[2*tile];
+    Info.TileBytes[tile] = index[2*tile+1];
+  }
+  return "";
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This decompresses a tile stored as type S and copies NRowsCopy by NColsCopy
+// of its values, starting at RowOffset and ColOffset within the tile, into Out,
+// converting them to type T. Out has OutStride values per row. The values are
+// swapped first if the tile was written with the other byte order.
+// Returns false if the tile is corrupt.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class S, class T>
+static bool decompress_tile(const vector<unsigned char>& Compressed, int TileRows,
+                            int TileCols, int RowOffset, int ColOffset, int NRowsCopy,
+                            int NColsCopy, bool ByteSwapped, T* Out, long OutStride)
+{
+  vector<S> values(size_t(TileRows)*size_t(TileCols));
+  uLongf NBytes = uLongf(values.size()*sizeof(S));
+  if (uncompress(reinterpret_cast<Bytef*>(&values[0]), &NBytes, &Compressed[0],
+                 uLong(Compressed.size())) != Z_OK || NBytes != values.size()*sizeof(S))
+  {
+    return false;
+  }
+  if (ByteSwapped)
+  {
+    ByteSwapWords(sizeof(S), long(values.size()), &values[0]);
+  }
+
+  for (int i = 0; i < NRowsCopy; ++i)
+  {
+    const S* row = &values[size_t(RowOffset+i)*size_t(TileCols)+size_t(ColOffset)];
+    T* out = Out+long(i)*OutStride;
+    for (int j = 0; j < NColsCopy; ++j)
+    {
+      out[j] = T(row[j]);
+    }
+  }
+  return true;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This does the work for both versions of read_tiled_raster_window.
+// The compressed tiles that overlap the window are read one after another in
+// file order, and then decompressed in parallel. The tiles do not overlap, so
+// each one fills its own part of the buffer.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+static string read_tiled_window(string Filename, const LSDTiledRasterInfo& Info,
+                                int FirstRow, int FirstCol, int WindowRows,
+                                int WindowCols, T* Buffer)
+{
+  if (FirstRow < 0 || FirstCol < 0 || WindowRows < 1 || WindowCols < 1 ||
+      FirstRow+WindowRows > Info.NRows || FirstCol+WindowCols > Info.NCols)
+  {
+    return "the window does not fit in "+Filename;
+  }
+
+  // the tiles that overlap the window
+  int NTileCols = Info.NTileCols();
+  vector<long> tiles;
+  for (int tile_row = FirstRow/Info.TileSize;
+       tile_row <= (FirstRow+WindowRows-1)/Info.TileSize; ++tile_row)
+  {
+    for (int tile_col = FirstCol/Info.TileSize;
+         tile_col <= (FirstCol+WindowCols-1)/Info.TileSize; ++tile_col)
+    {
+      tiles.push_back(long(tile_row)*long(NTileCols)+long(tile_col));
+    }
+  }
+
+  ifstream ifs(Filename.c_str(), ios::in | ios::binary);
+  vector< vector<unsigned char> > compressed(tiles.size());
+  for (size_t t = 0; t < tiles.size() && ifs; ++t)
+  {
+    unsigned long long NBytes = Info.TileBytes[tiles[t]];
+    if (NBytes > 0)
+    {
+      compressed[t].resize(NBytes);
+      ifs.seekg(streamoff(Info.TileOffsets[tiles[t]]));
+      ifs.read(reinterpret_cast<char*>(&compressed[t][0]), streamsize(NBytes));
+    }
+  }
+  if (!ifs)
+  {
+    return "the file \""+Filename+"\" doesn't exist or is shorter than its tile index states";
+  }
+
+  long n_corrupt = 0;
+  #pragma omp parallel for schedule(dynamic) reduction(+:n_corrupt)
+  for (long t = 0; t < long(tiles.size()); ++t)
+  {
+    int tile_first_row, tile_first_col, tile_rows, tile_cols;
+    get_tile_extent(Info, int(tiles[t]/NTileCols), int(tiles[t]%NTileCols),
+                    tile_first_row, tile_first_col, tile_rows, tile_cols);
+
+    // the part of the tile inside the window
+    int first_row = max(tile_first_row, FirstRow);
+    int first_col = max(tile_first_col, FirstCol);
+    int n_rows = min(tile_first_row+tile_rows, FirstRow+WindowRows)-first_row;
+    int n_cols = min(tile_first_col+tile_cols, FirstCol+WindowCols)-first_col;
+    T* out = Buffer+long(first_row-FirstRow)*long(WindowCols)+long(first_col-FirstCol);
+
+    bool ok = true;
+    if (compressed[t].empty())
+    {
+      for (int i = 0; i < n_rows; ++i)
+      {
+        fill(out+long(i)*long(WindowCols), out+long(i)*long(WindowCols)+n_cols,
+             T(Info.NoDataValue));
+      }
+    }
+    else if (Info.IntegerData)
+    {
+      ok = decompress_tile<int32_t,T>(compressed[t], tile_rows, tile_cols,
+                                      first_row-tile_first_row, first_col-tile_first_col,
+                                      n_rows, n_cols, Info.ByteSwapped, out, WindowCols);
+    }
+    else
+    {
+      ok = decompress_tile<float,T>(compressed[t], tile_rows, tile_cols,
+                                    first_row-tile_first_row, first_col-tile_first_col,
+                                    n_rows, n_cols, Info.ByteSwapped, out, WindowCols);
+    }
+    if (!ok)
+    {
+      ++n_corrupt;
+    }
+  }
+  if (n_corrupt > 0)
+  {
+    return Filename+" has corrupt tiles";
+  }
+  return "";
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_tiled_raster_window
+// These read a window of a tiled raster, see read_tiled_window
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string read_tiled_raster_window(string Filename, const LSDTiledRasterInfo& Info,
+                                int FirstRow, int FirstCol, int WindowRows,
+                                int WindowCols, float* Buffer)
+{
+  return read_tiled_window(Filename, Info, FirstRow, FirstCol, WindowRows, WindowCols, Buffer);
+}
+
+string read_tiled_raster_window(string Filename, const LSDTiledRasterInfo& Info,
+                                int FirstRow, int FirstCol, int WindowRows,
+                                int WindowCols, int* Buffer)
+{
+  return read_tiled_window(Filename, Info, FirstRow, FirstCol, WindowRows, WindowCols, Buffer);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// read_tiled_raster_tile
+// These read a single tile, which is just a window that matches the tile
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+static string read_tile(string Filename, const LSDTiledRasterInfo& Info, int TileRow,
+                        int TileCol, vector<T>& Tile)
+{
+  if (TileRow < 0 || TileCol < 0 || TileRow >= Info.NTileRows() || TileCol >= Info.NTileCols())
+  {
+    return "there is no such tile in "+Filename;
+  }
+  int first_row, first_col, tile_rows, tile_cols;
+  get_tile_extent(Info, TileRow, TileCol, first_row, first_col, tile_rows, tile_cols);
+  Tile.resize(size_t(tile_rows)*size_t(tile_cols));
+  return read_tiled_window(Filename, Info, first_row, first_col, tile_rows, tile_cols, &Tile[0]);
+}
+
+string read_tiled_raster_tile(string Filename, const LSDTiledRasterInfo& Info,
+                              int TileRow, int TileCol, vector<float>& Tile)
+{
+  return read_tile(Filename, Info, TileRow, TileCol, Tile);
+}
+
+string read_tiled_raster_tile(string Filename, const LSDTiledRasterInfo& Info,
+                              int TileRow, int TileCol, vector<int>& Tile)
+{
+  return read_tile(Filename, Info, TileRow, TileCol, Tile);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This does the work for both versions of write_tiled_raster.
+// The tiles are gathered and compressed in parallel. Tiles that hold nothing
+// but NoData are not compressed at all; they get zero bytes in the tile index.
+// The header, index and tiles are then written out in order.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class S>
+static string write_tiles(string Filename, LSDTiledRasterInfo& Info, const S* Data)
+{
+  if (Info.TileSize < 1)
+  {
+    Info.TileSize = LSDDefaultTileSize;
+  }
+  int NTileCols = Info.NTileCols();
+  long NTiles = long(Info.NTileRows())*long(NTileCols);
+  const S NoData = S(Info.NoDataValue);
+
+  vector< vector<unsigned char> > compressed(NTiles);
+  long n_failed = 0;
+  #pragma omp parallel for schedule(dynamic) reduction(+:n_failed)
+  for (long tile = 0; tile < NTiles; ++tile)
+  {
+    int first_row, first_col, tile_rows, tile_cols;
+    get_tile_extent(Info, int(tile/NTileCols), int(tile%NTileCols),
+                    first_row, first_col, tile_rows, tile_cols);
+
+    // gather the tile, noting whether it holds anything but NoData
+    vector<S> values(size_t(tile_rows)*size_t(tile_cols));
+    bool all_nodata = true;
+    for (int i = 0; i < tile_rows; ++i)
+    {
+      const S* row = Data+long(first_row+i)*long(Info.NCols)+long(first_col);
+      S* value = &values[size_t(i)*size_t(tile_cols)];
+      for (int j = 0; j < tile_cols; ++j)
+      {
+        value[j] = row[j];
+        if (row[j] != NoData)
+        {
+          all_nodata = false;
+        }
+      }
+    }
+    if (all_nodata)
+    {
+      continue;
+    }
+
+    uLong NBytesIn = uLong(values.size()*sizeof(S));
+    uLongf NBytes = compressBound(NBytesIn);
+    compressed[tile].resize(NBytes);
+    if (compress2(&compressed[tile][0], &NBytes, reinterpret_cast<const Bytef*>(&values[0]),
+                  NBytesIn, Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+      ++n_failed;
+    }
+    compressed[tile].resize(NBytes);
+  }
+  if (n_failed > 0)
+  {
+    return "unable to compress the tiles of "+Filename;
+  }
+
+  ostringstream header;
+  header << "LSDTILED      1"
+         << "\nncols         " << Info.NCols
+         << "\nnrows         " << Info.NRows
+         << "\nxllcorner     " << setprecision(14) << Info.XMinimum
+         << "\nyllcorner     " << setprecision(14) << Info.YMinimum
+         << "\ncellsize      " << Info.DataResolution
+         << "\nNODATA_value  " << Info.NoDataValue
+         << "\ntilesize      " << Info.TileSize
+         << "\ndatatype      " << (Info.IntegerData ? "int32" : "float32")
+         << "\nbyteorder     " << SystemByteOrder()
+         << "\nntiles        " << NTiles
+         << "\nend_header" << endl;
+  string header_text = header.str();
+
+  // the tiles follow the index
+  Info.ByteSwapped = false;
+  Info.TileOffsets.assign(NTiles, 0);
+  Info.TileBytes.assign(NTiles, 0);
+  vector<uint64_t> index(2*NTiles, 0);
+  unsigned long long offset = header_text.size()+index.size()*sizeof(uint64_t);
+  for (long tile = 0; tile < NTiles; ++tile)
+  {
+    if (!compressed[tile].empty())
+    {
+      Info.TileOffsets[tile] = offset;
+      Info.TileBytes[tile] = compressed[tile].size();
+      offset += compressed[tile].size();
+    }
+    index[2*tile] = Info.TileOffsets[tile];
+    index[2*tile+1] = Info.TileBytes[tile];
+  }
+
+  ofstream data_ofs(Filename.c_str(), ios::out | ios::binary);
+  data_ofs.write(header_text.c_str(), streamsize(header_text.size()));
+  if (NTiles > 0)
+  {
+    data_ofs.write(reinterpret_cast<const char*>(&index[0]),
+                   streamsize(index.size()*sizeof(uint64_t)));
+  }
+  for (long tile = 0; tile < NTiles; ++tile)
+  {
+    if (!compressed[tile].empty())
+    {
+      data_ofs.write(reinterpret_cast<const char*>(&compressed[tile][0]),
+                     streamsize(compressed[tile].size()));
+    }
+  }
+  data_ofs.close();
+  if (data_ofs.fail())
+  {
+    return "unable to write to "+Filename;
+  }
+  return "";
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// write_tiled_raster
+// These write float and integer rasters, see write_tiles
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string write_tiled_raster(string Filename, LSDTiledRasterInfo Info, const float* Data)
+{
+  Info.IntegerData = false;
+  return write_tiles(Filename, Info, Data);
+}
+
+string write_tiled_raster(string Filename, LSDTiledRasterInfo Info, const int* Data)
+{
+  Info.IntegerData = true;
+  return write_tiles(Filename, Info, reinterpret_cast<const int32_t*>(Data));
+}
+
+#endif
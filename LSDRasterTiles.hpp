@@ -0,0 +1,196 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterTiles
+// Land Surface Dynamics Tiled Rasters
+//
+// A collection of routines for reading and writing rasters in a tiled, zlib
+// compressed format used by the Edinburgh Land Surface Dynamics group
+// topographic toolbox. Each tile is compressed on its own so that any part of
+// a raster can be read without decompressing the rest of it.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+/** @file LSDRasterTiles.hpp
+@brief Reading and writing of tiled, zlib compressed rasters (extension .lzt).
+@details An .lzt file starts with a text header in the style of an ArcMap .hdr
+file, with a few extra fields:
+
+@verbatim
+LSDTILED      1
+ncols         420
+nrows         360
+xllcorner     0
+yllcorner     0
+cellsize      10
+NODATA_value  -9999
+tilesize      256
+datatype      float32
+byteorder     LSBFIRST
+ntiles        4
+end_header
+@endverbatim
+
+The header is followed by the tile index, which holds two unsigned 64 bit
+integers for each tile: the offset of the tile from the start of the file and
+the number of compressed bytes. The tiles cover the raster in row major order,
+starting at the north west corner, and the tiles on the southern and eastern
+edges are cut short to fit the raster. Each tile is its rows of values in row
+major order compressed with zlib. A tile with no compressed bytes holds nothing
+but NoData and is not stored at all, which is what makes sparse rasters such as
+channel heads or stream orders so small.
+
+datatype is float32 for LSDRaster and int32 for LSDIndexRaster. Either type can
+be read into either class; the values are converted as they are for .flt files.
+The tile index and values are in the byte order given by byteorder, which is the
+byte order of the system that wrote the file; they are swapped when read on a
+system with the other byte order.
+
+@date 16/10/26
+*/
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#ifndef LSDRasterTiles_H
+#define LSDRasterTiles_H
+
+/// @brief The georeferencing, layout and tile index of an .lzt file.
+/// @details A default constructed info describes an empty float raster.
+struct LSDTiledRasterInfo
+{
+  /// Number of rows.
+  int NRows = 0;
+  /// Number of columns.
+  int NCols = 0;
+  /// Minimum X coordinate.
+  float XMinimum = 0;
+  /// Minimum Y coordinate.
+  float YMinimum = 0;
+  /// Data resolution.
+  float DataResolution = 0;
+  /// No data value.
+  int NoDataValue = -9999;
+  /// The number of rows and columns in a full tile.
+  int TileSize = 0;
+  /// True if the values are stored as int32, false for float32.
+  bool IntegerData = false;
+  /// True if the file was written with the other byte order to this system's.
+  /// The tile index and values are swapped as they are read.
+  bool ByteSwapped = false;
+  /// Offset of each tile from the start of the file.
+  vector<unsigned long long> TileOffsets;
+  /// Number of compressed bytes in each tile; zero for an all NoData tile.
+  vector<unsigned long long> TileBytes;
+
+  /// @return The number of rows of tiles.
+  int NTileRows() const { return (NRows+TileSize-1)/TileSize; }
+  /// @return The number of columns of tiles.
+  int NTileCols() const { return (NCols+TileSize-1)/TileSize; }
+};
+
+/// @brief The default number of rows and columns in a tile.
+const int LSDDefaultTileSize = 256;
+
+/// @brief Reads the header and tile index of an .lzt file.
+/// @param Filename The full name of the file, including the extension.
+/// @param Info Filled in from the file.
+/// @return A description of what went wrong, or an empty string on success.
+/// @date 16/10/26
+string read_tiled_raster_info(string Filename, LSDTiledRasterInfo& Info);
+
+/// @brief Reads a window of WindowRows by WindowCols cells, starting at FirstRow
+/// and FirstCol, out of an .lzt file. Only the tiles that overlap the window are
+/// read and decompressed; the tiles are decompressed in parallel.
+/// @param Filename The full name of the file, including the extension.
+/// @param Info The header of the file, from read_tiled_raster_info.
+/// @param FirstRow The first row of the window. Row 0 is the northern edge.
+/// @param FirstCol The first column of the window.
+/// @param WindowRows The number of rows in the window.
+/// @param WindowCols The number of columns in the window.
+/// @param Buffer Space for WindowRows*WindowCols values, filled in row major order.
+/// @return A description of what went wrong, or an empty string on success.
+/// @date 16/10/26
+string read_tiled_raster_window(string Filename, const LSDTiledRasterInfo& Info,
+                                int FirstRow, int FirstCol, int WindowRows,
+                                int WindowCols, float* Buffer);
+/// @brief Reads a window out of an .lzt file into integers. See the float version.
+/// @date 16/10/26
+string read_tiled_raster_window(string Filename, const LSDTiledRasterInfo& Info,
+                                int FirstRow, int FirstCol, int WindowRows,
+                                int WindowCols, int* Buffer);
+
+/// @brief Reads a single tile out of an .lzt file.
+/// @details The tile is Info.TileSize square unless it is on the southern or
+/// eastern edge of the raster, in which case it is cut short to fit.
+/// @param Filename The full name of the file, including the extension.
+/// @param Info The header of the file, from read_tiled_raster_info.
+/// @param TileRow The row of the tile, from 0 to Info.NTileRows()-1.
+/// @param TileCol The column of the tile, from 0 to Info.NTileCols()-1.
+/// @param Tile Overwritten with the values of the tile in row major order.
+/// @return A description of what went wrong, or an empty string on success.
+/// @date 16/10/26
+string read_tiled_raster_tile(string Filename, const LSDTiledRasterInfo& Info,
+                              int TileRow, int TileCol, vector<float>& Tile);
+/// @brief Reads a single tile out of an .lzt file into integers.
+/// See the float version.
+/// @date 16/10/26
+string read_tiled_raster_tile(string Filename, const LSDTiledRasterInfo& Info,
+                              int TileRow, int TileCol, vector<int>& Tile);
+
+/// @brief Writes a raster to an .lzt file. The tiles are compressed in parallel.
+/// @param Filename The full name of the file, including the extension.
+/// @param Info The georeferencing and tile size of the raster. The data type and
+/// the tile index are filled in here.
+/// @param Data The NRows*NCols values of the raster in row major order.
+/// @return A description of what went wrong, or an empty string on success.
+/// @date 16/10/26
+string write_tiled_raster(string Filename, LSDTiledRasterInfo Info, const float* Data);
+/// @brief Writes integer data to an .lzt file. See the float version.
+/// @date 16/10/26
+string write_tiled_raster(string Filename, LSDTiledRasterInfo Info, const int* Data);
+
+#endif
@@ -0,0 +1,210 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterWriteQueue
+// Land Surface Dynamics Raster Write Queue
+//
+// A background writer for the Edinburgh Land Surface Dynamics group topographic
+// toolbox. Raster writes can be queued so that the program carries on with its
+// analysis while the files go to disk.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "LSDRasterWriteQueue.hpp"
+using namespace std;
+
+#ifndef LSDRasterWriteQueue_CPP
+#define LSDRasterWriteQueue_CPP
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The queue shared by all rasters, along with the background thread that
+// drains it. Jobs are run one at a time in the order they were queued, so
+// two writes to the same file end up in the order the program asked for.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+class RasterWriteQueue
+{
+  public:
+  RasterWriteQueue() : Busy(false), Stopping(false) {}
+
+  // carry out anything still queued before the program exits
+  ~RasterWriteQueue()
+  {
+    {
+      unique_lock<mutex> lock(Mutex);
+      Stopping = true;
+    }
+    WorkAvailable.notify_all();
+    if (Writer.joinable())
+    {
+      Writer.join();
+    }
+    report_errors();
+  }
+
+  void push(string description, function<string()> write)
+  {
+    {
+      unique_lock<mutex> lock(Mutex);
+      Jobs.push_back(make_pair(description, write));
+      if (!Writer.joinable())
+      {
+        Writer = thread(&RasterWriteQueue::drain, this);
+      }
+    }
+    WorkAvailable.notify_one();
+  }
+
+  int flush()
+  {
+    {
+      unique_lock<mutex> lock(Mutex);
+      WorkDone.wait(lock, [this]() { return Jobs.empty() && !Busy; });
+    }
+    return report_errors();
+  }
+
+  private:
+  // the loop run by the background thread
+  void drain()
+  {
+    unique_lock<mutex> lock(Mutex);
+    while (true)
+    {
+      WorkAvailable.wait(lock, [this]() { return !Jobs.empty() || Stopping; });
+      if (Jobs.empty())
+      {
+        return;
+      }
+
+      pair<string, function<string()> > job = Jobs.front();
+      Jobs.pop_front();
+      Busy = true;
+      lock.unlock();
+
+      string error;
+      try
+      {
+        error = job.second();
+      }
+      catch (exception& e)
+      {
+        error = e.what();
+      }
+      string description = job.first;
+      // the job holds the copy of the raster, so let it go before taking the lock
+      job = pair<string, function<string()> >();
+
+      lock.lock();
+      if (!error.empty())
+      {
+        Errors.push_back(description+": "+error);
+      }
+      Busy = false;
+      if (Jobs.empty())
+      {
+        WorkDone.notify_all();
+      }
+    }
+  }
+
+  // prints and clears the errors gathered since the last flush
+  int report_errors()
+  {
+    vector<string> errors;
+    {
+      unique_lock<mutex> lock(Mutex);
+      errors.swap(Errors);
+    }
+    for (int i = 0; i < int(errors.size()); ++i)
+    {
+      cout << "ERROR: background raster write failed: " << errors[i] << endl;
+    }
+    return int(errors.size());
+  }
+
+  mutex Mutex;
+  condition_variable WorkAvailable;
+  condition_variable WorkDone;
+  deque< pair<string, function<string()> > > Jobs;
+  vector<string> Errors;
+  bool Busy;
+  bool Stopping;
+  thread Writer;
+};
+
+static RasterWriteQueue WriteQueue;
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Queues a write and returns straight away
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void queue_raster_write(string description, function<string()> write)
+{
+  WriteQueue.push(description, write);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Waits for the queued writes and reports those that failed
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+int flush_raster_writes()
+{
+  return WriteQueue.flush();
+}
+
+#endif
@@ -0,0 +1,88 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDRasterWriteQueue
+// Land Surface Dynamics Raster Write Queue
+//
+// A background writer for the Edinburgh Land Surface Dynamics group topographic
+// toolbox. Raster writes can be queued so that the program carries on with its
+// analysis while the files go to disk.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+/** @file LSDRasterWriteQueue.hpp
+@brief Background writer for rasters.
+@details LSDRaster::write_raster_async and LSDIndexRaster::write_raster_async
+queue their writes here. The writes are carried out in order by a single
+background thread, which is started when the first write is queued.
+flush_raster_writes() waits for all the queued writes and reports the ones that
+failed.
+
+@date 16/10/26
+*/
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <string>
+#include <functional>
+using namespace std;
+
+#ifndef LSDRasterWriteQueue_H
+#define LSDRasterWriteQueue_H
+
+/// @brief Queues a write to be carried out by the background writer.
+/// @param description The name of the file being written, used when reporting errors.
+/// @param write The write itself. It returns an empty string on success and a
+/// description of the problem otherwise. Anything it uses must stay valid until
+/// it has run, which is why the rasters queue a copy of themselves.
+/// @date 16/10/26
+void queue_raster_write(string description, function<string()> write);
+
+/// @brief Waits until every queued write has been carried out.
+/// @details Each write that failed since the last flush is reported.
+/// Writes still queued when the program ends are carried out before it exits.
+/// @return The number of writes that failed.
+/// @date 16/10/26
+int flush_raster_writes();
+
+#endif
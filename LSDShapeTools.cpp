@@ -59,6 +59,12 @@
 #include <cstring>
 #include <vector>
 #include <fstream>
+#include <charconv>
+#include <cctype>
+#include <stdint.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 #include "LSDShapeTools.hpp"
 using namespace std;
 
@@ -126,6 +132,131 @@ void ByteSwap(int length, void * ByteData){
     }
     
 }    
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Swaps the bytes of NWords 4 byte words. With SSSE3 four words are reversed by each
+// byte shuffle; otherwise the loop is simple enough for the compiler to vectorise.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void ByteSwapWords4(long NWords, BYTE * ByteData){
+
+  long i = 0;
+#ifdef __SSSE3__
+  const __m128i reverse = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+  for (; i+4 <= NWords; i += 4){
+    __m128i words = _mm_loadu_si128((__m128i *) (ByteData+4*i));
+    _mm_storeu_si128((__m128i *) (ByteData+4*i), _mm_shuffle_epi8(words, reverse));
+  }
+#endif
+  for (; i < NWords; ++i){
+    uint32_t word;
+    memcpy(&word, ByteData+4*i, 4);
+    word = __builtin_bswap32(word);
+    memcpy(ByteData+4*i, &word, 4);
+  }
+
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Swaps the bytes of NWords 8 byte words.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static void ByteSwapWords8(long NWords, BYTE * ByteData){
+
+  long i = 0;
+#ifdef __SSSE3__
+  const __m128i reverse = _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+  for (; i+2 <= NWords; i += 2){
+    __m128i words = _mm_loadu_si128((__m128i *) (ByteData+8*i));
+    _mm_storeu_si128((__m128i *) (ByteData+8*i), _mm_shuffle_epi8(words, reverse));
+  }
+#endif
+  for (; i < NWords; ++i){
+    uint64_t word;
+    memcpy(&word, ByteData+8*i, 8);
+    word = __builtin_bswap64(word);
+    memcpy(ByteData+8*i, &word, 8);
+  }
+
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to swap the byte order of a block of words. The block is cut into chunks
+// of 64k words which are swapped in parallel.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void ByteSwapWords(int length, long NWords, void * ByteData){
+
+  const long ChunkWords = 65536;
+  long NChunks = (NWords+ChunkWords-1)/ChunkWords;
+
+  #pragma omp parallel for schedule(static)
+  for (long chunk = 0; chunk < NChunks; ++chunk){
+
+    long first = chunk*ChunkWords;
+    long n_words = (first+ChunkWords <= NWords) ? ChunkWords : NWords-first;
+    BYTE * words = ((BYTE *) ByteData)+first*long(length);
+
+    if (length == 4){
+      ByteSwapWords4(n_words, words);
+    }
+    else if (length == 8){
+      ByteSwapWords8(n_words, words);
+    }
+    else{
+      for (long i = 0; i < n_words; ++i){
+        ByteSwap(length, words+i*long(length));
+      }
+    }
+  }
+
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read the fields after the six standard fields of a .hdr file, looking
+// for byteorder. ESRI writes LSBFIRST or MSBFIRST; I and M, as used in .bil headers,
+// are accepted too.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool HeaderNeedsByteSwap(istream& Header){
+
+  string Key;
+  string Value;
+  bool NeedsSwap = false;
+  while (Header >> Key >> Value){
+    for (size_t i = 0; i < Key.size(); ++i){
+      Key[i] = tolower(Key[i]);
+    }
+    if (Key == "byteorder"){
+      bool FileIsLittleEndian = (Value == "LSBFIRST" || Value == "I");
+      bool FileIsBigEndian = (Value == "MSBFIRST" || Value == "M");
+      if (FileIsLittleEndian || FileIsBigEndian){
+        NeedsSwap = (FileIsLittleEndian != SystemEndiannessTest());
+      }
+      else{
+        cout << "WARNING: unknown byteorder " << Value
+             << ", assuming the data are in this system's byte order" << endl;
+      }
+    }
+  }
+  return NeedsSwap;
+
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to get the byteorder field for data written by this system.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string SystemByteOrder(){
+
+  return SystemEndiannessTest() ? "LSBFIRST" : "MSBFIRST";
+
+}
  
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Method to get the size of the binary file being loaded.
@@ -143,6 +274,249 @@ long getFileSize(FILE *file){
 	return lEndPos;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a block of binary data, such as the body of a .flt raster, straight
+// into a preallocated buffer in a single read operation. Returns false if the file
+// cannot be opened or holds fewer than NBytes bytes.
+//
+// The stdio buffer is switched off: the block is read in one go, so staging it
+// through an intermediate buffer would only add a copy.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadBinaryBlock(string Filename, void * Buffer, long NBytes){
+
+  FILE *file = NULL;
+  if ((file = fopen(Filename.c_str(), "rb")) == NULL){
+    return false;
+  }
+  setvbuf(file, NULL, _IONBF, 0);
+
+  size_t BytesRead = fread(Buffer, 1, size_t(NBytes), file);
+  fclose(file);
+
+  return (long(BytesRead) == NBytes);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a rectangular window out of a row major binary grid with NColsFile
+// columns of WordSize byte values. Each row of the window is read with a single
+// read after seeking to its first value, so nothing outside the window is read.
+// Returns false if the file cannot be opened or is too short.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadBinaryWindow(string Filename, void * Buffer, int FirstRow, int FirstCol,
+                      int WindowRows, int WindowCols, int NColsFile, int WordSize){
+
+  FILE *file = NULL;
+  if ((file = fopen(Filename.c_str(), "rb")) == NULL){
+    return false;
+  }
+  setvbuf(file, NULL, _IONBF, 0);
+
+  size_t RowBytes = size_t(WindowCols)*size_t(WordSize);
+  BYTE * RowData = (BYTE *) Buffer;
+  bool Success = true;
+
+  for (int row = 0; row < WindowRows && Success; ++row){
+    long Offset = (long(FirstRow+row)*long(NColsFile) + long(FirstCol))*long(WordSize);
+    if (fseek(file, Offset, SEEK_SET) != 0 || fread(RowData, 1, RowBytes, file) != RowBytes){
+      Success = false;
+    }
+    RowData += RowBytes;
+  }
+
+  fclose(file);
+  return Success;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a whole text file, such as an .asc raster, into memory in a single
+// read operation. Returns false if the file cannot be opened.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadTextFile(string Filename, vector<char>& Text){
+
+  FILE *file = NULL;
+  if ((file = fopen(Filename.c_str(), "rb")) == NULL){
+    return false;
+  }
+  long fileSize = getFileSize(file);
+  fclose(file);
+
+  Text.resize(fileSize);
+  return (fileSize == 0 || ReadBinaryBlock(Filename, &Text[0], fileSize));
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The ascii parser works on chunks of about this many bytes, which is small
+// enough to share the work out between threads and big enough that the
+// per chunk bookkeeping does not matter.
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static const long AsciiChunkBytes = 1 << 20;
+
+static inline bool IsAsciiSpace(char c){
+  return (c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f');
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The parser behind both ParseAsciiValues methods.
+//
+// A value belongs to the chunk in which it starts, and the chunk boundaries are
+// moved forward onto whitespace so no value straddles two of them. A first
+// pass counts the values in each chunk, a running sum of those counts gives
+// the index of the first value of each chunk, and a second pass parses the
+// chunks independently.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+static long ParseAsciiValuesInChunks(const char * Begin, const char * End, T * Values, long NValues){
+
+  long NBytes = long(End-Begin);
+  int NChunks = int(NBytes/AsciiChunkBytes) + 1;
+
+  vector<const char *> ChunkStart(NChunks+1);
+  ChunkStart[0] = Begin;
+  ChunkStart[NChunks] = End;
+  for (int chunk = 1; chunk < NChunks; ++chunk){
+    const char * p = Begin + long(chunk)*(NBytes/NChunks);
+    if (p < ChunkStart[chunk-1]){
+      p = ChunkStart[chunk-1];
+    }
+    while (p < End && !IsAsciiSpace(*p)){
+      ++p;
+    }
+    ChunkStart[chunk] = p;
+  }
+
+  // count the values that start in each chunk
+  vector<long> ChunkCount(NChunks,0);
+  #pragma omp parallel for schedule(static)
+  for (int chunk = 0; chunk < NChunks; ++chunk){
+    long count = 0;
+    bool in_value = false;
+    for (const char * p = ChunkStart[chunk]; p < ChunkStart[chunk+1]; ++p){
+      bool is_space = IsAsciiSpace(*p);
+      if (!is_space && !in_value){
+        ++count;
+      }
+      in_value = !is_space;
+    }
+    ChunkCount[chunk] = count;
+  }
+
+  vector<long> ChunkFirstValue(NChunks+1,0);
+  for (int chunk = 0; chunk < NChunks; ++chunk){
+    ChunkFirstValue[chunk+1] = ChunkFirstValue[chunk] + ChunkCount[chunk];
+  }
+
+  // now parse the chunks that hold values we need
+  bool BadValue = false;
+  #pragma omp parallel for schedule(static)
+  for (int chunk = 0; chunk < NChunks; ++chunk){
+    long index = ChunkFirstValue[chunk];
+    const char * p = ChunkStart[chunk];
+    const char * ChunkEnd = ChunkStart[chunk+1];
+    while (index < NValues){
+      while (p < ChunkEnd && IsAsciiSpace(*p)){
+        ++p;
+      }
+      if (p >= ChunkEnd){
+        break;
+      }
+      // >> accepts a leading plus sign but from_chars does not
+      if (*p == '+'){
+        ++p;
+      }
+      from_chars_result result = from_chars(p, End, Values[index]);
+      if (result.ec != errc() || (result.ptr < End && !IsAsciiSpace(*result.ptr))){
+        #pragma omp critical
+        BadValue = true;
+        break;
+      }
+      p = result.ptr;
+      ++index;
+    }
+  }
+
+  if (BadValue){
+    return -1;
+  }
+  return (ChunkFirstValue[NChunks] < NValues) ? ChunkFirstValue[NChunks] : NValues;
+}
+
+long ParseAsciiValues(const char * Begin, const char * End, float * Values, long NValues){
+  return ParseAsciiValuesInChunks(Begin, End, Values, NValues);
+}
+
+long ParseAsciiValues(const char * Begin, const char * End, int * Values, long NValues){
+  return ParseAsciiValuesInChunks(Begin, End, Values, NValues);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Formats a single value for an .asc file into Buffer, which must hold at least
+// 32 characters, and returns a pointer one past the last character written.
+// general format with a precision of 6 is the same as printf's %.6g, which is
+// what an ostream does for setprecision(6).
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+static inline char * FormatAsciiValue(char * Buffer, float Value){
+  return to_chars(Buffer, Buffer+32, Value, chars_format::general, 6).ptr;
+}
+
+static inline char * FormatAsciiValue(char * Buffer, int Value){
+  return to_chars(Buffer, Buffer+32, Value).ptr;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The writer behind both WriteAsciiValues methods. Each row of a block is
+// formatted by one thread into its own string; the block is then written in
+// row order, so the output does not depend on the number of threads.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+static void WriteAsciiValuesInBlocks(ostream& Out, const T * Values, int NRows, int NCols){
+
+  const int BlockRows = 256;
+  vector<string> RowText(BlockRows);
+
+  for (int first_row = 0; first_row < NRows; first_row += BlockRows){
+    int NBlockRows = (NRows-first_row < BlockRows) ? NRows-first_row : BlockRows;
+
+    #pragma omp parallel for schedule(static)
+    for (int block_row = 0; block_row < NBlockRows; ++block_row){
+      int row = first_row+block_row;
+      const T * RowValues = Values + long(row)*long(NCols);
+      string& Text = RowText[block_row];
+      Text.resize(size_t(NCols)*33 + 1);
+      char * p = &Text[0];
+      for (int col = 0; col < NCols; ++col){
+        p = FormatAsciiValue(p, RowValues[col]);
+        *p++ = ' ';
+      }
+      if (row != NRows-1){
+        *p++ = '\n';
+      }
+      Text.resize(p - &Text[0]);
+    }
+
+    for (int block_row = 0; block_row < NBlockRows; ++block_row){
+      Out.write(RowText[block_row].data(), RowText[block_row].size());
+    }
+  }
+}
+
+void WriteAsciiValues(ostream& Out, const float * Values, int NRows, int NCols){
+  WriteAsciiValuesInBlocks(Out, Values, NRows, NCols);
+}
+
+void WriteAsciiValues(ostream& Out, const int * Values, int NRows, int NCols){
+  WriteAsciiValuesInBlocks(Out, Values, NRows, NCols);
+}
+
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Method to load an ESRI ShapeFile.
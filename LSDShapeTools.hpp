@@ -51,6 +51,10 @@
 //DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
 //-----------------------------------------------------------------
 
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
 using namespace std;
 
 #ifndef ShapeTools_H
@@ -89,6 +93,34 @@ struct PointData
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 void ByteSwap(int length, void * ByteData);
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to swap the byte order of NWords consecutive words of length bytes, such as
+// the body of a raster written on a machine with the other byte order. 4 and 8 byte
+// words are swapped in bulk, several words per instruction where the compiler allows
+// it, and large blocks are split between threads. Other lengths fall back to ByteSwap.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void ByteSwapWords(int length, long NWords, void * ByteData);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read the optional fields that follow the six standard fields of an ArcMap
+// .hdr file. Returns true if the byteorder field says the data were written with a
+// different byte order to the system's. Data without a byteorder field are assumed to
+// be in the system's byte order.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool HeaderNeedsByteSwap(istream& Header);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to get the value of the byteorder field for data written by this system,
+// either LSBFIRST or MSBFIRST.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+string SystemByteOrder();
+
 
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 // Method to load an ESRI ShapeFile.
@@ -133,4 +165,62 @@ vector<PointData> LoadPolyline(string Filename);
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 long getFileSize(FILE *file);
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a block of binary data, such as the body of a .flt raster, straight
+// into a preallocated buffer in a single read operation. Returns false if the file
+// cannot be opened or holds fewer than NBytes bytes.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadBinaryBlock(string Filename, void * Buffer, long NBytes);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a rectangular window out of a row major binary grid with NColsFile
+// columns of WordSize byte values. Each row of the window is read with a single
+// read after seeking to its first value, so nothing outside the window is read.
+// Returns false if the file cannot be opened or is too short.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadBinaryWindow(string Filename, void * Buffer, int FirstRow, int FirstCol,
+                      int WindowRows, int WindowCols, int NColsFile, int WordSize);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Method to read a whole text file, such as an .asc raster, into memory in a single
+// read operation. Returns false if the file cannot be opened.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+bool ReadTextFile(string Filename, vector<char>& Text);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Methods to parse up to NValues whitespace separated numbers from the text between
+// Begin and End, such as the body of an .asc raster, into Values.
+//
+// The text is split into chunks at whitespace, the values in each chunk are counted
+// so every chunk knows where its first value goes, and the chunks are then parsed
+// in parallel with std::from_chars, which does not touch the locale. The result is
+// the same as reading the values one after another with >>.
+//
+// Returns the number of values read, which is less than NValues if the text runs
+// out, or -1 if the text holds something that is not a number.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+long ParseAsciiValues(const char * Begin, const char * End, float * Values, long NValues);
+long ParseAsciiValues(const char * Begin, const char * End, int * Values, long NValues);
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// Methods to write an NRows by NCols block of values as the body of an .asc raster:
+// every value is followed by a space and every row but the last by a newline.
+// Floats are written with 6 significant figures, exactly as setprecision(6) does.
+//
+// Rows are formatted in parallel with std::to_chars, a block at a time, and each
+// block is written out with a single call.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void WriteAsciiValues(ostream& Out, const float * Values, int NRows, int NCols);
+void WriteAsciiValues(ostream& Out, const int * Values, int NRows, int NCols);
+
 #endif
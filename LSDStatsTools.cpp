@@ -3017,6 +3017,42 @@ double get_QuadraticMean(vector<double> input_values, double bin_width)
   return QuadraticMean;
 }
 
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// The per node step of the chi batch functions. The term of a node for one
+// m over n is dx*pow(A_0/A, m_over_n) = dx*exp(m_over_n*log(A_0/A)). The
+// m over n values are evenly spaced, so the node needs only two exponentials:
+// the term of the first m over n and the step exp(d_movern*log(A_0/A)) between
+// neighbouring terms. The first n_lanes terms are built from these by
+// multiplication, and each later term is the term n_lanes before it times the
+// step to the power n_lanes, so the inner loop runs in simd lanes.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void add_chi_batch_node(float dx, float log_area_ratio, float start_movern, float d_movern,
+                        int n_movern, const float* downstream_chi, float* this_chi)
+{
+  const int n_lanes = 8;
+  float lane_term[n_lanes];
+
+  float step = exp(d_movern*log_area_ratio);
+  float lane_step = step;
+  lane_term[0] = dx*exp(start_movern*log_area_ratio);
+  for (int lane = 1; lane<n_lanes; lane++)
+  {
+    lane_term[lane] = lane_term[lane-1]*step;
+    lane_step *= step;
+  }
+  for (int first_movn = 0; first_movn<n_movern; first_movn += n_lanes)
+  {
+    int n_this_block = (n_movern-first_movn < n_lanes) ? n_movern-first_movn : n_lanes;
+    for (int lane = 0; lane<n_this_block; lane++)
+    {
+      this_chi[first_movn+lane] = lane_term[lane]+downstream_chi[first_movn+lane];
+      lane_term[lane] *= lane_step;
+    }
+  }
+}
+
 
 #endif
 
@@ -243,6 +243,12 @@ void get_distribution_stats(vector<float>& y_data, float& mean, float& median, f
 // Method to calculate the quadratic mean. - DTM
 double get_QuadraticMean(vector<double> input_values, double bin_width);
 
+// Sets the chi values of a channel node for n_movern evenly spaced values of
+// m over n, from the chi values of the node below it, the distance dx between
+// them and log(A_0/A) of the node. Used by the chi batch functions. 16/10/26
+void add_chi_batch_node(float dx, float log_area_ratio, float start_movern, float d_movern,
+                        int n_movern, const float* downstream_chi, float* this_chi);
+
 #endif
 
 
@@ -0,0 +1,233 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDTypedRaster
+// Land Surface Dynamics Typed Rasters
+//
+// Compact rasters for the Edinburgh Land Surface Dynamics group topographic
+// toolbox. A typed raster stores its cells in the smallest type that holds
+// them, for example one byte per cell for stream orders, and a mask raster
+// stores one bit per cell for binary networks and channel head masks.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <stdint.h>
+#include "TNT/tnt.h"
+#include "LSDIndexRaster.hpp"
+#include "LSDTypedRaster.hpp"
+using namespace std;
+using namespace TNT;
+
+#ifndef LSDTypedRaster_CPP
+#define LSDTypedRaster_CPP
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a mask with every cell false
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDMaskRaster::create(int nrows, int ncols, float xmin, float ymin,
+                           float cellsize, int ndv)
+{
+  NRows = nrows;
+  NCols = ncols;
+  XMinimum = xmin;
+  YMinimum = ymin;
+  DataResolution = cellsize;
+  NoDataValue = ndv;
+
+  WordsPerRow = (size_t(NCols)+63)/64;
+  Words.assign(WordsPerRow*size_t(NRows), 0);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a mask of the cells of an LSDIndexRaster that are neither 0 nor
+// NoData. Each word is built up in a register and stored once.
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDMaskRaster::create(LSDIndexRaster& IndexRaster)
+{
+  create(IndexRaster.get_NRows(), IndexRaster.get_NCols(), IndexRaster.get_XMinimum(),
+         IndexRaster.get_YMinimum(), IndexRaster.get_DataResolution(),
+         IndexRaster.get_NoDataValue());
+
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (size_t word = 0; word < WordsPerRow; ++word)
+    {
+      uint64_t bits = 0;
+      int first_col = int(word*64);
+      int last_col = (first_col+64 < NCols) ? first_col+64 : NCols;
+      for (int col = first_col; col < last_col; ++col)
+      {
+        int value = IndexRaster.get_data_element(row,col);
+        if (value != 0 && value != NoDataValue)
+        {
+          bits |= uint64_t(1) << (col-first_col);
+        }
+      }
+      Words[size_t(row)*WordsPerRow+word] = bits;
+    }
+  }
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this sets a single cell
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDMaskRaster::set_data_element(int row, int column, bool value)
+{
+  uint64_t& word = Words[size_t(row)*WordsPerRow+(column>>6)];
+  uint64_t bit = uint64_t(1) << (column&63);
+  if (value)
+  {
+    word |= bit;
+  }
+  else
+  {
+    word &= ~bit;
+  }
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// the logical operations work a word, or 64 cells, at a time
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void LSDMaskRaster::check_dimensions(const LSDMaskRaster& Other) const
+{
+  if (Other.NRows != NRows || Other.NCols != NCols)
+  {
+    cout << "\nFATAL ERROR: masks of " << NRows << " by " << NCols << " and "
+         << Other.NRows << " by " << Other.NCols << " cells cannot be combined" << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+void LSDMaskRaster::mask_and(const LSDMaskRaster& Other)
+{
+  check_dimensions(Other);
+  for (size_t i = 0; i < Words.size(); ++i)
+  {
+    Words[i] &= Other.Words[i];
+  }
+}
+
+void LSDMaskRaster::mask_or(const LSDMaskRaster& Other)
+{
+  check_dimensions(Other);
+  for (size_t i = 0; i < Words.size(); ++i)
+  {
+    Words[i] |= Other.Words[i];
+  }
+}
+
+void LSDMaskRaster::mask_xor(const LSDMaskRaster& Other)
+{
+  check_dimensions(Other);
+  for (size_t i = 0; i < Words.size(); ++i)
+  {
+    Words[i] ^= Other.Words[i];
+  }
+}
+
+// the bits past the end of each row are cleared again after inverting
+void LSDMaskRaster::invert()
+{
+  int n_spare = int(WordsPerRow*64)-NCols;
+  uint64_t last_word_bits = (n_spare > 0) ? (~uint64_t(0) >> n_spare) : ~uint64_t(0);
+  for (int row = 0; row < NRows; ++row)
+  {
+    uint64_t* words = &Words[size_t(row)*WordsPerRow];
+    for (size_t word = 0; word < WordsPerRow; ++word)
+    {
+      words[word] = ~words[word];
+    }
+    if (WordsPerRow > 0)
+    {
+      words[WordsPerRow-1] &= last_word_bits;
+    }
+  }
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this counts the true cells with a population count of each word
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+long LSDMaskRaster::count_true_cells() const
+{
+  long n_true = 0;
+  for (size_t i = 0; i < Words.size(); ++i)
+  {
+    n_true += __builtin_popcountll(Words[i]);
+  }
+  return n_true;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this converts the mask to a binary LSDIndexRaster
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+LSDIndexRaster LSDMaskRaster::to_LSDIndexRaster() const
+{
+  Array2D<int> data(NRows,NCols);
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (int col = 0; col < NCols; ++col)
+    {
+      data[row][col] = get_data_element(row,col) ? 1 : 0;
+    }
+  }
+  return LSDIndexRaster(NRows, NCols, XMinimum, YMinimum, DataResolution, NoDataValue, data);
+}
+
+#endif
@@ -0,0 +1,502 @@
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// LSDTypedRaster
+// Land Surface Dynamics Typed Rasters
+//
+// Compact rasters for the Edinburgh Land Surface Dynamics group topographic
+// toolbox. A typed raster stores its cells in the smallest type that holds
+// them, for example one byte per cell for stream orders, and a mask raster
+// stores one bit per cell for binary networks and channel head masks.
+//
+// Developed by:
+//  Simon M. Mudd
+//  Martin D. Hurst
+//  David T. Milodowski
+//  Stuart W.D. Grieve
+//  Declan A. Valters
+//  Fiona Clubb
+//
+// Copyright (C) 2013 Simon M. Mudd 2013
+//
+// Developer can be contacted by simon.m.mudd _at_ ed.ac.uk
+//
+//    Simon Mudd
+//    University of Edinburgh
+//    School of GeoSciences
+//    Drummond Street
+//    Edinburgh, EH8 9XP
+//    Scotland
+//    United Kingdom
+//
+// This program is free software;
+// you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation;
+// either version 2 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY;
+// without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU General Public License for more details.
+//
+// You should have received a copy of the
+// GNU General Public License along with this program;
+// if not, write to:
+// Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor,
+// Boston, MA 02110-1301
+// USA
+//
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+
+/** @file LSDTypedRaster.hpp
+@brief Compact rasters: a template for rasters of any element type, and a bit
+packed mask raster.
+@details LSDIndexRaster stores 4 byte ints and LSDRaster 4 byte floats whatever
+their contents. LSDTypedRaster holds the same georeferencing with cells of type
+T, so that, for example, a stream order raster held as an LSDByteRaster takes a
+quarter of the memory. LSDMaskRaster holds one bit per cell, and its logical
+operations work on 64 cells at a time.
+
+Both convert to and from LSDIndexRaster and LSDRaster, which remain the types
+used by the rest of the toolbox, and they are written to file through them.
+
+@date 16/10/26
+*/
+
+//-----------------------------------------------------------------
+//DOCUMENTATION URL: http://www.geos.ed.ac.uk/~s0675405/LSD_Docs/
+//-----------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#include <stdint.h>
+#include <type_traits>
+#include "TNT/tnt.h"
+#include "LSDRasterStorage.hpp"
+#include "LSDIndexRaster.hpp"
+#include "LSDRaster.hpp"
+using namespace std;
+using namespace TNT;
+
+#ifndef LSDTypedRaster_H
+#define LSDTypedRaster_H
+
+/// @brief Object to handle rasters with cells of type T.
+/// @details T is one of the integer types or float. NoData cells are stored as
+/// get_NoDataElement(), which is the no data value if T can hold it and the
+/// largest value of T otherwise (255 for an LSDByteRaster with the usual no data
+/// value of -9999). The no data value itself is kept for writing the raster.
+template <class T>
+class LSDTypedRaster
+{
+  public:
+  /// @brief Create an LSDTypedRaster from memory.
+  /// @param nrows An integer of the number of rows.
+  /// @param ncols An integer of the number of columns.
+  /// @param xmin A float of the minimum X coordinate.
+  /// @param ymin A float of the minimum Y coordinate.
+  /// @param cellsize A float of the cellsize.
+  /// @param ndv An integer of the no data value.
+  /// @param data An Array2D of type T in the shape nrows*ncols. NoData cells
+  /// must hold the element returned by get_NoDataElement().
+  /// @date 16/10/26
+  LSDTypedRaster(int nrows, int ncols, float xmin, float ymin,
+                 float cellsize, int ndv, Array2D<T> data)
+                          { create(nrows, ncols, xmin, ymin, cellsize, ndv, data); }
+
+  /// @brief Create an LSDTypedRaster from an LSDIndexRaster. It is a fatal
+  /// error for any cell that is not NoData to be out of the range of T.
+  /// @param IndexRaster The raster to be converted.
+  /// @date 16/10/26
+  LSDTypedRaster(LSDIndexRaster& IndexRaster)     { create(IndexRaster); }
+
+  /// @brief Create an LSDTypedRaster from an LSDRaster. Values are converted to
+  /// T as floats are converted to ints when an LSDIndexRaster reads a .flt file.
+  /// It is a fatal error for any cell that is not NoData to be out of the range of T.
+  /// @param Raster The raster to be converted.
+  /// @date 16/10/26
+  LSDTypedRaster(LSDRaster& Raster)               { create(Raster); }
+
+  // Get functions
+
+  /// @return Number of rows as an integer.
+  int get_NRows() const               { return NRows; }
+  /// @return Number of columns as an integer.
+  int get_NCols() const               { return NCols; }
+  /// @return Minimum X coordinate as a float.
+  float get_XMinimum() const          { return XMinimum; }
+  /// @return Minimum Y coordinate as a float.
+  float get_YMinimum() const          { return YMinimum; }
+  /// @return Data resolution as a float.
+  float get_DataResolution() const    { return DataResolution; }
+  /// @return No Data Value as an integer.
+  int get_NoDataValue() const         { return NoDataValue; }
+  /// @return The value of T that NoData cells hold.
+  T get_NoDataElement() const         { return NoDataElement; }
+  /// @return Raster values as a 2D Array. This is a copy, as in
+  /// LSDIndexRaster::get_RasterData.
+  Array2D<T> get_RasterData() const { return RasterData.copy(); }
+
+  /// @brief Get the raster data at a specified location.
+  /// @param row An integer, the row of the target cell.
+  /// @param column An integer, the column of the target cell.
+  /// @return The raster value at the position (row, column).
+  /// @date 16/10/26
+  T get_data_element(int row, int column) const   { return RasterData[row][column]; }
+
+  /// @return The number of bytes taken by the cells of the raster.
+  /// @date 16/10/26
+  size_t get_data_bytes() const       { return size_t(NRows)*size_t(NCols)*sizeof(T); }
+
+  /// @brief Converts the raster to an LSDIndexRaster.
+  /// @return An LSDIndexRaster with the same cells, NoData cells holding the no
+  /// data value.
+  /// @date 16/10/26
+  LSDIndexRaster to_LSDIndexRaster() const;
+
+  /// @brief Converts the raster to an LSDRaster.
+  /// @return An LSDRaster with the same cells, NoData cells holding the no
+  /// data value.
+  /// @date 16/10/26
+  LSDRaster to_LSDRaster() const;
+
+  /// @brief Writes the raster. Float rasters are written as an LSDRaster and
+  /// all others as an LSDIndexRaster, so the formats are the same as theirs.
+  /// @param filename a string of the filename _without_ the extension.
+  /// @param extension a string of the extension _without_ the leading dot
+  /// @date 16/10/26
+  void write_raster(string filename, string extension) const;
+
+  protected:
+  ///Number of rows.
+  int NRows;
+  ///Number of columns.
+  int NCols;
+  ///Minimum X coordinate.
+  float XMinimum;
+  ///Minimum Y coordinate.
+  float YMinimum;
+
+  ///Data resolution.
+  float DataResolution;
+  ///No data value.
+  int NoDataValue;
+  ///The value of T that NoData cells hold.
+  T NoDataElement;
+
+  /// Raster data.
+  Array2D<T> RasterData;
+
+  /// @brief Keeps the scratch file behind RasterData mapped. Empty when
+  /// RasterData lives on the heap. See LSDRasterStorage.hpp.
+  LSDStorageHandle RasterDataStorage;
+
+  private:
+  void create(int nrows, int ncols, float xmin, float ymin,
+              float cellsize, int ndv, Array2D<T> data);
+  void create(LSDIndexRaster& IndexRaster);
+  void create(LSDRaster& Raster);
+
+  void set_georeferencing(int nrows, int ncols, float xmin, float ymin,
+                          float cellsize, int ndv);
+  template <class S> T convert_cell(S value, int row, int col) const;
+};
+
+/// @brief A raster of one byte cells, such as stream orders.
+typedef LSDTypedRaster<uint8_t> LSDByteRaster;
+/// @brief A raster of two byte integer cells.
+typedef LSDTypedRaster<int16_t> LSDShortRaster;
+/// @brief A raster of four byte integer cells; the same cells as an LSDIndexRaster.
+typedef LSDTypedRaster<int32_t> LSDIntRaster;
+/// @brief A raster of float cells; the same cells as an LSDRaster.
+typedef LSDTypedRaster<float> LSDFloatRaster;
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This sets the georeferencing and picks the element that NoData cells hold
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+void LSDTypedRaster<T>::set_georeferencing(int nrows, int ncols, float xmin, float ymin,
+                                           float cellsize, int ndv)
+{
+  NRows = nrows;
+  NCols = ncols;
+  XMinimum = xmin;
+  YMinimum = ymin;
+  DataResolution = cellsize;
+  NoDataValue = ndv;
+
+  if (is_floating_point<T>::value ||
+      (double(ndv) >= double(numeric_limits<T>::lowest()) &&
+       double(ndv) <= double(numeric_limits<T>::max())))
+  {
+    NoDataElement = T(ndv);
+  }
+  else
+  {
+    NoDataElement = numeric_limits<T>::max();
+  }
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// This converts a cell that is not NoData to T, exiting if T can't hold it or
+// if it would be mistaken for NoData
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+template <class S>
+T LSDTypedRaster<T>::convert_cell(S value, int row, int col) const
+{
+  if (!is_floating_point<T>::value &&
+      (double(value) < double(numeric_limits<T>::lowest()) ||
+       double(value) > double(numeric_limits<T>::max()) ||
+       T(value) == NoDataElement))
+  {
+    cout << "\nFATAL ERROR: the value " << value << " at row " << row << " and column "
+         << col << " does not fit in a raster of " << sizeof(T) << " byte cells" << endl;
+    exit(EXIT_FAILURE);
+  }
+  return T(value);
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a raster from memory
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+void LSDTypedRaster<T>::create(int nrows, int ncols, float xmin, float ymin,
+                               float cellsize, int ndv, Array2D<T> data)
+{
+  set_georeferencing(nrows, ncols, xmin, ymin, cellsize, ndv);
+
+  if (data.dim1() != NRows || data.dim2() != NCols)
+  {
+    cout << "dimesntion of data is not the same as stated in NRows!" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  LSDStorageHandle storage;
+  Array2D<T> own_data = allocate_raster_array<T>(NRows,NCols,storage);
+  own_data.inject(data);
+  RasterData = own_data;
+  RasterDataStorage = storage;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a raster from an LSDIndexRaster
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+void LSDTypedRaster<T>::create(LSDIndexRaster& IndexRaster)
+{
+  set_georeferencing(IndexRaster.get_NRows(), IndexRaster.get_NCols(),
+                     IndexRaster.get_XMinimum(), IndexRaster.get_YMinimum(),
+                     IndexRaster.get_DataResolution(), IndexRaster.get_NoDataValue());
+
+  LSDStorageHandle storage;
+  Array2D<T> data = allocate_raster_array<T>(NRows,NCols,storage);
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (int col = 0; col < NCols; ++col)
+    {
+      int value = IndexRaster.get_data_element(row,col);
+      data[row][col] = (value == NoDataValue) ? NoDataElement : convert_cell(value,row,col);
+    }
+  }
+  RasterData = data;
+  RasterDataStorage = storage;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// this creates a raster from an LSDRaster
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+void LSDTypedRaster<T>::create(LSDRaster& Raster)
+{
+  set_georeferencing(Raster.get_NRows(), Raster.get_NCols(),
+                     Raster.get_XMinimum(), Raster.get_YMinimum(),
+                     Raster.get_DataResolution(), Raster.get_NoDataValue());
+
+  LSDStorageHandle storage;
+  Array2D<T> data = allocate_raster_array<T>(NRows,NCols,storage);
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (int col = 0; col < NCols; ++col)
+    {
+      float value = Raster.get_data_element(row,col);
+      data[row][col] = (value == NoDataValue) ? NoDataElement : convert_cell(value,row,col);
+    }
+  }
+  RasterData = data;
+  RasterDataStorage = storage;
+}
+
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// These convert the raster back to the toolbox's usual raster types
+//
+// 16/10/26
+//=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+template <class T>
+LSDIndexRaster LSDTypedRaster<T>::to_LSDIndexRaster() const
+{
+  Array2D<int> data(NRows,NCols);
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (int col = 0; col < NCols; ++col)
+    {
+      T value = RasterData[row][col];
+      data[row][col] = (value == NoDataElement) ? NoDataValue : int(value);
+    }
+  }
+  return LSDIndexRaster(NRows, NCols, XMinimum, YMinimum, DataResolution, NoDataValue, data);
+}
+
+template <class T>
+LSDRaster LSDTypedRaster<T>::to_LSDRaster() const
+{
+  Array2D<float> data(NRows,NCols);
+  for (int row = 0; row < NRows; ++row)
+  {
+    for (int col = 0; col < NCols; ++col)
+    {
+      T value = RasterData[row][col];
+      data[row][col] = (value == NoDataElement) ? float(NoDataValue) : float(value);
+    }
+  }
+  return LSDRaster(NRows, NCols, XMinimum, YMinimum, DataResolution, NoDataValue, data);
+}
+
+template <class T>
+void LSDTypedRaster<T>::write_raster(string filename, string extension) const
+{
+  if (is_floating_point<T>::value)
+  {
+    to_LSDRaster().write_raster(filename, extension);
+  }
+  else
+  {
+    to_LSDIndexRaster().write_raster(filename, extension);
+  }
+}
+
+/// @brief Object to handle rasters of true or false cells, such as binary
+/// channel networks and channel head masks, with one bit per cell.
+/// @details Each row is stored in whole 64 bit words, so the logical operations
+/// work on 64 cells at a time. The bits past the end of a row are always clear.
+class LSDMaskRaster
+{
+  public:
+  /// @brief Create an LSDMaskRaster with every cell false.
+  /// @param nrows An integer of the number of rows.
+  /// @param ncols An integer of the number of columns.
+  /// @param xmin A float of the minimum X coordinate.
+  /// @param ymin A float of the minimum Y coordinate.
+  /// @param cellsize A float of the cellsize.
+  /// @param ndv An integer of the no data value, used when the mask is converted.
+  /// @date 16/10/26
+  LSDMaskRaster(int nrows, int ncols, float xmin, float ymin, float cellsize, int ndv)
+                          { create(nrows, ncols, xmin, ymin, cellsize, ndv); }
+
+  /// @brief Create an LSDMaskRaster from an LSDIndexRaster. Cells are true
+  /// where the index raster holds neither 0 nor NoData, so a binary network
+  /// becomes a mask of its channel cells.
+  /// @param IndexRaster The raster to be converted.
+  /// @date 16/10/26
+  LSDMaskRaster(LSDIndexRaster& IndexRaster)      { create(IndexRaster); }
+
+  /// @return Number of rows as an integer.
+  int get_NRows() const               { return NRows; }
+  /// @return Number of columns as an integer.
+  int get_NCols() const               { return NCols; }
+  /// @return Minimum X coordinate as a float.
+  float get_XMinimum() const          { return XMinimum; }
+  /// @return Minimum Y coordinate as a float.
+  float get_YMinimum() const          { return YMinimum; }
+  /// @return Data resolution as a float.
+  float get_DataResolution() const    { return DataResolution; }
+  /// @return No Data Value as an integer.
+  int get_NoDataValue() const         { return NoDataValue; }
+
+  /// @brief Gets a cell of the mask.
+  /// @param row An integer, the row of the target cell.
+  /// @param column An integer, the column of the target cell.
+  /// @return The value of the cell.
+  /// @date 16/10/26
+  bool get_data_element(int row, int column) const
+        { return (Words[size_t(row)*WordsPerRow+(column>>6)] >> (column&63)) & 1; }
+
+  /// @brief Sets a cell of the mask.
+  /// @param row An integer, the row of the target cell.
+  /// @param column An integer, the column of the target cell.
+  /// @param value The new value of the cell.
+  /// @date 16/10/26
+  void set_data_element(int row, int column, bool value);
+
+  /// @return The number of bytes taken by the cells of the mask.
+  /// @date 16/10/26
+  size_t get_data_bytes() const       { return Words.size()*sizeof(uint64_t); }
+
+  /// @brief Sets each cell to itself and the same cell of Other.
+  /// @param Other A mask with the same dimensions.
+  /// @date 16/10/26
+  void mask_and(const LSDMaskRaster& Other);
+  /// @brief Sets each cell to itself or the same cell of Other.
+  /// @param Other A mask with the same dimensions.
+  /// @date 16/10/26
+  void mask_or(const LSDMaskRaster& Other);
+  /// @brief Sets each cell to itself exclusive or the same cell of Other.
+  /// @param Other A mask with the same dimensions.
+  /// @date 16/10/26
+  void mask_xor(const LSDMaskRaster& Other);
+  /// @brief Sets each true cell false and each false cell true.
+  /// @date 16/10/26
+  void invert();
+
+  /// @return The number of true cells.
+  /// @date 16/10/26
+  long count_true_cells() const;
+
+  /// @brief Converts the mask to an LSDIndexRaster with 1 for true cells and
+  /// 0 for false cells, as in a binary network.
+  /// @return The LSDIndexRaster.
+  /// @date 16/10/26
+  LSDIndexRaster to_LSDIndexRaster() const;
+
+  protected:
+  ///Number of rows.
+  int NRows;
+  ///Number of columns.
+  int NCols;
+  ///Minimum X coordinate.
+  float XMinimum;
+  ///Minimum Y coordinate.
+  float YMinimum;
+
+  ///Data resolution.
+  float DataResolution;
+  ///No data value.
+  int NoDataValue;
+
+  ///Number of 64 bit words in each row.
+  size_t WordsPerRow;
+  ///The cells, one bit each, in row major order.
+  vector<uint64_t> Words;
+
+  private:
+  void create(int nrows, int ncols, float xmin, float ymin, float cellsize, int ndv);
+  void create(LSDIndexRaster& IndexRaster);
+
+  void check_dimensions(const LSDMaskRaster& Other) const;
+};
+
+#endif
@@ -59,6 +59,8 @@
 #include <string.h>
 #include "../LSDStatsTools.hpp"
 #include "../LSDRaster.hpp"
+#include "../LSDRasterStorage.hpp"
+#include "../LSDRasterWriteQueue.hpp"
 #include "../LSDIndexRaster.hpp"
 #include "../LSDFlowInfo.hpp"
 #include "../LSDJunctionNetwork.hpp"
@@ -101,6 +103,26 @@ int main (int nNumberofArgs,char *argv[])
 
 	file_info_in >> Minimum_Slope >> threshold >> A_0 >> m_over_n >> no_connecting_nodes;
 
+	// after these come two optional parameters, in either order. The word
+	// cache_flow_info keeps the filled DEM and the flow routing in a cache
+	// next to the DEM (see below). Anything else is a scratch directory: if it
+	// is given the rasters are held in memory mapped files there rather than
+	// in RAM
+	bool cache_flow_info = false;
+	string optional_parameter;
+	while (file_info_in >> optional_parameter)
+	{
+		if (optional_parameter == "cache_flow_info")
+		{
+			cache_flow_info = true;
+		}
+		else
+		{
+			cout << "Raster data will be held in scratch files in " << optional_parameter << endl;
+			set_raster_scratch_directory(optional_parameter);
+		}
+	}
+
 	// get some file names
 	string DEM_f_name = path_name+DEM_name+fill_ext;
 	string DEM_flt_extension = "flt";
@@ -115,13 +137,41 @@ int main (int nNumberofArgs,char *argv[])
 	boundary_conditions[2] = "no flux";
 	boundary_conditions[3] = "No flux";
 	
+	// with cache_flow_info the filled DEM and the flow routing are cached next
+	// to the DEM, keyed by the DEM, the minimum slope and the boundary
+	// conditions, so a rerun with other chi parameters can skip straight past
+	// them. The cache takes about 37 bytes per cell, so it is off by default
+	string FI_cache_name = path_name+DEM_name+"_FI";
+	unsigned long long FI_cache_key = 0;
+	bool use_FI_cache = false;
+	if (cache_flow_info)
+	{
+		FI_cache_key = LSDFlowInfo::cache_key(topo_test, boundary_conditions, Minimum_Slope);
+		use_FI_cache = LSDFlowInfo::cache_matches(FI_cache_name, FI_cache_key);
+	}
+
 		// get the filled file
-	cout << "Filling the DEM" << endl;
-	LSDRaster filled_topo_test = topo_test.fill(Minimum_Slope);
-	filled_topo_test.write_raster((DEM_f_name),DEM_flt_extension);
-  
+	if (use_FI_cache)
+	{
+		cout << "Reading the filled DEM and flow routing from " << FI_cache_name << ".FIcache" << endl;
+	}
+	else
+	{
+		cout << "Filling the DEM" << endl;
+	}
+	LSDRaster filled_topo_test = use_FI_cache ? LSDFlowInfo::read_cached_DEM(FI_cache_name, FI_cache_key)
+	                                          : topo_test.fill(Minimum_Slope);
+
+	// the filled DEM is written in the background while the flow routing is done
+	filled_topo_test.write_raster_async((DEM_f_name),DEM_flt_extension);
+
   //get a FlowInfo object
-	LSDFlowInfo FlowInfo(boundary_conditions,filled_topo_test); 
+	LSDFlowInfo FlowInfo = use_FI_cache ? LSDFlowInfo(FI_cache_name, FI_cache_key)
+	                                    : LSDFlowInfo(boundary_conditions,filled_topo_test);
+	if (cache_flow_info && !use_FI_cache)
+	{
+		FlowInfo.write_cache(FI_cache_name, filled_topo_test, FI_cache_key);
+	}
 	LSDRaster DistanceFromOutlet = FlowInfo.distance_from_outlet();
 	LSDIndexRaster ContributingPixels = FlowInfo.write_NContributingNodes_to_LSDIndexRaster();
 	
@@ -154,7 +204,7 @@ int main (int nNumberofArgs,char *argv[])
 		if(raster_selection[i]==1)
 		{
       tan_curvature = surface_fitting[i];
-      tan_curvature.write_raster((path_name+DEM_name+curv_name), DEM_flt_extension);
+      tan_curvature.write_raster_async((path_name+DEM_name+curv_name), DEM_flt_extension);
     }
   }
   // Find the valley junctions
@@ -177,7 +227,7 @@ int main (int nNumberofArgs,char *argv[])
 	//write channel heads to a raster
 	string CH_name = "_CH";
 	LSDIndexRaster Channel_heads_raster = FlowInfo.write_NodeIndexVector_to_LSDIndexRaster(ChannelHeadNodes);
-	Channel_heads_raster.write_raster((path_name+DEM_name+CH_name),DEM_flt_extension);
+	Channel_heads_raster.write_raster_async((path_name+DEM_name+CH_name),DEM_flt_extension);
 	
 	//create a channel network based on these channel heads
 	LSDJunctionNetwork NewChanNetwork(ChannelHeadNodes, FlowInfo);
@@ -185,6 +235,13 @@ int main (int nNumberofArgs,char *argv[])
   LSDIndexRaster SOArrayNew = NewChanNetwork.StreamOrderArray_to_LSDIndexRaster();
 	string SO_name_new = "_SO_from_CH";
 	
-	SOArrayNew.write_raster((path_name+DEM_name+SO_name_new),DEM_flt_extension);	
+	SOArrayNew.write_raster_async((path_name+DEM_name+SO_name_new),DEM_flt_extension);
+
+	// wait for the background writes to finish
+	if (flush_raster_writes() > 0)
+	{
+		cout << "FATAL ERROR: not all of the rasters could be written" << endl;
+		exit(EXIT_FAILURE);
+	}
                               
 }